@@ -0,0 +1,266 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#include <BallisticSequence.h>
+
+BallisticSequence::BallisticSequence( const BallisticStep* pSteps, uint8_t nSteps, Position* pPos ) :
+    _pDefault( pSteps ), _nDefault( nSteps ), _pPosition( pPos )
+{
+    _pEdit = NULL;
+    _editCapacity = 0;
+    _nSteps = nSteps;
+    _bEdited = false;
+
+    _ixStep = BS_IDLE;
+    _nTicks = 0;
+    _bMirror = false;
+    _startInches = _startTheta = 0.0;
+}
+
+
+void BallisticSequence::SetEditBuffer( BallisticStep* pBuffer, uint8_t capacity )
+{
+    _pEdit = pBuffer;
+    _editCapacity = min( capacity, BS_IDLE - 1 );
+    memset( _pEdit, 0, _editCapacity * sizeof( BallisticStep ) );
+}
+
+
+BallisticStep* BallisticSequence::EditStep( uint8_t ix )
+{
+    if ( ! _pEdit ) {
+        return NULL;
+    }
+
+    if ( ! _bEdited ) {
+        // copy on write
+        _nSteps = min( _nDefault, _editCapacity );
+        memcpy_P( _pEdit, _pDefault, _nSteps * sizeof( BallisticStep ) );
+        _bEdited = true;
+    }
+
+    if ( ix > _nSteps || ix >= _editCapacity ) {
+        return NULL;
+    }
+
+    // don't change the table under a running sequence
+    Stop();
+
+    if ( ix == _nSteps ) {
+        memset( &_pEdit[ ix ], 0, sizeof( BallisticStep ) );
+        _nSteps++;
+    }
+    return &_pEdit[ ix ];
+}
+
+
+void BallisticSequence::SetDefault()
+{
+    Stop();
+    _nSteps = _nDefault;
+    _bEdited = false;
+}
+
+
+void BallisticSequence::readStep( uint8_t ix, BallisticStep& step )
+{
+    if ( _bEdited ) {
+        step = _pEdit[ ix ];
+    }
+    else {
+        memcpy_P( &step, &_pDefault[ ix ], sizeof( BallisticStep ) );
+    }
+}
+
+
+void BallisticSequence::Start( bool bMirror )
+{
+    _bMirror = bMirror;
+    startStep( 0 );
+}
+
+
+void BallisticSequence::startStep( uint8_t ix )
+{
+    _ixStep = ix < _nSteps ? ix : BS_IDLE;
+    _nTicks = 0;
+    if ( _pPosition ) {
+        _startInches = _pPosition->_distanceInches;
+        _startTheta = _pPosition->_theta;
+    }
+}
+
+
+bool BallisticSequence::isStepDone( const BallisticStep& step )
+{
+    if ( _nTicks >= BS_MAX_TICKS ) {
+        return true;
+    }
+
+    uint8_t until = _pPosition ? step.mode & BS_UNTIL_MASK : BS_TICKS;
+    switch ( until ) {
+        case BS_INCHES :
+            return fabs( _pPosition->_distanceInches - _startInches ) >= step.amount;
+
+        case BS_DEGREES :
+            return fabs( _pPosition->_theta - _startTheta ) * RAD_TO_DEG >= step.amount;
+
+        default :
+            return _nTicks >= step.amount;
+    }
+}
+
+
+bool BallisticSequence::Update( uint8_t flags, int& left, int& right, bool bCountTick )
+{
+    if ( ! IsRunning() ) {
+        return false;
+    }
+
+    BallisticStep step;
+    readStep( _ixStep, step );
+
+    // move on past any steps which are already done, which may be the rest of the sequence
+    for ( ;; ) {
+        if ( step.exitMask && ( flags & step.exitMask ) == step.exitValue ) {
+            if ( step.mode & BS_ABORT ) {
+                Stop();
+            }
+        }
+        else if ( ! isStepDone( step ) ) {
+            break;
+        }
+
+        if ( IsRunning() ) {
+            startStep( _ixStep + 1 );
+        }
+        if ( ! IsRunning() ) {
+            return false;
+        }
+        readStep( _ixStep, step );
+    }
+
+    if ( bCountTick ) {
+        _nTicks++;
+    }
+
+    if ( _bMirror && ( step.mode & BS_MIRROR ) ) {
+        left = step.right;
+        right = step.left;
+    }
+    else {
+        left = step.left;
+        right = step.right;
+    }
+    return true;
+}
+
+
+bool BallisticSequence::HandleCommand( CommandArgs* pArgs, bool bRespond )
+{
+    BallisticStep* pStep;
+    uint8_t ix = constrain( pArgs->nParams[ 0 ], 0, BS_IDLE - 1 );
+
+    switch( pArgs->inputBuffer[1] ) {
+        case 'W' : // write a step's throttles and amount
+        case 'X' : // and its mode and exit condition
+            pStep = EditStep( ix );
+            if ( ! pStep ) {
+                if ( bRespond ) {
+                    SerialTx.println( F( "Can't edit that step" ) );
+                }
+                break;
+            }
+            if ( pArgs->inputBuffer[1] == 'W' ) {
+                pStep->left = constrain( pArgs->nParams[ 1 ], -255, 255 );
+                pStep->right = constrain( pArgs->nParams[ 2 ], -255, 255 );
+                pStep->amount = constrain( pArgs->nParams[ 3 ], 0, 255 );
+            }
+            else {
+                pStep->mode = pArgs->nParams[ 1 ];
+                pStep->exitMask = pArgs->nParams[ 2 ];
+                pStep->exitValue = pArgs->nParams[ 3 ];
+            }
+            if ( bRespond ) {
+                printStep( ix );
+                SerialTx.println();
+            }
+            break;
+
+        case 'N' : // number of steps
+            if ( ! EditStep( 0 ) ) {
+                if ( bRespond ) {
+                    SerialTx.println( F( "Can't edit this table" ) );
+                }
+                break;
+            }
+            _nSteps = min( (uint8_t) pArgs->nParams[ 0 ], _editCapacity );
+            if ( bRespond ) {
+                SerialTx.print( F( "Steps set to " ) );
+                SerialTx.println( _nSteps );
+            }
+            break;
+
+        case 'D' : // default table
+            SetDefault();
+            if ( bRespond ) {
+                SerialTx.println( F( "Default steps restored" ) );
+            }
+            break;
+
+        default :
+            return false;
+    }
+    return true;
+}
+
+
+void BallisticSequence::printStep( uint8_t ix )
+{
+    BallisticStep step;
+    readStep( ix, step );
+
+    SerialTx.print( F( "  " ) );
+    SerialTx.print( ix ); SerialTx.print( '\t' );
+    SerialTx.print( step.left ); SerialTx.print( '\t' );
+    SerialTx.print( step.right ); SerialTx.print( '\t' );
+    SerialTx.print( step.amount );
+    switch ( step.mode & BS_UNTIL_MASK ) {
+        case BS_INCHES :    SerialTx.print( F( " in" ) );     break;
+        case BS_DEGREES :   SerialTx.print( F( " deg" ) );    break;
+        default :           SerialTx.print( F( " ticks" ) );  break;
+    }
+    if ( step.exitMask ) {
+        SerialTx.print( F( "\texit " ) );
+        SerialTx.print( step.exitMask, HEX ); SerialTx.print( '/' );
+        SerialTx.print( step.exitValue, HEX );
+        if ( step.mode & BS_ABORT ) {
+            SerialTx.print( F( " abort" ) );
+        }
+    }
+    if ( step.mode & BS_MIRROR ) {
+        SerialTx.print( F( "\tmirror" ) );
+    }
+}
+
+
+void BallisticSequence::Print()
+{
+    SerialTx.print( F( " Steps" ) );
+    SerialTx.print( _bEdited ? F( " (edited)" ) : F( "" ) );
+    SerialTx.println( F( ":\tLeft\tRight\tUntil" ) );
+    for ( uint8_t ix = 0; ix < _nSteps; ix++ ) {
+        printStep( ix );
+        if ( ix == _ixStep ) {
+            SerialTx.print( F( "\t<-" ) );
+        }
+        SerialTx.println();
+    }
+}
@@ -0,0 +1,116 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+#include <CommonDefs.h>
+#include <CommandDispatcher.h>
+#include <Position.h>
+
+// what ends a step, in the low bits of BallisticStep::mode
+#define BS_TICKS        0x00    // amount is Director ticks
+#define BS_INCHES       0x01    // amount is inches travelled, forward or back
+#define BS_DEGREES      0x02    // amount is degrees turned, either way
+#define BS_UNTIL_MASK   0x03
+
+// step flags, in the high bits of BallisticStep::mode
+#define BS_MIRROR       0x10    // swap left and right when the sequence was started mirrored
+#define BS_ABORT        0x20    // the exit condition ends the whole sequence, rather than just this step
+
+// the step index when the sequence isn't running
+#define BS_IDLE         0xFF
+
+// a step gives up after this many ticks, whatever its amount, so a robot which is stuck still recovers
+#define BS_MAX_TICKS    255
+
+
+// one step of a ballistic sequence:  8 bytes, and normally in flash
+struct BallisticStep
+{
+    int16_t     left;           // throttles
+    int16_t     right;
+    uint8_t     mode;           // BS_TICKS, BS_INCHES or BS_DEGREES, plus any flags
+    uint8_t     amount;         // how many ticks, inches or degrees
+    uint8_t     exitMask;       // the sensor flags to watch, or 0 for none
+    uint8_t     exitValue;      // the step ends early when ( flags & exitMask ) == exitValue
+};
+
+
+// BallisticSequence
+//
+// A ballistic behavior is one which, once triggered, runs through a fixed sequence of moves
+// without looking back, like the stop, back up, turn and go of CollisionRecovery.  Rather than
+// each such behavior having its own state machine, BallisticSequence runs a table of steps, so a
+// new reflex behavior is just a table, and the few bytes of state here.
+//
+// Each step sets the throttles, and holds them until it has run for so many ticks, or the robot
+// has travelled so many inches or turned so many degrees, according to Position.  (Without a
+// Position, inches and degrees are counted as ticks.)  A step can also end early on the owning
+// behavior's sensor flags (bumpers, say), which it passes in each tick.
+// Steps marked BS_MIRROR swap left and right when the sequence is started mirrored, so one table
+// can turn away from either side.
+//
+// Tables normally live in flash (PROGMEM).  Given an edit buffer in RAM, the table can be changed
+// from the console:  the first edit copies the flash table into the buffer, and the sequence runs
+// from there until it's set back to the default.  The owning behavior passes its console
+// subcommands to HandleCommand():
+//
+//      W <ix> <left> <right> <amount>          write step ix's throttles and amount
+//      X <ix> <mode> <exitMask> <exitValue>    set step ix's mode and exit condition
+//      N <steps>                               set how many steps there are
+//      D                                       go back to the default table
+class BallisticSequence
+{
+    const BallisticStep*    _pDefault;          // in flash
+    uint8_t                 _nDefault;
+    BallisticStep*          _pEdit;             // in RAM, or NULL if the table can't be edited
+    uint8_t                 _editCapacity;
+    uint8_t                 _nSteps;
+    bool                    _bEdited;           // running from _pEdit, rather than _pDefault
+
+    Position*               _pPosition;
+
+    uint8_t                 _ixStep;            // BS_IDLE when we're not running
+    uint8_t                 _nTicks;            // in this step
+    bool                    _bMirror;
+    float                   _startInches;       // where this step started
+    float                   _startTheta;
+
+    void                    readStep( uint8_t ix, BallisticStep& step );
+    bool                    isStepDone( const BallisticStep& step );
+    void                    startStep( uint8_t ix );
+    void                    printStep( uint8_t ix );
+
+public:
+
+    BallisticSequence( const BallisticStep* pSteps, uint8_t nSteps, Position* pPos = NULL );
+
+    // let the table be changed, in a buffer of up to capacity steps
+    void                    SetEditBuffer( BallisticStep* pBuffer, uint8_t capacity );
+
+    // a writable copy of step ix, which may be one past the end, or NULL if there's no room
+    BallisticStep*          EditStep( uint8_t ix );
+    void                    SetDefault();
+
+    // start from the first step, swapping left and right in the BS_MIRROR steps if bMirror
+    void                    Start( bool bMirror = false );
+    void                    Stop()              { _ixStep = BS_IDLE; }
+    bool                    IsRunning()         { return _ixStep < _nSteps; }
+    uint8_t                 GetStep()           { return _ixStep; }
+    uint8_t                 GetStepCount()      { return _nSteps; }
+
+    // run one tick, returning true, with the throttles, while the sequence is running.  A tick
+    // which isn't a whole interval (the Director's urgent ones) shouldn't count toward BS_TICKS steps.
+    bool                    Update( uint8_t flags, int& left, int& right, bool bCountTick = true );
+
+    // handle the table subcommands (W, X, N, D), returning false for any others
+    bool                    HandleCommand( CommandArgs* pArgs, bool bRespond );
+    void                    Print();
+};
@@ -9,11 +9,15 @@ Subsumption Architecture as described by David P. Anderson.
 */
 
 #include "Behavior.h"
+#include <Director.h>
 
 
-Behavior::Behavior( CommandDispatcher* pCD ) : CommandSubscriber( pCD ), _bEnabled( true ), _bCanBeDisabled(true), _messageMask( 1 )
+Behavior::Behavior( CommandDispatcher* pCD ) : CommandSubscriber( pCD ), _bEnabled( true ), _messageMask( 1 ), _bCanBeDisabled(true), _bReflex( false ),
+                                                _budgetMicros( 0 ), _budgetPolicy( eBudgetCount ), _bSkipOptional( false ),
+                                                _overruns( 0 ), _lastMicros( 0 ), _maxMicros( 0 )
 {
-
+    _pNextBehavior = NULL;
+    _pHelpString = F( "" );
 }
 
 
@@ -41,11 +45,56 @@ Subscriber* Behavior::HandleEvent( EventNotification* pEvent )
     Subscriber* pReturnSub = NULL;
 
     if ( pEvent->eventID == 0 ) {   // Subsumption (Director) event
-        if ( _messageMask & MM_ID ) {
-            Serial.print( _bEnabled ? '+' : '-' ); Serial.println( _pName );
+        SubsumptionParams* pParams = (SubsumptionParams*) pEvent->pData;
+
+        // an urgent tick is only for the reflexes
+        if ( pParams->IsUrgent() && ! _bReflex ) {
+            return _pNextBehavior;
+        }
+
+        // after an overrun, this tick goes without the diagnostics (but keeps any CSV columns going)
+        uint16_t messageMask = _messageMask;
+        if ( _bSkipOptional ) {
+            _messageMask &= MM_RESPONSES | MM_CSVEXTENDED;
         }
 
-        handleSubsumptionEvent( pEvent, (SubsumptionParams*) pEvent->pData );
+        IF_MASK( MM_ID ) {
+            ConsoleLine.Format( F( "%c%S\n" ), _bEnabled ? '+' : '-', _pName );
+            ConsoleLine.Flush();
+        }
+
+        // on the host, the names are plain strings
+        TRACE_BEGIN( (const char*) _pName );
+        unsigned long start = micros();
+        handleSubsumptionEvent( pEvent, pParams );
+        unsigned long us = micros() - start;
+        TRACE_END();
+
+        if ( _bSkipOptional ) {
+            _messageMask = messageMask;
+            _bSkipOptional = false;
+        }
+
+        if ( recordTime( us ) ) {
+            switch ( _budgetPolicy ) {
+                case eBudgetSkip :
+                    _bSkipOptional = true;
+                    break;
+                case eBudgetQuiet :
+                    // drop the chattiest diagnostic bit that's still on
+                    for ( uint16_t bit = MM_INFO; bit > MM_RESPONSES; bit >>= 1 ) {
+                        if ( _messageMask & bit ) {
+                            _messageMask &= ~bit;
+                            break;
+                        }
+                    }
+                    break;
+                case eBudgetStop :
+                    // the output stage is waiting on us, and we're late:  whatever was decided, stop
+                    pParams->SetThrottles( 0, 0, this );
+                    break;
+            }
+        }
         pReturnSub = _pNextBehavior;
     }
     else {  // CommandDispatcher event
@@ -61,8 +110,8 @@ Subscriber* Behavior::HandleEvent( EventNotification* pEvent )
                 if ( _bCanBeDisabled ) {
                     _bEnabled = false; 
                     IF_MASK( MM_RESPONSES ) {
-                        Serial.print( _pName );
-                        Serial.println( F( " disabled." ) );
+                        SerialTx.print( _pName );
+                        SerialTx.println( F( " disabled." ) );
                     }
                 }
                 break;
@@ -70,14 +119,25 @@ Subscriber* Behavior::HandleEvent( EventNotification* pEvent )
                 if ( _bCanBeDisabled ) {
                     _bEnabled = true; 
                     IF_MASK( MM_RESPONSES ) {
-                        Serial.print( _pName );
-                        Serial.println( F( " enabled." ) );
+                        SerialTx.print( _pName );
+                        SerialTx.println( F( " enabled." ) );
                     }
                 }
                 break;
             case 'Q' :
                 PrintParameterValues();
                 break;
+            case 'K' :
+                if ( pArgs->inputBuffer[2] == 'Z' ) {
+                    _overruns = _lastMicros = _maxMicros = 0;
+                }
+                else {
+                    SetBudget( pArgs->nParams[ 0 ], constrain( pArgs->nParams[ 1 ], eBudgetCount, eBudgetStop ) );
+                }
+                IF_MASK( MM_RESPONSES ) {
+                    printBudget();
+                }
+                break;
             case 'V' :
                 switch ( pArgs->inputBuffer[2] ) {
                     case 0 : // no command modifier, just set the value
@@ -90,9 +150,10 @@ Subscriber* Behavior::HandleEvent( EventNotification* pEvent )
                         _messageMask &= ~pArgs->nParams[ 0 ];
                         break;
                 }
-                Serial.print( _pName );
-                Serial.print( F( " message mask:\t0x" ) ) ;
-                Serial.println( _messageMask, HEX );
+                _messageMask &= MM_CEILING;    // anything above was compiled out
+                SerialTx.print( _pName );
+                SerialTx.print( F( " message mask:\t0x" ) ) ;
+                SerialTx.println( _messageMask, HEX );
                 break;
             default: 
 				// not a common Behavior command, pass to the specific Behavior
@@ -105,35 +166,57 @@ Subscriber* Behavior::HandleEvent( EventNotification* pEvent )
 
 void Behavior::PrintHelp()
 {
-    Serial.print( "\n========\n" );
+    ConsoleLine.print( F( "\n========\n" ) );
+    ConsoleLine.Flush();
     PrintParameterValues();
-    Serial.println("\n- - -\n");
-    Serial.print( _pName );
-    Serial.println( " options:\n" );
+    ConsoleLine.Format( F( "\n- - -\n\n%S options:\n\n" ), _pName );
     if ( _bCanBeDisabled )
     {
-        Serial.println( F( "  0: Disable" ) );
-        Serial.println( F( "  1: Enable" ) );
+        ConsoleLine.print( F( "  0: Disable\n"
+                              "  1: Enable\n" ) );
     }
-    Serial.println( F( "  Q: Query Parameter Values" ) );
-    Serial.println( F( "  V[+|-] <mask> : Set verbosity mask, or add/remove bits" ) );
-    Serial.println( _pHelpString );
+    ConsoleLine.print( F( "  Q: Query Parameter Values\n"
+                          "  V[+|-] <mask> : Set verbosity mask, or add/remove bits\n"
+                          "  K <us> [policy] : Set time budget per tick, 0 for none;  policy 0 count, 1 skip, 2 quiet, 3 stop\n"
+                          "  KZ : Clear timing\n" ) );
+    ConsoleLine.println( _pHelpString );
+    ConsoleLine.Flush();
 }
 
 
 void Behavior::PrintParameterValues()
 {
-    Serial.print( _pName );
-    Serial.print( ": " );
-    Serial.print( _bEnabled ? F( "Enabled" ) : F( "Disabled" ) );
-    Serial.print( F( ", verbosity = 0x" ) );
-    Serial.println( _messageMask, HEX );
+    ConsoleLine.Format( F( "%S: %S, verbosity = 0x%x\n" ), _pName, _bEnabled ? F( "Enabled" ) : F( "Disabled" ), _messageMask );
+    printBudget();
     PrintSpecificParameterValues();
 }
 
 
+void Behavior::printBudget()
+{
+    ConsoleLine.Format( F( " time (us) = %u, max = %u, budget = %u, policy = %u, overruns = %u\n" ),
+                        _lastMicros, _maxMicros, _budgetMicros, _budgetPolicy, _overruns );
+    ConsoleLine.Flush();
+}
+
+
+bool Behavior::recordTime( unsigned long us )
+{
+    _lastMicros = min( us, 0xFFFFUL );
+    _maxMicros = max( _maxMicros, _lastMicros );
+
+    if ( _budgetMicros && us > _budgetMicros ) {
+        if ( _overruns < 0xFFFF ) {
+            _overruns++;
+        }
+        return true;
+    }
+    return false;
+}
+
+
 void Behavior::PrintSpecificParameterValues()
 {
-    Serial.print( F( " No parameter query defined for " ) );
-    Serial.println( _pName );
+    SerialTx.print( F( " No parameter query defined for " ) );
+    SerialTx.println( _pName );
 }
@@ -12,9 +12,19 @@ Subsumption Architecture as described by David P. Anderson.
 
 #include <CommandDispatcher.h>
 #include <CommandSubscriber.h>
+#include <Trace.h>
 
 class SubsumptionParams;
 
+/// What a Behavior does when its part in a tick takes longer than its time budget
+enum eBudgetPolicy
+{
+    eBudgetCount,   ///< just count the overrun
+    eBudgetSkip,    ///< skip optional work, and diagnostic output, for the next tick
+    eBudgetQuiet,   ///< turn the verbosity down a notch, until it's set again
+    eBudgetStop     ///< stop the robot this tick, rather than leave the motors waiting on a late decision
+};
+
 /// The Behavior class is the base class for all participants in the Subsumption chain.
 ///
 /// 
@@ -42,11 +52,33 @@ protected:
     /// Print common parameter values, such as verbosity, etc.  Then call PrintSpecificParameterValues()
     void            PrintParameterValues();
 
+    void            printBudget();
+
     /// Help string to be defined by derived classes
     const __FlashStringHelper*    _pHelpString;
 
     bool            _bCanBeDisabled;
 
+    /// _bReflex.  A reflex Behavior also runs on the Director's urgent ticks (see Director::RequestTick()).
+    /// The rest, which assume a whole interval has passed since their last tick, only run on regular ones.
+    bool            _bReflex;
+
+    /// Time budget.  HandleEvent() times each tick's handleSubsumptionEvent(), and when it takes
+    /// longer than _budgetMicros (0 for no budget), counts an overrun and applies _budgetPolicy.
+    /// Times are in us, and saturate at 65535.
+    uint16_t        _budgetMicros;
+    uint8_t         _budgetPolicy;
+    bool            _bSkipOptional;
+    uint16_t        _overruns;
+    uint16_t        _lastMicros;
+    uint16_t        _maxMicros;
+
+    /// record the time taken by this tick, returning true if it was over budget
+    bool            recordTime( unsigned long us );
+
+    /// true if the last tick overran, and the policy says to skip optional work this tick
+    bool            SkipOptional()      { return _bSkipOptional; }
+
 public:
 
     Behavior( CommandDispatcher* pCD );
@@ -59,6 +91,10 @@ public:
     // Print the help message defined by derived Behaviors 
     void                PrintHelp();
 
+    void                SetBudget( uint16_t us, uint8_t policy = eBudgetCount )    { _budgetMicros = us; _budgetPolicy = policy; }
+    uint16_t            GetOverruns()           { return _overruns; }
+    uint16_t            GetMaxMicros()          { return _maxMicros; }
+
     // derived Behaviors should override PrintSpecificParameterValues() to list their respective parameters
     virtual void        PrintSpecificParameterValues();
 
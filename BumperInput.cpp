@@ -0,0 +1,167 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#include <BumperInput.h>
+
+// whichever BumperInput has the interrupts.  On the host, each simulated robot has its own.
+#ifdef ARDUINO
+static BumperInput* _pInterruptBumper = NULL;
+#else
+#define _pInterruptBumper   ( RobotContext::Current()->pInterruptBumper )
+#endif
+
+bool BumperInput::_bPinChange = false;
+
+
+BumperInput::BumperInput( uint8_t leftPin, uint8_t rightPin, Director* pD ) : _pDirector( pD )
+{
+    _pin[ 0 ] = leftPin;
+    _pin[ 1 ] = rightPin;
+    _debounceMicros = BUMPER_DEBOUNCE_US;
+
+    _state = _latched = 0;
+    _edgeMicros[ 0 ] = _edgeMicros[ 1 ] = 0;
+    _pressMicros = 0;
+}
+
+
+void BumperInput::Begin()
+{
+    _pInterruptBumper = this;
+
+    for ( uint8_t ixSide = 0; ixSide < 2; ixSide++ ) {
+        uint8_t pin = _pin[ ixSide ];
+        if ( pin == BUMPER_NO_PIN ) {
+            continue;
+        }
+
+        pinMode( pin, INPUT_PULLUP );
+
+#ifdef __AVR__
+        // read the pins straight from their ports, as the interrupt handler wants to be quick
+        _pInputReg[ ixSide ] = portInputRegister( digitalPinToPort( pin ) );
+        _bitMask[ ixSide ] = digitalPinToBitMask( pin );
+
+        if ( _bPinChange && digitalPinToPCICR( pin ) ) {
+            *digitalPinToPCICR( pin ) |= _BV( digitalPinToPCICRbit( pin ) );
+            *digitalPinToPCMSK( pin ) |= _BV( digitalPinToPCMSKbit( pin ) );
+            continue;
+        }
+#endif
+
+#ifdef NOT_AN_INTERRUPT
+        if ( digitalPinToInterrupt( pin ) == NOT_AN_INTERRUPT ) {
+            continue;   // Update() will poll it
+        }
+#endif
+        attachInterrupt( digitalPinToInterrupt( pin ), OnInterrupt, CHANGE );
+    }
+
+    // start from wherever the switches are, without taking it for a press, and ready for the next edge
+    noInterrupts();
+    _state = readPins();
+    _edgeMicros[ 0 ] = _edgeMicros[ 1 ] = micros() - _debounceMicros;
+    interrupts();
+}
+
+
+uint8_t BumperInput::readPins()
+{
+    uint8_t pressed = 0;
+
+    for ( uint8_t ixSide = 0; ixSide < 2; ixSide++ ) {
+        if ( _pin[ ixSide ] == BUMPER_NO_PIN ) {
+            continue;
+        }
+#ifdef __AVR__
+        bool bLow = ! ( *_pInputReg[ ixSide ] & _bitMask[ ixSide ] );
+#else
+        bool bLow = digitalRead( _pin[ ixSide ] ) == LOW;
+#endif
+        if ( bLow ) {
+            pressed |= 1 << ixSide;
+        }
+    }
+    return pressed;
+}
+
+
+// debounce.  Called from the interrupt handler, or with interrupts off.
+void BumperInput::sample()
+{
+    uint8_t changed = readPins() ^ _state;
+    if ( ! changed ) {
+        return;
+    }
+
+    unsigned long now = micros();
+    for ( uint8_t ixSide = 0; ixSide < 2; ixSide++ ) {
+        uint8_t side = 1 << ixSide;
+        if ( ( changed & side ) && now - _edgeMicros[ ixSide ] >= _debounceMicros ) {
+            _state ^= side;
+            _edgeMicros[ ixSide ] = now;
+
+            if ( _state & side ) {
+                _latched |= side;
+                _pressMicros = now;
+                if ( _pDirector ) {
+                    _pDirector->Stamp( eLatencyBump, now );
+                    _pDirector->RequestTick();
+                }
+            }
+        }
+    }
+}
+
+
+void BumperInput::OnInterrupt()
+{
+    if ( _pInterruptBumper ) {
+        _pInterruptBumper->sample();
+    }
+}
+
+
+void BumperInput::Update()
+{
+    noInterrupts();
+    sample();
+    interrupts();
+}
+
+
+void BumperInput::Latch( uint8_t sides )
+{
+    noInterrupts();
+    _latched |= sides;
+    _pressMicros = micros();
+    if ( _pDirector ) {
+        _pDirector->Stamp( eLatencyBump, _pressMicros );
+        _pDirector->RequestTick();
+    }
+    interrupts();
+}
+
+
+void BumperInput::Clear()
+{
+    noInterrupts();
+    _latched = 0;
+    interrupts();
+}
+
+
+unsigned long BumperInput::GetPressMicros()
+{
+    noInterrupts();
+    unsigned long us = _pressMicros;
+    interrupts();
+    return us;
+}
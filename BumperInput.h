@@ -0,0 +1,91 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+#include <CommonDefs.h>
+#include <Director.h>
+
+// the sides, as flags
+#define BUMP_LEFT               0x01
+#define BUMP_RIGHT              0x02
+
+// for a side with no switch
+#define BUMPER_NO_PIN           0xFF
+
+// switches bounce for a few ms
+#define BUMPER_DEBOUNCE_US      5000
+
+
+// BumperInput
+//
+// BumperInput reads a pair of bumper switches, each closing to ground on its own pin (the pins are
+// pulled up).  The switches are watched by interrupts:  pin change interrupts on the AVR, or
+// attachInterrupt() elsewhere.  A pin with neither is polled from Update().
+//
+// A switch's first edge is taken at once, and any more within the debounce time are ignored, so a
+// press is seen within microseconds rather than after the switch settles.  Update() looks again
+// once the debounce time is up, in case the switch settled somewhere other than its last edge.
+//
+// Each press is latched until Clear(), and asks the Director for an urgent tick, so the chain
+// can react without waiting out the rest of the interval.
+//
+// There's one set of interrupt handlers, so only one BumperInput (per robot, on the host) can use
+// interrupts.  On the AVR, the pin change vectors are only taken if the sketch includes
+// BumperPinChange.h, which defines their handlers;  otherwise they're left for anything else
+// (SoftwareSerial, say) which needs them, and pins without an external interrupt are polled.
+class BumperInput
+{
+    uint8_t             _pin[ 2 ];
+#ifdef __AVR__
+    volatile uint8_t*   _pInputReg[ 2 ];
+    uint8_t             _bitMask[ 2 ];
+#endif
+    Director*           _pDirector;
+    unsigned long       _debounceMicros;
+
+    volatile uint8_t        _state;             // debounced BUMP_LEFT and BUMP_RIGHT
+    volatile uint8_t        _latched;           // presses since Clear()
+    volatile unsigned long  _edgeMicros[ 2 ];   // when each side last changed
+    volatile unsigned long  _pressMicros;       // when the last press was seen
+
+    uint8_t             readPins();
+    void                sample();
+
+    static bool         _bPinChange;        // the sketch has the pin change handlers
+
+public:
+
+    BumperInput( uint8_t leftPin, uint8_t rightPin, Director* pD );
+
+    // set the pins up, and attach the interrupts.  Call this from setup().
+    void                Begin();
+
+    // poll, and catch up with any switch which has settled.  Call this from loop().
+    void                Update();
+
+    // as if the switches had been pressed:  latch them, and ask for an urgent tick
+    void                Latch( uint8_t sides );
+    void                Clear();
+
+    uint8_t             GetState()          { return _state; }
+    uint8_t             GetLatched()        { return _latched; }
+    unsigned long       GetPressMicros();
+    uint8_t             GetPin( uint8_t ixSide )            { return _pin[ ixSide ]; }
+
+    void                SetDebounce( unsigned long us )     { _debounceMicros = us; }
+    unsigned long       GetDebounce()                       { return _debounceMicros; }
+
+    // the interrupt handler, for whichever BumperInput called Begin()
+    static void         OnInterrupt();
+
+    // BumperPinChange.h calls this, before setup(), to say its handlers are there
+    static bool         UsePinChange()                      { _bPinChange = true; return true; }
+};
@@ -0,0 +1,41 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+#include <BumperInput.h>
+
+// BumperPinChange
+//
+// The pin change interrupt handlers for BumperInput, on the AVR.  A sketch which wants its bumpers
+// on pin change interrupts includes this, once;  one which needs the vectors for something else
+// leaves it out, and the bumpers use external interrupts or are polled.  Whichever port the
+// switches are on, any change is worth a look.
+//
+// Elsewhere this does nothing.
+#ifdef __AVR__
+
+#ifdef PCINT0_vect
+ISR( PCINT0_vect ) { BumperInput::OnInterrupt(); }
+#endif
+#ifdef PCINT1_vect
+ISR( PCINT1_vect ) { BumperInput::OnInterrupt(); }
+#endif
+#ifdef PCINT2_vect
+ISR( PCINT2_vect ) { BumperInput::OnInterrupt(); }
+#endif
+#ifdef PCINT3_vect
+ISR( PCINT3_vect ) { BumperInput::OnInterrupt(); }
+#endif
+
+// say so before setup() calls Begin(), which turns the interrupts on
+static bool _bBumperPinChange = BumperInput::UsePinChange();
+
+#endif
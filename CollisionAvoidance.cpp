@@ -8,3 +8,214 @@ Written by Terry Crook in collaboration with Clayton Dean, and based upon the
 Subsumption Architecture as described by David P. Anderson.
 */
 
+#include <CollisionAvoidance.h>
+
+float RangeFilter::Update( float inches )
+{
+    // median of the last three readings (or fewer, until we have three)
+    _raw[ _ixRaw ] = inches;
+    _ixRaw = _ixRaw < 2 ? _ixRaw + 1 : 0;
+    if ( _nRaw < 3 ) {
+        _nRaw++;
+    }
+
+    float median = inches;
+    if ( _nRaw >= 3 ) {
+        float a = _raw[ 0 ], b = _raw[ 1 ], c = _raw[ 2 ];
+        median = a < b ? ( b < c ? b : ( a < c ? c : a ) ) : ( a < c ? a : ( b < c ? c : b ) );
+    }
+
+    // age out the oldest candidate if it has left the window
+    uint8_t seq = _seq++;
+    if ( _wedgeCount && (uint8_t) ( seq - _wedgeSeq[ _wedgeHead ] ) >= RANGE_WINDOW ) {
+        _wedgeHead = ( _wedgeHead + 1 ) % RANGE_WINDOW;
+        _wedgeCount--;
+    }
+
+    // larger candidates can never be the minimum again, now that we have this one
+    while ( _wedgeCount && _wedgeValue[ ( _wedgeHead + _wedgeCount - 1 ) % RANGE_WINDOW ] >= median ) {
+        _wedgeCount--;
+    }
+
+    uint8_t ixTail = ( _wedgeHead + _wedgeCount ) % RANGE_WINDOW;
+    _wedgeValue[ ixTail ] = median;
+    _wedgeSeq[ ixTail ] = seq;
+    _wedgeCount++;
+
+    return _wedgeValue[ _wedgeHead ];
+}
+
+
+CollisionAvoidance::CollisionAvoidance( CommandDispatcher* pCD, RangeSensor* pSensor ) : Behavior( pCD ), _pSensor( pSensor )
+{
+    _pName = F("Avoidance");
+    _pHelpString = F(  "  S <stop> <slow> : Set stop and slow distances (inches)\n"
+                        "  T <seconds> : Set time-to-contact for turning away\n"
+                        "  P <throttle> : Set pivot throttle\n"
+                        "  D <1|-1> : Turn right (1) or left (-1)\n"
+                        "  R <inches> : Simulate range reading (-1 to stop)"
+                        );
+
+    SubscribeTo( pCD, 'R' );    // R for Range
+
+    _rawInches = RANGE_NONE;
+    _rangeInches = RANGE_CLEAR_INCHES;
+    _closingIPS = 0.0;
+
+    _stopInches = 6.0;
+    _slowInches = 18.0;
+    _ttcSeconds = 2.0;
+    _pivotThrottle = 40;
+    _turnDirection = 1;
+
+    _bAvoiding = false;
+    _nInterventions = 0;
+}
+
+
+void CollisionAvoidance::handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams )
+{
+    // keep the filters running even when we're disabled or subsumed, so they're current when we need them
+    _rawInches = _pSensor->ReadInches();
+    float range = _filter.Update( _rawInches < 0.0 ? RANGE_CLEAR_INCHES : _rawInches );
+
+    // closing rate only makes sense if we had something in range last time, too
+    if ( range < RANGE_CLEAR_INCHES && _rangeInches < RANGE_CLEAR_INCHES ) {
+        float rateIPS = ( _rangeInches - range ) * 1000.0 / pSubsumptionParams->GetInterval();
+        _closingIPS += ( rateIPS - _closingIPS ) * 0.25;
+    }
+    else {
+        _closingIPS = 0.0;
+    }
+    _rangeInches = range;
+
+    bool bInControl = false;
+
+    if ( _bEnabled && ! pSubsumptionParams->ControlFreak() ) {
+        float ttc = _closingIPS > 0.0 ? ( _rangeInches - _stopInches ) / _closingIPS : RANGE_CLEAR_INCHES;
+        bool bTooClose = _rangeInches <= _stopInches;
+        bool bClosing = ttc < _ttcSeconds;
+
+        if ( bTooClose || bClosing || _rangeInches < _slowInches ) {
+            if ( ! _bAvoiding ) {
+                // snapshot the throttles we found when we took control, as the baseline to slow from
+                _bAvoiding = true;
+                _nInterventions++;
+                _leftThrottleSnapshot = pSubsumptionParams->GetLeftThrottle();
+                _rightThrottleSnapshot = pSubsumptionParams->GetRightThrottle();
+                PROGRESS_MSG( "Avoiding" );
+            }
+            bInControl = true;
+
+            if ( bTooClose ) {
+                // pivot in place until the way ahead clears
+                pSubsumptionParams->SetThrottles( _turnDirection * _pivotThrottle, -_turnDirection * _pivotThrottle, this );
+            }
+            else {
+                float scale = constrain( ( _rangeInches - _stopInches ) / ( _slowInches - _stopInches ), 0.0, 1.0 );
+                int leftThrottle = _leftThrottleSnapshot * scale;
+                int rightThrottle = _rightThrottleSnapshot * scale;
+
+                // closing fast, so start turning away now
+                if ( bClosing ) {
+                    if ( _turnDirection > 0 ) {
+                        rightThrottle /= 2;
+                    }
+                    else {
+                        leftThrottle /= 2;
+                    }
+                }
+                pSubsumptionParams->SetThrottles( leftThrottle, rightThrottle, this );
+            }
+
+            IF_MASK( MM_CALC ) {
+                PRINT_VAR( _rangeInches );
+                PRINT_VAR( _closingIPS );
+                PRINT_VAR( ttc );
+            }
+        }
+    }
+
+    if ( ! bInControl ) {
+        _bAvoiding = false;
+    }
+
+    IF_CSV( MM_CSVBASIC ) {
+        CSV_OUT( _rawInches );
+        CSV_OUT( _rangeInches );
+        CSV_OUT( _closingIPS );
+    }
+}
+
+
+void CollisionAvoidance::handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs )
+{
+    switch( pArgs->inputBuffer[1] ) {
+        case 'S' : // stop and slow distances
+            _stopInches = pArgs->fParams[ 0 ];
+            _slowInches = max( pArgs->fParams[ 1 ], _stopInches + 1.0 );
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Stop/slow distances set to " ) );
+                SerialTx.print( _stopInches ); SerialTx.print( '/' );
+                SerialTx.println( _slowInches );
+            }
+            break;
+
+        case 'T' : // time to contact
+            _ttcSeconds = pArgs->fParams[ 0 ];
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Time-to-contact limit set to " ) );
+                SerialTx.println( _ttcSeconds );
+            }
+            break;
+
+        case 'P' : // pivot throttle
+            _pivotThrottle = pArgs->nParams[ 0 ];
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Pivot throttle set to " ) );
+                SerialTx.println( _pivotThrottle );
+            }
+            break;
+
+        case 'D' : // turn direction
+            _turnDirection = pArgs->nParams[ 0 ] < 0 ? -1 : 1;
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.println( _turnDirection > 0 ? F( "Avoidance turns right" ) : F( "Avoidance turns left" ) );
+            }
+            break;
+
+        case 'R' : // simulated reading
+            _pSensor->Simulate( pArgs->fParams[ 0 ] );
+            _filter.Reset();
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Simulated range set to " ) );
+                SerialTx.println( pArgs->fParams[ 0 ] );
+            }
+            break;
+    }
+}
+
+
+void CollisionAvoidance::PrintSpecificParameterValues()
+{
+    SerialTx.print( F( " Range raw/filtered (inches): " ) );
+    SerialTx.print( _rawInches ); SerialTx.print( '/' );
+    SerialTx.println( _rangeInches );
+
+    SerialTx.print( F( " Closing rate (IPS): " ) );
+    SerialTx.println( _closingIPS );
+
+    SerialTx.print( F( " Stop/slow distances: " ) );
+    SerialTx.print( _stopInches ); SerialTx.print( '/' );
+    SerialTx.println( _slowInches );
+
+    SerialTx.print( F( " Time-to-contact limit: " ) );
+    SerialTx.println( _ttcSeconds );
+
+    SerialTx.print( F( " Pivot throttle/direction: " ) );
+    SerialTx.print( _pivotThrottle ); SerialTx.print( '/' );
+    SerialTx.println( _turnDirection > 0 ? F( "right" ) : F( "left" ) );
+
+    SerialTx.print( F( " Interventions: " ) );
+    SerialTx.println( _nInterventions );
+}
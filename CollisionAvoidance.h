@@ -8,3 +8,99 @@ Written by Terry Crook in collaboration with Clayton Dean, and based upon the
 Subsumption Architecture as described by David P. Anderson.
 */
 
+#pragma once
+
+#include <CommandDispatcher.h>
+#include <Director.h>
+#include <RangeSensor.h>
+
+// number of readings in the rolling minimum window
+#ifndef RANGE_WINDOW
+#define RANGE_WINDOW    5
+#endif
+
+// "nothing in range" is treated as this distance by the filters
+#define RANGE_CLEAR_INCHES  999.0
+
+
+// RangeFilter smooths the raw range readings with two streaming filters, each of which does a
+// bounded amount of work per reading:
+//
+//  1. a median of the last three readings, which throws out single-reading glitches (a missed
+//     echo, or a reflection which comes back short), then
+//  2. a minimum over the last RANGE_WINDOW medians, which errs on the side of caution.
+//
+// The rolling minimum is kept in a "wedge":  an ascending queue of candidates, where each new
+// value first removes any candidates larger than itself from the back, and candidates which have
+// aged out of the window are removed from the front.  The wedge never holds more than
+// RANGE_WINDOW entries.
+class RangeFilter
+{
+    float       _raw[ 3 ];
+    uint8_t     _ixRaw;
+    uint8_t     _nRaw;
+
+    float       _wedgeValue[ RANGE_WINDOW ];
+    uint8_t     _wedgeSeq[ RANGE_WINDOW ];
+    uint8_t     _wedgeHead;
+    uint8_t     _wedgeCount;
+    uint8_t     _seq;
+
+public:
+
+    RangeFilter()   { Reset(); }
+
+    void        Reset()     { _ixRaw = 0; _nRaw = 0; _wedgeHead = 0; _wedgeCount = 0; _seq = 0; }
+
+    // add a reading, returning the filtered range
+    float       Update( float inches );
+};
+
+
+// CollisionAvoidance
+//
+// CollisionAvoidance uses a forward-looking RangeSensor to keep us from running into things in the
+// first place, rather than waiting for the bumpers and the whole CollisionRecovery sequence.
+//
+// Each tick it filters the range reading, and estimates our closing rate from the change in the
+// filtered range.  It then acts according to how close we are:
+//
+//  * beyond the slow distance, and not closing fast:  it does nothing.
+//  * inside the slow distance:  it takes control, scaling down the throttle settings it found when
+//    it first took control, in proportion to the remaining distance.
+//  * closing fast enough to reach the stop distance within the time-to-contact limit:  it also
+//    starts turning away, by slowing the wheel on the side we turn toward.
+//  * inside the stop distance:  it pivots in place until the way ahead is clear.
+//
+// It should be placed ahead of Navigator (and behind CollisionRecovery) in the chain.
+class CollisionAvoidance : public Behavior
+{
+    RangeSensor*    _pSensor;
+    RangeFilter     _filter;
+
+    float           _rawInches;
+    float           _rangeInches;       // filtered range
+    float           _closingIPS;        // smoothed closing rate, positive when approaching
+
+    float           _stopInches;
+    float           _slowInches;
+    float           _ttcSeconds;        // time-to-contact threshold for turning away
+    int             _pivotThrottle;
+    int8_t          _turnDirection;     // 1 to turn right, -1 to turn left
+
+    bool            _bAvoiding;
+    int             _leftThrottleSnapshot;
+    int             _rightThrottleSnapshot;
+
+    uint16_t        _nInterventions;
+
+public:
+
+    CollisionAvoidance( CommandDispatcher* pCD, RangeSensor* pSensor );
+
+    float           GetRangeInches()    { return _rangeInches; }
+
+    virtual void    handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs );
+    virtual void    handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams );
+    virtual void    PrintSpecificParameterValues();
+};
@@ -11,106 +11,76 @@ Subsumption Architecture as described by David P. Anderson.
 #include <CollisionRecovery.h>
 #include <Director.h>
 
-CollisionRecovery::CollisionRecovery( CommandDispatcher* pCD, uint8_t leftPin, uint8_t rightPin ) : Behavior( pCD )
+// stop, back up, turn away from the bump, and go on.  The turn is written for a bump on the left.
+static const BallisticStep PROGMEM recoverySteps[] = {
+    //  left    right   mode                    amount  exit
+    {   0,      0,      BS_TICKS,               2,      0, 0 },     // stop
+    {   -5,     -5,     BS_TICKS,               2,      0, 0 },     // reverse
+    {   -5,     -10,    BS_TICKS | BS_MIRROR,   2,      0, 0 },     // turn
+    {   20,     20,     BS_TICKS,               2,      0, 0 },     // forward
+};
+
+#define RECOVERY_TURN_STEP  2
+
+
+CollisionRecovery::CollisionRecovery( CommandDispatcher* pCD, Director* pD, Position* pPos, uint8_t leftPin, uint8_t rightPin ) :
+    Behavior( pCD ), _sequence( recoverySteps, sizeof( recoverySteps ) / sizeof( recoverySteps[0] ), pPos ),
+    _input( leftPin, rightPin, pD )
 {
     _pName = F("Crash Recover");
+    _bReflex = true;    // a bump asks for an urgent tick, so we can react to it
     _pHelpString = F(  "  L: Simulate bump left\n"
                         "  R: Simulate bump right\n"
                         "  S: <s1> <s2> <s3> <s4> Speeds (throttle) \n"
-                        "  T: <t1> <t2> <t3> <t4> Times (ticks)" 
+                        "  T: <t1> <t2> <t3> <t4> Times (ticks, inches or degrees)\n"
+                        "  W: <ix> <left> <right> <amount> Write step\n"
+                        "  X: <ix> <mode> <exit mask> <exit value> Set step mode and exit\n"
+                        "  N: <steps> Set step count\n"
+                        "  D: Default steps\n"
+                        "  E: <us> Set bumper debounce"
+#ifndef ARDUINO
+                        "\n  P: <left> <right> Set simulated bumper switches (1 = closed)"
+#endif
                         );
 
     // we need to subscribe to events from the two Publishers
     SubscribeTo( pCD, 'B' );
 
-    _eState = eNormal;
-
-    _bSimBumpLeft = false;
-    _bSimBumpRight = false;
-
-    // put some reasonable test values in the state arrays
-    _StateTimes[ eNormal    ] = 0;
-    _StateTimes[ eStopped   ] = 2;
-    _StateTimes[ eReversing ] = 2;
-    _StateTimes[ eTurning   ] = 2;
-    _StateTimes[ eForward   ] = 2;
-
-    _StateSpeeds[ eNormal    ] = 0;
-    _StateSpeeds[ eStopped   ] = 0;
-    _StateSpeeds[ eReversing ] = -5;
-    _StateSpeeds[ eTurning   ] = -10;
-    _StateSpeeds[ eForward   ] = 20;
+    _reactionMicros = 0;
 }
 
 
 void CollisionRecovery::handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams )
 {
     if ( ! pSubsumptionParams->ControlFreak() ) {
-        bool bInControl = true;
-        int leftMotorSpeed = 0;
-        int rightMotorSpeed = 0;
-        leftMotorSpeed = _StateSpeeds[_eState];
-        rightMotorSpeed = _StateSpeeds[_eState];
-        switch ( _eState ) {  // ballistic behavior
-
-            case eNormal :
-                // check the bump sensors
-                // if we've hit something, stop
-                if ( _bSimBumpLeft || _bSimBumpRight ) {
-                    leftMotorSpeed = 0;
-                    rightMotorSpeed = 0;
-                    _eState = eStopped;
-                    _nStateTimer = _StateTimes[ _eState ] - 1;
-                    PROGRESS_MSG( "Stopped" );
-                }
-                else {
-                    // nothing hit, pass for now . . .
-                    bInControl = false;
-                }
-                break;
-
-            case eStopped :
-                if ( --_nStateTimer == 0 ) {
-                    _eState = eReversing;
-                    _nStateTimer = _StateTimes[ _eState ];
-                    PROGRESS_MSG( "Reverse" );
-                }
-                break;
-
-            case eReversing :
-                if ( --_nStateTimer == 0 ) {
-                    _eState = eTurning;
-                    _nStateTimer = _StateTimes[ _eState ];
-                    PROGRESS_MSG( "Turning" );
-                }
-                break;
+        uint8_t ixStep = _sequence.GetStep();
+
+        // if we've hit something, start recovering, turning away from the bump
+        uint8_t bumped = _input.GetLatched();
+        if ( ! _sequence.IsRunning() && bumped ) {
+            _sequence.Start( ! ( bumped & BUMP_LEFT ) );
+            if ( pSubsumptionParams->IsUrgent() ) {
+                _reactionMicros = micros() - _input.GetPressMicros();
+            }
+        }
 
-            case eTurning :
-                if ( _bSimBumpLeft ) {
-                    leftMotorSpeed = _StateSpeeds[ _eState ] / 2;
+        if ( _sequence.IsRunning() ) {
+            int leftMotorSpeed, rightMotorSpeed;
+
+            // an urgent tick isn't a whole interval, so it doesn't count toward a step's ticks
+            if ( _sequence.Update( _input.GetState(), leftMotorSpeed, rightMotorSpeed, ! pSubsumptionParams->IsUrgent() ) ) {
+                pSubsumptionParams->SetThrottles( leftMotorSpeed, rightMotorSpeed, this );
+                IF_MASK( MM_PROGRESS ) {
+                    if ( _sequence.GetStep() != ixStep ) {
+                        SerialTx.print( F( "Recovery step " ) );
+                        SerialTx.println( _sequence.GetStep() );
+                    }
                 }
-                else {
-                    rightMotorSpeed = _StateSpeeds[ _eState ] / 2;
-                }
-                if ( --_nStateTimer == 0 ) {
-                    _eState = eForward;
-                    _nStateTimer = _StateTimes[ _eState ];
-                    PROGRESS_MSG( "Forward" );
-                }
-                break;
-
-            case eForward :
-                if ( --_nStateTimer == 0 ) {
-                    _eState = eNormal;
-                    _bSimBumpLeft = false;
-                    _bSimBumpRight = false;
-                    PROGRESS_MSG( "Done" );
-                }
-                break;
-
-        }
-        if ( bInControl ) {
-            pSubsumptionParams->SetThrottles( leftMotorSpeed, rightMotorSpeed, this );
+            }
+            else {
+                _input.Clear();
+                PROGRESS_MSG( "Done" );
+            }
         }
     }
 }
@@ -125,56 +95,84 @@ void CollisionRecovery::handleCommandEvent( EventNotification* pEvent, CommandAr
         
         case 'L' : // Simulated Bump left
             PROGRESS_MSG("Bump Left!");
-            _bSimBumpLeft = true;
+            _input.Latch( BUMP_LEFT );
             break;
         
         case 'R' : // Simulated Bump right
             PROGRESS_MSG( "Bump Right!");
-            _bSimBumpRight = true;
+            _input.Latch( BUMP_RIGHT );
             break;
 
-        case 'S' : // Set recovery state speeds
-            _StateSpeeds[0] = 0;
-            for ( int ixArg = 0; ixArg <= 3; ixArg++ ) {
-                _StateSpeeds[ixArg + 1] = pArgs->nParams[ixArg];
-                if ( _messageMask & MM_RESPONSES ) {
-                    Serial.print( "Bump speed " );
-                    Serial.print( ixArg + 1 );
-                    Serial.print( " set to " );
-                    Serial.println( _StateSpeeds[ixArg + 1] );
-                }
+        case 'E' : // debounce
+            _input.SetDebounce( max( pArgs->nParams[0], 0 ) );
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Bumper debounce (us) set to " ) );
+                SerialTx.println( _input.GetDebounce() );
             }
             break;
 
-        case 'T' : // Set recovery state times (interval counts)
-            _StateTimes[0] = 0;
+#ifndef ARDUINO
+        case 'P' : // simulated switches, through the pins and the interrupt handler as on the robot
+            for ( uint8_t ixSide = 0; ixSide < 2; ixSide++ ) {
+                HostSetPin( _input.GetPin( ixSide ), pArgs->nParams[ ixSide ] ? LOW : HIGH );
+            }
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Bumper switches now " ) );
+                SerialTx.println( _input.GetState() );
+            }
+            break;
+#endif
+
+        case 'S' : // Set recovery step speeds
+        case 'T' : // Set recovery step amounts (ticks, inches or degrees)
             for ( int ixArg = 0; ixArg <= 3; ixArg++ ) {
-                _StateTimes[ixArg + 1] = pArgs->nParams[ixArg];
-                if ( _messageMask & MM_RESPONSES ) {
-                    Serial.print( "Bump time " );
-                    Serial.print( ixArg + 1 );
-                    Serial.print( " set to " );
-                    Serial.println( _StateTimes[ixArg + 1] );
+                BallisticStep* pStep = _sequence.EditStep( ixArg );
+                if ( ! pStep ) {
+                    IF_MASK( MM_RESPONSES ) {
+                        if ( ixArg == 0 ) {
+                            SerialTx.println( F( "Can't edit this table" ) );
+                        }
+                    }
+                    break;
+                }
+                int value = pArgs->nParams[ixArg];
+                if ( pArgs->inputBuffer[1] == 'S' ) {
+                    // the turn is at half speed on the bump side
+                    pStep->left = ixArg == RECOVERY_TURN_STEP ? value / 2 : value;
+                    pStep->right = value;
+                }
+                else {
+                    pStep->amount = constrain( value, 0, 255 );
+                }
+                IF_MASK( MM_RESPONSES ) {
+                    SerialTx.print( pArgs->inputBuffer[1] == 'S' ? F( "Bump speed " ) : F( "Bump time " ) );
+                    SerialTx.print( ixArg + 1 );
+                    SerialTx.print( F( " set to " ) );
+                    SerialTx.println( pArgs->inputBuffer[1] == 'S' ? pStep->right : pStep->amount );
                 }
             }
             break;
+
+        default : // editing the table
+            _sequence.HandleCommand( pArgs, MM_ON( MM_RESPONSES ) );
+            break;
     }
 }
 
 
 void CollisionRecovery::PrintSpecificParameterValues()
 {
-    Serial.println( F( "\t\tStop\tBack\tTurn\tFwd" ) );
-    Serial.print( F( " Speeds:" ) );
-    for ( int ix = 1; ix <= 4; ix++ ) {
-        Serial.print( '\t' );
-        Serial.print( _StateSpeeds[ ix ] );
-    }
-    Serial.println();
+    SerialTx.print( F( " Bumper pins/debounce (us): " ) );
+    SerialTx.print( _input.GetPin( 0 ) ); SerialTx.print( '/' );
+    SerialTx.print( _input.GetPin( 1 ) ); SerialTx.print( '/' );
+    SerialTx.println( _input.GetDebounce() );
 
-    Serial.print( F( " Times: " ) );
-    for ( int ix = 1; ix <= 4; ix++ ) {
-        Serial.print( '\t' );
-        Serial.print( _StateTimes[ ix ] );
-    }
+    SerialTx.print( F( " Bumpers now/latched: " ) );
+    SerialTx.print( _input.GetState() ); SerialTx.print( '/' );
+    SerialTx.println( _input.GetLatched() );
+
+    SerialTx.print( F( " Last reaction (us): " ) );
+    SerialTx.println( _reactionMicros );
+
+    _sequence.Print();
 }
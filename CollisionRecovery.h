@@ -12,55 +12,68 @@ Subsumption Architecture as described by David P. Anderson.
 
 #include <Director.h>
 #include <CommandDispatcher.h>
+#include <Position.h>
+#include <BallisticSequence.h>
+#include <BumperInput.h>
+
+// the recovery table can be edited, and grown by a couple of steps, from the console, given
+// this many steps of RAM to edit it in (see SetEditBuffer())
+#define RECOVERY_EDIT_STEPS     6
 
 
 // The CollisionRecovery class implements behaviors which are intended to get the robot
 // around obstacles it has crashed into.  It detects collisions through two "bumper" inputs (left and right),
 // basically switch closures connected to two input pins.  
 //
-// The recovery behavior consists of a sequence of steps, or states:
+// The bumpers are read by a BumperInput, under interrupts, and a bump asks the Director for an urgent
+// tick, so the recovery starts (and the motors stop) straight away, rather than at the next regular
+// tick.  The sequence's sensor flags are the switches' current (debounced) state, BUMP_LEFT and
+// BUMP_RIGHT.
+//
+// The recovery behavior is a ballistic sequence of steps:
 //
 //      1. Stop
 //      2. Reverse
 //      3. Turn away from the collision side
 //      4. Forward
 //
-// Each state has an associated duration and speed, which can be configured from the console.
+// The steps are a BallisticSequence table, written for a bump on the left and mirrored for a bump
+// on the right.  Each step's duration and speed can be configured from the console, or the whole
+// table replaced, if the sketch has given it an edit buffer;  otherwise the table lives in flash
+// and can't be changed, which saves the RAM on a small processor.
 
 class CollisionRecovery : public Behavior
 {
-    enum eRecoveryState {
-        eNormal,
-        eStopped,
-        eReversing,
-        eTurning,
-        eForward,
-        eStates
-    };
-
-    eRecoveryState  _eState;
-    int             _nStateTimer;
-    int             _StateTimes[ eStates ];
-    int             _StateSpeeds[ eStates ];
-
-    int             _leftMotorSpeed;
-    int             _rightMotorSpeed;
-
-    bool            _bSimBumpLeft;
-    bool            _bSimBumpRight;
-
-    // pins connected to bumper switches
-    uint8_t         _leftPin;
-    uint8_t         _rightPin;
+    BallisticSequence   _sequence;
+
+    // the bumper switches, or BUMPER_NO_PIN
+    BumperInput     _input;
+
+    // from the bump to the urgent tick which reacted to it
+    unsigned long   _reactionMicros;
     
 public:
 
-    CollisionRecovery( CommandDispatcher* pCD, uint8_t leftPin, uint8_t rightPin );
+    CollisionRecovery( CommandDispatcher* pCD, Director* pD, Position* pPos, uint8_t leftPin, uint8_t rightPin );
     ~CollisionRecovery() {}
 
+    // set up the bumper inputs.  Call this from setup().
+    void            Begin()             { _input.Begin(); }
+
+    // watch the bumper inputs.  Call this from loop().
+    void            Update()            { _input.Update(); }
+
+    // RAM for editing the recovery table, normally RECOVERY_EDIT_STEPS steps.  Without it, the
+    // table can't be edited.
+    void            SetEditBuffer( BallisticStep* pBuffer, uint8_t capacity )   { _sequence.SetEditBuffer( pBuffer, capacity ); }
+
 //    virtual Subscriber* HandleEvent( EventNotification* pEvent );
     virtual void    handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs );
     virtual void    handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams );
 
     virtual void    PrintSpecificParameterValues();
+
+    // bumper state.  These stay set until the recovery sequence is complete.
+    bool            IsBumpedLeft()      { return _input.GetLatched() & BUMP_LEFT; }
+    bool            IsBumpedRight()     { return _input.GetLatched() & BUMP_RIGHT; }
 };
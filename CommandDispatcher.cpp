@@ -22,6 +22,10 @@ CommandDispatcher::CommandDispatcher()
     memset(_subscribers, 0, sizeof(_subscribers) );
     memset( _args.inputBuffer, 0, sizeof( _args.inputBuffer ) );
     _bufIx = 0;
+    _pConsole = &Serial;
+
+    _lineMicros = 0;
+    _lineCount = 0;
 }
 
 CommandDispatcher::~CommandDispatcher() {}
@@ -41,27 +45,18 @@ CommandDispatcher::~CommandDispatcher() {}
 /// knows nothing about the commands; this knowledge is contained in the Subscribers.
 void CommandDispatcher::Update()
 {
-    if ( Serial.available() > 0 ) {
-        char ch = toUpperCase( Serial.read() );
-        if ( '\r' == ch ) {
+    // pass on whatever the port will take of the output so far
+    SerialTx.Drain();
 
+    if ( _pConsole->available() > 0 ) {
+        char ch = toUpperCase( _pConsole->read() );
+        if ( '\r' == ch ) {
             processCommandLine();
-
-            // reset the buffer
-            memset( _args.inputBuffer, 0, sizeof( _args.inputBuffer ) );
-
-            // if we're in "menu mode", prepend the menu command character
-            if ( _menuModeCmdChar != 0 ) {
-                _args.inputBuffer[0] = _menuModeCmdChar;
-                _bufIx = 1;
-            }
-            else {
-                _bufIx = 0;
-            }
+            resetCommandLine();
         }
         else {
-            if ( _bufIx >= 32 ) {
-                // buffer overflow
+            if ( _bufIx >= sizeof( _args.inputBuffer ) - 1 ) {
+                // buffer overflow.  Leave room for the terminator.
             }
             else {
                 _args.inputBuffer[ _bufIx++ ] = ch;
@@ -71,19 +66,58 @@ void CommandDispatcher::Update()
 }
 
 
+void CommandDispatcher::Execute( const char* pLine )
+{
+    // anything typed so far is lost, just as if this line had been typed over it
+    memset( _args.inputBuffer, 0, sizeof( _args.inputBuffer ) );
+    for ( _bufIx = 0; *pLine && *pLine != '\r' && *pLine != '\n' && _bufIx < sizeof( _args.inputBuffer ) - 1; pLine++ ) {
+        _args.inputBuffer[ _bufIx++ ] = toUpperCase( *pLine );
+    }
+
+    processCommandLine();
+    resetCommandLine();
+    SerialTx.Drain();
+}
+
+
+void CommandDispatcher::SetConsole( Stream* pConsole )
+{
+    _pConsole = pConsole;
+    SerialTx.SetOutput( pConsole );
+}
+
+
+void CommandDispatcher::resetCommandLine( void )
+{
+    memset( _args.inputBuffer, 0, sizeof( _args.inputBuffer ) );
+
+    // if we're in "menu mode", prepend the menu command character
+    if ( _menuModeCmdChar != 0 ) {
+        _args.inputBuffer[0] = _menuModeCmdChar;
+        _bufIx = 1;
+    }
+    else {
+        _bufIx = 0;
+    }
+}
+
+
 void CommandDispatcher::displayTopLevelMenu( void )
 {
-    Serial.println(F("\n=================="
+    SerialTx.println(F("\n=================="
                      "\nAvailable Objects:\n"));
     for ( char cmd = 'A'; cmd <= 'Z'; cmd++ ) {
         dispatchCommand( cmd, eHelpSummary );
     }
-    Serial.println();
+    SerialTx.println();
 }
 
 
 void CommandDispatcher::processCommandLine( void )
 {
+    _lineMicros = micros();
+    _lineCount++;
+
     int cmdLen = strlen( _args.inputBuffer );
     if ( (cmdLen == 0) || (_menuModeCmdChar > 0 && cmdLen == 1) ) {
         _menuModeCmdChar = 0;
@@ -92,18 +126,19 @@ void CommandDispatcher::processCommandLine( void )
     else {
         // process command completion
 
-        // parse out the command character
-        char* pCh = strtok( _args.inputBuffer, TokenDelimiters );
+        // parse out the command character.  strtok()'s place in the string is shared by the whole
+        // program, and on the host several threads may be executing commands at once, so the
+        // place is kept here instead.
+        char* pSave = NULL;
+        char* pCh = strtok_r( _args.inputBuffer, TokenDelimiters, &pSave );
         char cmdChar = pCh[0];  // command is the first character of the first token
 
         if ( strlen( pCh ) > 1 ) {
-            // parse out the remaining arguments
-            int argIx = 0;
-            while ( pCh && argIx < MaxArgs ) {
-                pCh = strtok( NULL, TokenDelimiters );
-                _args.fParams[ argIx ] = atof( pCh );
-                _args.nParams[ argIx ] = atoi( pCh );
-                argIx++;
+            // parse out the remaining arguments.  Any not given are 0.
+            for ( int argIx = 0; argIx < MaxArgs; argIx++ ) {
+                pCh = pCh ? strtok_r( NULL, TokenDelimiters, &pSave ) : NULL;
+                _args.fParams[ argIx ] = pCh ? atof( pCh ) : 0.0;
+                _args.nParams[ argIx ] = pCh ? atoi( pCh ) : 0;
             }
         }
 
@@ -122,8 +157,8 @@ void CommandDispatcher::processCommandLine( void )
             }
             break;
         case '*' : // broadcast
-            Serial.print( F( "\nBroadcasting command: " ) );
-            Serial.println( _args.inputBuffer + 1 );
+            SerialTx.print( F( "\nBroadcasting command: " ) );
+            SerialTx.println( _args.inputBuffer + 1 );
             for ( char cmd = 'A'; cmd <= 'Z'; cmd++ ) {
                 dispatchCommand( cmd, eNotify );
             }
@@ -176,8 +211,10 @@ Subscriber* CommandDispatcher::dispatchCommand( char cmdChar, eDispatchAction eA
     int cmdIx = cmdChar - 'A';
     if ( cmdIx < 0 || cmdIx > 25 ) {
         // command out of range
-        Serial.print(F("Invalid command "));
-        Serial.println( cmdChar );
+        uint8_t lane = SerialTx.SetLane( eTxError );
+        SerialTx.print(F("Invalid command "));
+        SerialTx.println( cmdChar );
+        SerialTx.SetLane( lane );
     }
     else {
         pSubscriber = _subscribers[ cmdIx ];
@@ -192,17 +229,19 @@ Subscriber* CommandDispatcher::dispatchCommand( char cmdChar, eDispatchAction eA
             publish( pSubscriber, &_notification );
             break;
         case eHelpSummary :
-            Serial.print( F( "  " ) );
-            Serial.print( cmdChar );
-            Serial.print( F( " - " ) );
-            Serial.println( pSubscriber->GetName() );
+            SerialTx.print( F( "  " ) );
+            SerialTx.print( cmdChar );
+            SerialTx.print( F( " - " ) );
+            SerialTx.println( pSubscriber->GetName() );
             break;
         }
     }
     else {
         // no subscriber for this command
         if ( eAction == eHelpDetail ) {
-            Serial.println( F("No handler for this command." ) );
+            uint8_t lane = SerialTx.SetLane( eTxError );
+            SerialTx.println( F("No handler for this command." ) );
+            SerialTx.SetLane( lane );
         }
     }
     return pSubscriber;
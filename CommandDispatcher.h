@@ -39,6 +39,9 @@ class CommandDispatcher : public Publisher
 
     uint8_t     _bufIx;
 
+    // where commands come from:  Serial, unless SetConsole() says otherwise
+    Stream*     _pConsole;
+
     // the subscriber array contains pointers to the Subscribers which have requested notifications of command
     // events.  This array is indexed by the commands themselves, with the first element corresponding to 'A'.
     //
@@ -55,10 +58,15 @@ class CommandDispatcher : public Publisher
     bool        _bMenuMode;
     char        _menuModeCmdChar;
 
+    // when the last command line was finished, and how many there have been, for latency stamps
+    unsigned long   _lineMicros;
+    uint16_t        _lineCount;
+
     enum        eDispatchAction { eNotify, eHelpSummary, eHelpDetail };
 
     Subscriber* dispatchCommand( char cmdChar, eDispatchAction eAction );
     void        processCommandLine( void );
+    void        resetCommandLine( void );
     void        displayTopLevelMenu( void );
 
 public:
@@ -80,6 +88,21 @@ public:
     // knows nothing about the commands; this knowledge is contained in the Subscribers.
     void Update();
 
+    // Execute parses and dispatches one command line, as if it had been typed at the console.  This lets
+    // a program (or a simulation) drive the Behaviors without going through Serial.
+    void Execute( const char* pLine );
+
+    // SetConsole talks to the console through another Stream:  commands are read from it, and
+    // SerialTx writes to it.  On the host, that can be a pty or a socket (see HostTransport.h);
+    // on the robot, another UART.
+    void            SetConsole( Stream* pConsole );
+    Stream*         GetConsole()        { return _pConsole; }
+
+    // when the last command line was finished (its CR typed, or Execute() called), and a count of
+    // lines, so the Director can tell there's been a new one
+    unsigned long   GetLineMicros()     { return _lineMicros; }
+    uint16_t        GetLineCount()      { return _lineCount; }
+
     // Subscribe is inherited from the Publisher base class.  This associates a Subscriber with a specified
     // command letter.  The return value is a pointer to the current Subscriber (if any) for that event.  The
     // Subscriber should cache this pointer and use it to forward notifications to other Subscribers interested
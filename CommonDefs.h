@@ -9,65 +9,20 @@ Subsumption Architecture as described by David P. Anderson.
 */
 
 #pragma once
-#define REAL_DUINO
-#ifdef REAL_DUINO
+
+// on anything but an Arduino, HostDuino stands in for the Arduino core
+#ifdef ARDUINO
 #include "Arduino.h"
 #else
-#include "stddef.h"
-#include "stdint.h"
-#include "stdlib.h"
-#include "math.h"
-#include "string.h"
-#include "WString.h"
-
-#define HEX 16
-#define PI  3.141592653
-#define INPUT 0x0
-#define OUTPUT 0x1
-#define INPUT_PULLUP 0x2
-#define HIGH 0x1
-#define LOW  0x0
-
-
-// fakeduino stuff
-class SimSerial {
-public:
-    void print() {;}
-    void print( int, int f=0 )  {;}
-    void print( unsigned int, int f=0 )  {;}
-    void print( const char[], int f=0 ){;}
-    void print( unsigned long, int f=0 ) {;}
-    void print( float, int f=0 ){;}
-    void print( double, int f=0 ) {}
-
-    void println() {;}
-    void println( int, int f=0 )  {;}
-    void println( unsigned int, int f=0 )  {;}
-    void println( const char[], int f=0 ){;}
-    void println( long, int f=0 ) {;}
-    void println( unsigned long, int f=0 ) {;}
-    void println( float, int f=0 ){;}
-    void println( double, int f=0 ) {}
-
-    int available( void );
-    void begin( long );
-    int read();
-};
-
-void pinMode(uint8_t, uint8_t) {}
-void digitalWrite(uint8_t, uint8_t) {}
-int digitalRead(uint8_t) { return 0; }
-int analogRead(uint8_t) { return 0; }
-void analogReference(uint8_t mode) {}
-void analogWrite(uint8_t, int) {}
-
-unsigned long millis(void) {}
-unsigned long micros(void) {}
-
-#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
-long map(long, long, long, long, long) { return 0; }
-
-SimSerial Serial;
+#include "HostDuino.h"
+#endif
+
+#include "LineFormatter.h"
+#include "TxRing.h"
+
+// on the host, the console and the rest of the "hardware" are per robot
+#ifndef ARDUINO
+#include "RobotContext.h"
 #endif
 
 //#include <EEPROM.h>
@@ -75,30 +30,46 @@ SimSerial Serial;
 //#define F( x ) x
 
 /// Print the value of the given expression, using the expression text as a label.
-/// Uses the F() macro to print strings directly from Program Memory without using RAM
-#define PRINT_VAR( x ) Serial.print( F( #x " =\t" ) ); Serial.println( x );
+/// Uses the F() macro to print strings directly from Program Memory without using RAM.
+/// The line is composed by ConsoleLine, and goes out in one piece.
+#define PRINT_VAR( x ) ConsoleLine.print( F( #x " =\t" ) ); ConsoleLine.println( x ); ConsoleLine.Flush();
+
+/// Verbosity ceiling.  Message bits outside MM_CEILING can't be turned on, and the output they
+/// guard compiles to nothing, strings and all, since MM_ON() is then false at compile time.  Below
+/// the ceiling, the V commands work as ever.  A release build might use, e.g.,
+///
+///     -DMM_CEILING=MM_RESPONSES
+///
+/// which keeps the command responses and strips the diagnostics.  The default is everything.
+#ifndef MM_CEILING
+#define MM_CEILING      0xFFFF
+#endif
+
+/// true if any of the MASK bits are on in _messageMask, and allowed by the ceiling
+#define MM_ON( MASK ) ( ( ( MASK ) & MM_CEILING ) && ( _messageMask & ( MASK ) & MM_CEILING ) )
 
-#define IF_MASK( MASK ) if ( _messageMask & MASK )
-#define PROGRESS_MSG( MSG ) if ( _messageMask & MM_PROGRESS ) Serial.println( F( MSG ) )
+#define IF_MASK( MASK ) if ( MM_ON( MASK ) )
+#define PROGRESS_MSG( MSG ) if ( MM_ON( MM_PROGRESS ) ) { ConsoleLine.println( F( MSG ) ); ConsoleLine.Flush(); }
 
 #define USE_CSV
 
 #ifdef USE_CSV
 
 /// Determine whether to output CSV headings or data
-#define IF_CSV( MASK ) if ( _messageMask & MASK && pSubsumptionParams->PrintingCsv() )
+#define IF_CSV( MASK ) if ( MM_ON( MASK ) && pSubsumptionParams->PrintingCsv() )
 
-/// Output either heading or data, separated by commas (or other delimiter)
+/// Output either heading or data, separated by commas (or other delimiter).  The row builds up
+/// in ConsoleLine, and the Director ends it after the tick.
 #define CSV_OUT( VAR ) \
     if ( pSubsumptionParams->PrintingCsvHeadings() ) { \
-        Serial.print( _pName ); \
-        Serial.print( ':' ); \
-        Serial.print( F( #VAR ) ); \
+        ConsoleLine.print( _pName ); \
+        ConsoleLine.print( ':' ); \
+        ConsoleLine.print( F( #VAR ) ); \
     } \
     else { \
-        Serial.print( VAR ); \
+        ConsoleLine.print( VAR ); \
     } \
-    Serial.print( pSubsumptionParams->GetCsvDelimiter() );
+    ConsoleLine.print( pSubsumptionParams->GetCsvDelimiter() );
 #else
 #define IF_CSV( X ) 
 #define CSV_OUT( X )
@@ -14,107 +14,136 @@ CruiseControl::CruiseControl( CommandDispatcher* pCD, Position* pOD ) : Behavior
 {
     _pPosition = pOD;
 
-    _kP = 1.0;
-    _kI = 0.5;
-    _kD = 0.0;
+    _pidLeft.SetGains( 2.0, 0.5, 0.0 );
+    _pidRight.SetGains( 2.0, 0.5, 0.0 );
+
+    // a starting guess:  full throttle yields about 10 IPS
+    _feedforward.SetPoint( 0, 0 );
+    _feedforward.SetPoint( 100, 255 );
 
     _pName = F("Cruise Control");
     _pHelpString =  F(  "  S <Speed> : Set cruising speed (IPS)\n"
-                        "  P <kP> <kI> <kD> : Set PID coefficients" 
+                        "  P <kP> <kI> <kD> : Set PID coefficients\n"
+                        "  F <Speed> <throttle> : Set feedforward point (IPS)\n"
+                        "  X : Clear feedforward table\n"
+                        "  T <Amplitude> <Cycles> <Hysteresis> : Autotune PID at cruising speed\n"
+                        "  A : Accept autotuned PID coefficients\n"
+                        "  N : Abandon autotuning"
                         );
 
     _bCruising = false;
+    _throttleLeft = _throttleRight = 0;
+    _targetSpeedIPS = 0.0;
+    _targetInterval = 0;
+    _targetTicks = _feedforwardThrottle = 0;
+    _bTuning = false;
 
     SubscribeTo( pCD, 'C' );    // All our commands begin with "C"
 }
 
 
+// convert the target speed into the loops' units.  Only needed when the speed or interval changes.
+void CruiseControl::updateTarget( uint16_t interval )
+{
+    _targetInterval = interval;
+    _targetTicks = _targetSpeedIPS * _pPosition->GetTicksPerInch() * interval / 1000 + 0.5;
+    _feedforwardThrottle = _feedforward.Lookup( _targetSpeedIPS * 10 );
+}
+
+
 // if we were not already cruising, but have just assumed control (i.e., no other
-// behavior has asserted itself this interval), note the Position readings so 
-// we can maintain our heading by keeping the same differential.
+// behavior has asserted itself this interval), take over the current throttle settings
+// and hold the speed from there.
 void CruiseControl::handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams )
 {
     // nothing to do if we're not enabled
     if ( _bEnabled ) {
-        SubsumptionParams* pSubsumptionParams = (SubsumptionParams*) pEvent->pData;
-
-        if ( ! pSubsumptionParams->ControlFreak() ) {
+        if ( pSubsumptionParams->ControlFreak() ) {
+            // someone else is driving
             _bCruising = false;
+
+            if ( _bTuning ) {
+                stopTuning();
+                IF_MASK( MM_RESPONSES ) {
+                    SerialTx.println( F( "\nAutotune abandoned:  subsumed" ) );
+                }
+            }
         }
-        else {  // nobody else cares, so it's our turn
-            float targetSpeedInchesPerInterval = ( _targetSpeedIPS * pSubsumptionParams->GetInterval() ) / 1000;
+        else if ( _bTuning ) {
+            if ( pSubsumptionParams->GetInterval() != _targetInterval ) {
+                updateTarget( pSubsumptionParams->GetInterval() );
+            }
 
-            if ( _bCruising ) {    // this means we were already cruising
-                // check our position and calculate error values
+            // the relays stand in for the PID loops until both sides are done
+            _throttleLeft  = _tunerLeft.Update(  _targetTicks, _pPosition->_deltaTicksLeft );
+            _throttleRight = _tunerRight.Update( _targetTicks, _pPosition->_deltaTicksRight );
 
-                // delta is how far we have moved in this interval
-                float deltaLeft  = _pPosition->_leftInches  - _prevPositionLeft;
-                float deltaRight = _pPosition->_rightInches - _prevPositionRight;
+            IF_CSV( MM_CSVBASIC ) {
+                CSV_OUT( _targetTicks );
+                CSV_OUT( _pPosition->_deltaTicksLeft );
+                CSV_OUT( _throttleLeft );
+                CSV_OUT( _pPosition->_deltaTicksRight );
+                CSV_OUT( _throttleRight );
+            }
 
-                // error is the difference between how far we expected to move and how far we actually moved.
-                float errorInchesLeft  = targetSpeedInchesPerInterval - deltaLeft;
-                float errorInchesRight = targetSpeedInchesPerInterval - deltaRight;
+            if ( _tunerLeft.GetState() != RelayTuner::eTunerRunning && _tunerRight.GetState() != RelayTuner::eTunerRunning ) {
+                // the loops take over again from here next tick
+                _bTuning = false;
+                _bCruising = false;
 
-                // Derivative uses the change in error between the last two intervals
-                float deltaErrorLeft  = _prevErrorLeft  - errorInchesLeft;
-                float deltaErrorRight = _prevErrorRight - errorInchesRight;
+                SerialTx.println( F( "\nAutotune complete" ) );
+                SerialTx.print( F( " Left:  " ) );
+                _tunerLeft.Print();
+                SerialTx.print( F( " Right: " ) );
+                _tunerRight.Print();
+                if ( _tunerLeft.GetState() == RelayTuner::eTunerDone && _tunerRight.GetState() == RelayTuner::eTunerDone ) {
+                    SerialTx.println( F( " CA to accept, CN to discard" ) );
+                }
+            }
 
-                // Integral term uses error in absolute position
-                float cumulativeErrorLeft  = _idealPositionLeft  - _pPosition->_leftInches;
-                float cumulativeErrorRight = _idealPositionRight - _pPosition->_rightInches;
+            pSubsumptionParams->SetThrottles( _throttleLeft, _throttleRight, this );
+        }
+        else {  // nobody else cares, so it's our turn
+            if ( pSubsumptionParams->GetInterval() != _targetInterval ) {
+                updateTarget( pSubsumptionParams->GetInterval() );
+            }
 
-                // calculate new throttle positions using PID
-                _throttleLeft  += ( ( _kP * errorInchesLeft  ) + ( _kI * cumulativeErrorLeft  ) + ( _kD * deltaErrorLeft ) );
-                _throttleRight += ( ( _kP * errorInchesRight ) + ( _kI * cumulativeErrorRight ) + ( _kD * deltaErrorRight ) );
+            if ( _bCruising ) {    // this means we were already cruising
+                _throttleLeft  = _pidLeft.Update(  _targetTicks, _pPosition->_deltaTicksLeft,  _feedforwardThrottle );
+                _throttleRight = _pidRight.Update( _targetTicks, _pPosition->_deltaTicksRight, _feedforwardThrottle );
 
                 // Show our work
-                if ( _messageMask & MM_PROGRESS ) {
-                    Serial.println( F( "\nCruise Control PID calc:" ) );
-                    PRINT_VAR( _idealPositionLeft );
-                    PRINT_VAR( _pPosition->_leftInches );
-                    PRINT_VAR( _prevPositionLeft );
-                    PRINT_VAR( deltaLeft );
-                    PRINT_VAR( targetSpeedInchesPerInterval );
-                    PRINT_VAR( errorInchesLeft );
-                    PRINT_VAR( cumulativeErrorLeft );
-                    PRINT_VAR( _kI * cumulativeErrorLeft );
+                IF_MASK( MM_PROGRESS ) {
+                    SerialTx.println( F( "\nCruise Control PID calc:" ) );
+                    PRINT_VAR( _targetTicks );
+                    PRINT_VAR( _pPosition->_deltaTicksLeft );
+                    PRINT_VAR( _pidLeft.GetIntegral() );
+                    PRINT_VAR( _throttleLeft );
+                    PRINT_VAR( _pPosition->_deltaTicksRight );
+                    PRINT_VAR( _pidRight.GetIntegral() );
+                    PRINT_VAR( _throttleRight );
                 }
 
                 IF_CSV( MM_CSVBASIC ) {
-                    CSV_OUT( targetSpeedInchesPerInterval );                      
-                    CSV_OUT( _idealPositionLeft );                     
-                    CSV_OUT( _prevPositionLeft );                      
-                    CSV_OUT( deltaLeft );                              
-                    CSV_OUT( errorInchesLeft );                              
-                    CSV_OUT( cumulativeErrorLeft );                    
-                    CSV_OUT( _kI * cumulativeErrorLeft );              
-                    CSV_OUT( _idealPositionRight );                     
-                    CSV_OUT( _prevPositionRight );                      
-                    CSV_OUT( deltaRight );                              
-                    CSV_OUT( errorInchesRight );                              
-                    CSV_OUT( cumulativeErrorRight );                    
-                    CSV_OUT( _kI * cumulativeErrorRight );              
+                    CSV_OUT( _targetTicks );
+                    CSV_OUT( _pPosition->_deltaTicksLeft );
+                    CSV_OUT( _pidLeft.GetIntegral() );
+                    CSV_OUT( _throttleLeft );
+                    CSV_OUT( _pPosition->_deltaTicksRight );
+                    CSV_OUT( _pidRight.GetIntegral() );
+                    CSV_OUT( _throttleRight );
                 }
-
-                // Upate some numbers for the next time
-                _prevErrorLeft = errorInchesLeft;
-                _prevErrorRight = errorInchesRight;
-
-                _prevPositionLeft = _pPosition->_leftInches;
-                _prevPositionRight = _pPosition->_rightInches;
             }
             else {  // we just took control, so let's cruise!
                 _bCruising = true;
 
-                // set up for 0 errors next pass
-                _prevPositionLeft = _idealPositionLeft = _pPosition->_leftInches;
-                _prevPositionRight = _idealPositionRight = _pPosition->_rightInches;
+                // carry on from whoever had control last, rather than from wherever we left off
+                _throttleLeft = pSubsumptionParams->GetLeftThrottle();
+                _throttleRight = pSubsumptionParams->GetRightThrottle();
+                _pidLeft.Reset( _pPosition->_deltaTicksLeft, _throttleLeft, _feedforwardThrottle );
+                _pidRight.Reset( _pPosition->_deltaTicksRight, _throttleRight, _feedforwardThrottle );
             }
 
-            // set the next ideal target positions
-            _idealPositionLeft += targetSpeedInchesPerInterval;
-            _idealPositionRight += targetSpeedInchesPerInterval;
-
             // set the throttle positions.
             pSubsumptionParams->SetThrottles( _throttleLeft, _throttleRight, this );
         }
@@ -131,24 +160,68 @@ void CruiseControl::handleCommandEvent( EventNotification* pEvent, CommandArgs*
         case 'S' : // set target speed in IPS
             // Set the crusing speed from the command argument
             // Speed is in IPS, calculate encoder ticks per interval and use this as the target speed
-            _targetSpeedIPS = pData->fParams[ 0 ];
+            SetCruiseSpeed( pData->fParams[ 0 ] );
 
-            if ( _messageMask & MM_RESPONSES ) {
-                Serial.print( F( "\nCruise Speed set to " ) );
-                Serial.print( _targetSpeedIPS );
-                Serial.println( F( " IPS" ) );
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "\nCruise Speed set to " ) );
+                SerialTx.print( _targetSpeedIPS );
+                SerialTx.println( F( " IPS" ) );
             }
             break;
         case 'P' : // Set PID parameters
-            _kP = pData->fParams[ 0 ];
-            _kI = pData->fParams[ 1 ];
-            _kD = pData->fParams[ 2 ];
-            if ( _messageMask & MM_RESPONSES ) {
-                Serial.println( F( "P\tI\tD" ) );
-                Serial.print( _kP ); Serial.print( '\t' );
-                Serial.print( _kI ); Serial.print( '\t' );
-                Serial.println( _kD );
+            _pidLeft.SetGains( pData->fParams[ 0 ], pData->fParams[ 1 ], pData->fParams[ 2 ] );
+            _pidRight.SetGains( pData->fParams[ 0 ], pData->fParams[ 1 ], pData->fParams[ 2 ] );
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.println( F( "P\tI\tD" ) );
+                SerialTx.print( _pidLeft.GetKP(), 4 ); SerialTx.print( '\t' );
+                SerialTx.print( _pidLeft.GetKI(), 4 ); SerialTx.print( '\t' );
+                SerialTx.println( _pidLeft.GetKD(), 4 );
+            }
+            break;
+        case 'F' : // Set a feedforward point
+            if ( ! _feedforward.SetPoint( pData->fParams[ 0 ] * 10, pData->nParams[ 1 ] ) ) {
+                SerialTx.println( F( "Feedforward table is full" ) );
             }
+            _targetInterval = 0;
+            IF_MASK( MM_RESPONSES ) {
+                _feedforward.Print();
+            }
+            break;
+        case 'X' : // Clear the feedforward table
+            _feedforward.Clear();
+            _targetInterval = 0;
+            break;
+        case 'T' : // autotune.  0 for any argument gives its default
+            if ( _targetSpeedIPS == 0.0 ) {
+                SerialTx.println( F( "Set a cruising speed to tune at" ) );
+                break;
+            }
+            // swing the relays about the throttles which have been holding our speed
+            _tunerLeft.Start(  _throttleLeft,  pData->nParams[ 0 ] ? pData->nParams[ 0 ] : 40, pData->nParams[ 1 ] ? pData->nParams[ 1 ] : 4, pData->nParams[ 2 ] );
+            _tunerRight.Start( _throttleRight, pData->nParams[ 0 ] ? pData->nParams[ 0 ] : 40, pData->nParams[ 1 ] ? pData->nParams[ 1 ] : 4, pData->nParams[ 2 ] );
+            _bTuning = true;
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.println( F( "Autotuning" ) );
+            }
+            break;
+        case 'A' : // accept the autotuned gains
+            if ( _tunerLeft.GetState() == RelayTuner::eTunerDone && _tunerRight.GetState() == RelayTuner::eTunerDone ) {
+                float kP, kI, kD;
+                _tunerLeft.ProposeGains( kP, kI, kD );
+                _pidLeft.SetGains( kP, kI, kD );
+                _tunerRight.ProposeGains( kP, kI, kD );
+                _pidRight.SetGains( kP, kI, kD );
+                stopTuning();
+                IF_MASK( MM_RESPONSES ) {
+                    PrintSpecificParameterValues();
+                }
+            }
+            else {
+                SerialTx.println( F( "No autotuned coefficients to accept" ) );
+            }
+            break;
+        case 'N' : // abandon autotuning, or discard its results
+            stopTuning();
             break;
         }
 }
@@ -156,13 +229,28 @@ void CruiseControl::handleCommandEvent( EventNotification* pEvent, CommandArgs*
 
 void CruiseControl::PrintSpecificParameterValues()
 {
-    Serial.print( F( " Cruising Speed (IPS): " ) );
-    Serial.println( _targetSpeedIPS );
-
-    Serial.print( F( " PID:\t" ) );
-    Serial.print( _kP );
-    Serial.print( '\t' );
-    Serial.print( _kI );
-    Serial.print( '\t' );
-    Serial.println( _kD );
+    ConsoleLine.Format( F( " Cruising Speed (IPS): %f\n" ), _targetSpeedIPS );
+    ConsoleLine.Format( F( " PID left:\t%.4f\t%.4f\t%.4f\n" ), _pidLeft.GetKP(), _pidLeft.GetKI(), _pidLeft.GetKD() );
+    ConsoleLine.Format( F( " PID right:\t%.4f\t%.4f\t%.4f\n" ), _pidRight.GetKP(), _pidRight.GetKI(), _pidRight.GetKD() );
+    ConsoleLine.Flush();
+
+    if ( _tunerLeft.GetState() != RelayTuner::eTunerIdle ) {
+        SerialTx.print( F( " Autotune left:  " ) );
+        _tunerLeft.Print();
+        SerialTx.print( F( " Autotune right: " ) );
+        _tunerRight.Print();
+    }
+
+    ConsoleLine.Format( F( " Target ticks per interval: %d\n" ), _targetTicks );
+    ConsoleLine.Flush();
+
+    _feedforward.Print();
+}
+
+
+void CruiseControl::stopTuning()
+{
+    _tunerLeft.Stop();
+    _tunerRight.Stop();
+    _bTuning = false;
 }
@@ -13,6 +13,7 @@ Subsumption Architecture as described by David P. Anderson.
 #include <CommandDispatcher.h>
 #include <Director.h>
 #include <Position.h>
+#include <PidController.h>
 
 // CruiseControl
 //
@@ -28,50 +29,56 @@ Subsumption Architecture as described by David P. Anderson.
 //
 // Speed Limit is set (in IPS) by sending a command (CS) or by suggestion passed down from higher
 // priority behaviors (such as Navigator).  This speed is used to calculate a target distance (in
-// encoder ticks) which is to be added at each interval to determine whether each motor is running
-// at the proper speed.
+// encoder ticks) which we should cover in each interval if each motor is running at the proper speed.
 //
-// When CruiseControl gains control after having been subsumed, it samples the current Position
-// readings in order to maintain the current heading.  It calculates the expected (target) Position
-// readings for the next interval by adding the pre-computed target distance to the current readings.
+// When CruiseControl gains control after having been subsumed, it takes over the throttle settings
+// it finds, and from then on runs a PidController per motor, comparing the encoder ticks counted
+// in each interval with the ticks we'd count at the target speed.  Since the integral of speed
+// error is position error, keeping both wheels at the same speed this way also holds our heading.
 //
-// At subsequent intervals, the current Position readings are subtracted from the target readings
-// to compute an error value.  This error value is then used in to compute adjustments using what
-// is effectively a PID algorithm.  The error is used directly (with an appropriate coefficient, which
-// is set with the CP command) to compute the P (proportional) term.  The I (Integral) term is actually
-// computed by comparing the current Position reading with the projected ideal Position reading.  This
-// ideal is computed by simply adding the target distance to the previous ideal at each interval, so that
-// the errors will accumulate.  A D (Derivative) term could be computed, as well, if it proves useful.
-// The commands for setting the I and D coefficients are CI and CD.  All commands take a float argument.
+// A FeedforwardTable gives the throttle expected to produce the target speed, so the PID loops
+// only have to correct the difference.  The gains are set with CP, and feedforward points with CF.
+//
+// The gains can be found automatically with CT, which replaces the PID loops with a RelayTuner on
+// each side for a few cycles of oscillation around the cruising speed.  The proposed gains are
+// reported, and applied with CA (or discarded with CN).  Tuning runs only while CruiseControl has
+// control, and is abandoned if another behavior subsumes it.
+//
+// All of the per-tick arithmetic is integer; the float conversions happen only when the speed or
+// the interval changes.
 
 class CruiseControl : public Behavior
 {
-    float       _idealPositionLeft;
-    float       _idealPositionRight;
+    PidController       _pidLeft;
+    PidController       _pidRight;
+    FeedforwardTable    _feedforward;
+
+    int                 _throttleLeft;
+    int                 _throttleRight;
 
-    float       _prevPositionLeft;
-    float       _prevPositionRight;
+    float               _targetSpeedIPS;
 
-    float       _prevErrorLeft;
-    float       _prevErrorRight;
+    // the target speed in the loops' units, recomputed when the speed or interval changes
+    uint16_t            _targetInterval;    // 0 to force recomputing
+    int16_t             _targetTicks;       // encoder ticks per interval
+    int16_t             _feedforwardThrottle;
 
-    int         _throttleLeft;
-    int         _throttleRight;
+    bool                _bCruising;
 
-    float       _targetSpeedIPS;
+    RelayTuner          _tunerLeft;
+    RelayTuner          _tunerRight;
+    bool                _bTuning;
 
-    bool        _bCruising;
+    void                stopTuning();
 
-    Position*   _pPosition;
+    Position*           _pPosition;
 
-    float       _kP;
-    float       _kI;
-    float       _kD;
+    void                updateTarget( uint16_t interval );
 
 public:
     CruiseControl( CommandDispatcher* pCD, Position* pOD );
 
-    void SetCruiseSpeed( float speedIPS )    { _targetSpeedIPS = speedIPS; }
+    void SetCruiseSpeed( float speedIPS )    { _targetSpeedIPS = speedIPS; _targetInterval = 0; }
 
     virtual void    handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs );
     virtual void    handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams );
@@ -10,8 +10,10 @@ Subsumption Architecture as described by David P. Anderson.
 
 #include "Director.h"
 
-Director::Director( CommandDispatcher* pCD, uint16_t interval) : Behavior( pCD ), _pCD( pCD ), /*_intervalMS( interval ),*/ _bEnabled( true ), _bInhibit( true )
+Director::Director( CommandDispatcher* pCD, uint16_t interval) : Behavior( pCD ), _pCD( pCD ), /*_intervalMS( interval ),*/ _bEnabled( true ), _bInhibit( true ), _bTickRequested( false ), _pendingStamps( 0 ), _commandCount( 0 ), _pLastControlledBy( NULL )
 {
+    _controlParams.SetInterval( interval );
+
     _pName = F("Director");
 
     // we'll turn on the LED during execution of the subsumption chain
@@ -27,7 +29,8 @@ Director::Director( CommandDispatcher* pCD, uint16_t interval) : Behavior( pCD )
     _pHelpString =  F(  "  I <ms>: set interval ms\n"
                         "  G : Go\n"
                         "  L : Start CSV Logging\n"
-                        "  S : stop"
+                        "  S : stop\n"
+                        "  Z : Clear console output statistics"
                     );
 }
 
@@ -42,38 +45,118 @@ Director::~Director(void)
 // and publishes it to all the Behaviors.
 void Director::Update()
 {
-    if ( millis() >= _tickTimeMS ) {
-        digitalWrite( 13, HIGH );   // turn the LED on for the duration of this event to give a visual indication of the time required.
+    if ( StepIfRequested() ) {
+        return;
+    }
 
+    if ( millis() >= _tickTimeMS ) {
         _tickTimeMS += _controlParams.GetInterval();
+        Step();
+    }
+}
 
-        if ( _bInhibit ) {
-            _controlParams.SetThrottles( 0, 0, this );
-        }
-        else {
-            // not inhibiting, let someone else have a chance for a change
-            _controlParams.ControlledBy( NULL );
+
+bool Director::StepIfRequested()
+{
+    if ( ! _bTickRequested ) {
+        return false;
+    }
+    _bTickRequested = false;
+
+    // the Behaviors can tell this tick apart, so they don't take it for a whole interval
+    _controlParams.SetUrgent( true );
+    Step();
+    _controlParams.SetUrgent( false );
+
+    return true;
+}
+
+
+void Director::Stamp( eLatencySource source, unsigned long us )
+{
+    if ( ! ( _pendingStamps & ( 1 << source ) ) ) {
+        _pendingMicros[ source ] = us;
+        _pendingStamps |= 1 << source;
+    }
+}
+
+
+void Director::Step()
+{
+    digitalWrite( 13, HIGH );   // turn the LED on for the duration of this event to give a visual indication of the time required.
+    TRACE_BEGIN( _controlParams.IsUrgent() ? "Urgent tick" : "Tick", "ms", millis() );
+    unsigned long start = micros();
+
+    // whatever the Behaviors print during the tick is telemetry, and can be dropped if the port's
+    // behind, rather than hold up the tick
+    ConsoleLine.Flush();
+    uint8_t lane = SerialTx.SetLane( eTxTelemetry );
+
+    // pass this tick's stimuli on, for the output stage to time.  A command line since the last tick
+    // is one too.
+    _controlParams.ClearStamps();
+    noInterrupts();
+    if ( _pCD && _pCD->GetLineCount() != _commandCount ) {
+        _commandCount = _pCD->GetLineCount();
+        Stamp( eLatencyCommand, _pCD->GetLineMicros() );
+    }
+    for ( uint8_t source = 0; source < eLatencySources; source++ ) {
+        if ( _pendingStamps & ( 1 << source ) ) {
+            _controlParams.Stamp( source, _pendingMicros[ source ] );
         }
+    }
+    _pendingStamps = 0;
+    interrupts();
 
-        // add a visual divider at the beginning of the subsumption chain
-        PROGRESS_MSG( "\n----" );
-        
-        // send the event down the chain
-        publish( _pFirstSubscriber, &_notification );
+    if ( _bInhibit ) {
+        _controlParams.SetThrottles( 0, 0, this );
+    }
+    else {
+        // not inhibiting, let someone else have a chance for a change
+        _controlParams.ControlledBy( NULL );
+    }
+
+    // add a visual divider at the beginning of the subsumption chain
+    PROGRESS_MSG( "\n----" );
+    
+    // send the event down the chain
+    publish( _pFirstSubscriber, &_notification );
 
 #ifdef USE_CSV
-        // CSV state change.  If we've done headings, move on to data.
-        if ( _controlParams.PrintingCsvHeadings() ) {
-            _controlParams.PrintCsvData();
-        }
+    // CSV state change.  If we've done headings, move on to data.
+    if ( _controlParams.PrintingCsvHeadings() ) {
+        _controlParams.PrintCsvData();
+    }
 #endif
 
-        if ( _controlParams.PrintingCsv() ) {
-            Serial.println();
-        }
+    if ( _controlParams.PrintingCsv() ) {
+        ConsoleLine.println();
+    }
+    ConsoleLine.Flush();
+    SerialTx.SetLane( lane );
 
-        digitalWrite( 13, LOW );
+    // mark a change of control, which is where the interesting part of a trace usually is
+    if ( _controlParams.ControlFreak() != _pLastControlledBy ) {
+        _pLastControlledBy = _controlParams.ControlFreak();
+        TRACE_INSTANT( "Control", "by", _pLastControlledBy ? (const char*) _pLastControlledBy->GetName() : "none" );
     }
+    TRACE_COUNTER( "Throttle", "left", _controlParams.GetLeftThrottle(), "right", _controlParams.GetRightThrottle() );
+    TRACE_END();
+
+    // the Director's budget is for the whole tick, and it only counts overruns:  the Behaviors'
+    // own budgets say what's to be done about them
+    recordTime( micros() - start );
+
+    SerialTx.Drain();
+    digitalWrite( 13, LOW );
+}
+
+
+void Director::PrintSpecificParameterValues()
+{
+    SerialTx.print( F( " Interval (ms): " ) );
+    SerialTx.println( _controlParams.GetInterval() );
+    SerialTx.PrintStats();
 }
 
 
@@ -82,30 +165,33 @@ void Director::handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs
     switch ( pArgs->inputBuffer[1] ) {
         case 'I' : // set interval
             _controlParams.SetInterval( pArgs->nParams[0] );
-            if ( _messageMask & MM_RESPONSES ) {
-                Serial.print( F( "Subsumption Interval milliseconds = " ) );
-                Serial.println( _controlParams.GetInterval() );
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Subsumption Interval milliseconds = " ) );
+                SerialTx.println( _controlParams.GetInterval() );
             }
             break;
         case 'S' :  // Stop -- inhibit all Behaviors
             _bInhibit = true;
             _controlParams.StopCsvOutput();
-            if ( _messageMask & MM_RESPONSES ) {
-                Serial.println( F( "Director Stopped" ) );
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.println( F( "Director Stopped" ) );
             }
             break;
         case 'G' :  // Go -- allow Behaviors to behave
             _bInhibit = false;
-            if ( _messageMask & MM_RESPONSES ) {
-                Serial.println( F( "\n==========================\nDirector Started" ) );
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.println( F( "\n==========================\nDirector Started" ) );
             }
             break;
         case 'L' : // begin CSV logging
             _controlParams.PrintCsvHeadings();
-            if ( _messageMask & MM_RESPONSES ) {
-                Serial.println( F( "Director Starting CSV data logging" ) );
-                Serial.println( F( "First, the CSV headings . . ." ) );
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.println( F( "Director Starting CSV data logging" ) );
+                SerialTx.println( F( "First, the CSV headings . . ." ) );
             }
             break;
+        case 'Z' : // clear console output statistics
+            SerialTx.ClearStats();
+            break;
     }
 }
@@ -12,6 +12,8 @@ Subsumption Architecture as described by David P. Anderson.
 
 #include <CommandDispatcher.h>
 #include <Behavior.h>
+#include <Latency.h>
+#include <Trace.h>
 
 // SubsumptionParams contains the motor control values which are passed through the Subsumption stack
 // and end up controlling the motors
@@ -30,9 +32,18 @@ class SubsumptionParams
 
     uint16_t    _stepIntervalMillis;
 
+    bool        _bUrgent;   // this tick is out of the regular cycle, and only reflex Behaviors see it
+
+    // the stimuli this tick is responding to, for the output stage to measure the latency of
+    LatencyStamp    _stamps[ eLatencySources ];
+    uint16_t        _lastStampId;
+
 public:
 
-    SubsumptionParams() : _throttleLeft( 0 ), _throttleRight( 0 ), _csvState( eCsvIdle ), _csvDelimiter( '\t' ), _stepIntervalMillis( 1000 ) {};
+    SubsumptionParams() : _pTakenBy( NULL ), _throttleLeft( 0 ), _throttleRight( 0 ), _csvState( eCsvIdle ), _csvDelimiter( '\t' ), _stepIntervalMillis( 1000 ), _bUrgent( false ), _lastStampId( 0 )
+    {
+        ClearStamps();
+    }
 
     void        ControlledBy( Behavior* pBehavior )     { _pTakenBy = pBehavior; }
     Behavior*   ControlFreak()							{ return _pTakenBy; }
@@ -45,14 +56,26 @@ public:
 
     void        SetCsvDelimiter( char delimiter )       { _csvDelimiter = delimiter; }
     char        GetCsvDelimiter()                       { return _csvDelimiter; }
-    bool        PrintingCsv()                           { return _csvState != eCsvIdle; }
-    bool        PrintingCsvHeadings()                   { return _csvState == eCsvHeadings; }
-    bool        PrintingCsvData()                       { return _csvState == eCsvData; }
+    // only regular ticks, which every Behavior sees, make a CSV row
+    bool        PrintingCsv()                           { return _csvState != eCsvIdle && ! _bUrgent; }
+    bool        PrintingCsvHeadings()                   { return _csvState == eCsvHeadings && ! _bUrgent; }
+    bool        PrintingCsvData()                       { return _csvState == eCsvData && ! _bUrgent; }
     void        PrintCsvHeadings()                      { _csvState = eCsvHeadings; }
     void        PrintCsvData()                          { _csvState = eCsvData; }
     void        StopCsvOutput()                         { _csvState = eCsvIdle; }
     uint16_t    GetInterval()                           { return _stepIntervalMillis; }
-    uint16_t    SetInterval( uint16_t interval )        { _stepIntervalMillis = interval; }
+    void        SetInterval( uint16_t interval )        { _stepIntervalMillis = interval; }
+    bool        IsUrgent()                              { return _bUrgent; }
+    void        SetUrgent( bool bUrgent )               { _bUrgent = bUrgent; }
+
+    // stamp a stimulus which happened at us, giving it the next ID
+    void        Stamp( uint8_t source, unsigned long us )
+    {
+        _stamps[ source ].id = ++_lastStampId ? _lastStampId : ++_lastStampId;
+        _stamps[ source ].micros = us;
+    }
+    const LatencyStamp& GetStamp( uint8_t source )     { return _stamps[ source ]; }
+    void        ClearStamps()                           { memset( _stamps, 0, sizeof( _stamps ) ); }
 };
 
 
@@ -68,6 +91,15 @@ class Director : public Publisher, public Behavior
 //    uint16_t        _intervalMS;
     unsigned long   _tickTimeMS;
 
+    volatile bool   _bTickRequested;
+
+    // stimuli stamped since the last tick
+    volatile uint8_t        _pendingStamps;     // bit n for source n
+    volatile unsigned long  _pendingMicros[ eLatencySources ];
+    uint16_t                _commandCount;      // the command lines we've seen
+
+    Behavior*       _pLastControlledBy;     // at the end of the last tick, for the trace
+
     // SubsumptionParams object which is passed to all Behaviors through the Publisher's EventNotification.
     SubsumptionParams   _controlParams;
 
@@ -81,7 +113,32 @@ public:
     /// it sends the subsumption event to the subscribers.
     void Update();
 
+    /// Step() sends one subsumption event right away, regardless of the clock.  Update() calls this
+    /// when the interval has elapsed; a simulation can call it directly to run faster than real time.
+    void Step();
+
+    /// RequestTick() asks for an urgent tick, out of the regular cycle, as soon as Update() is next
+    /// called.  It's safe to call from an interrupt handler, so a reflex (a bumper, say) needn't wait
+    /// for the rest of the interval.  The regular ticks carry on as before.
+    ///
+    /// An urgent tick comes part way through an interval, so only reflex Behaviors (the output stage,
+    /// and those reacting to the stimulus) see it;  the rest, which work in whole intervals, wait for
+    /// the next regular tick.  See Behavior::_bReflex.
+    void RequestTick()      { _bTickRequested = true; }
+
+    /// StepIfRequested() runs the urgent tick, if one has been requested, returning true if it did.
+    /// Update() calls this; a simulation calling Step() itself can call it in between.
+    bool StepIfRequested();
+
+    /// when Update() will next Step(), by millis(), so a host program can sleep until then
+    unsigned long GetNextTickMillis()       { return _tickTimeMS; }
+
+    /// Stamp() notes when a stimulus happened, for the next tick to carry to the output stage.  Only
+    /// the first since the last tick counts.  Call it from an interrupt handler, or with interrupts off.
+    void Stamp( eLatencySource source, unsigned long us );
+
     virtual void        handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs );
     virtual void        handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams ) {}  // these would come from the Director
+    virtual void        PrintSpecificParameterValues();
 };
 
@@ -0,0 +1,290 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#include <DrivePlant.h>
+
+DrivePlant::DrivePlant( CommandDispatcher* pCD, Position* pPos ) : Behavior( pCD ), _pPosition( pPos ), _pOutput( NULL )
+{
+    _pName = F("Plant");
+    _pHelpString = F(  "  M <kg> <kg-in^2> : Set mass and moment of inertia\n"
+                        "  L <ms> : Set motor lag\n"
+                        "  F <force> <IPS> : Set motor stall force (kg-in/s^2) and free speed\n"
+                        "  D <Left> <Right> : Set drivetrain drag ratios\n"
+                        "  G <grip> : Set track/ground friction coefficient\n"
+                        "  N <ticks> : Set encoder noise\n"
+                        "  U <ms> : Set integration sub-step (1-5)\n"
+                        "  R : Stop, and return to the origin"
+                        );
+
+    SubscribeTo( pCD, 'S' );    // S for Simulator
+
+    // a rough Rover5:  about 10 IPS flat out, and it takes about 10% throttle to get moving
+    _massKg = 2.5;
+    _inertia = 25.0;
+    _drivetrainKg = 0.3;
+    _motorLagSec = 0.08;
+    _stallForce = 600.0;
+    _freeIPS = 12.0;
+    _coulomb = 60.0;
+    _viscous = 5.0;
+    _slipStiffness = 40.0;
+    _grip = 0.8;
+    _yawDamping = 200.0;
+    _noiseTicks = 0.0;
+
+    _substepMS = 2;
+
+    _left.dragRatio = _right.dragRatio = 1.0;
+    stop();
+}
+
+
+// bring everything to rest at the origin, heading North
+void DrivePlant::stop()
+{
+    _left.effort = _right.effort = 0.0;
+    _left.wheelIPS = _right.wheelIPS = 0.0;
+    _left.wheelInches = _right.wheelInches = 0.0;
+    _left.ticks = _right.ticks = 0;
+
+    _xInches = _yInches = _theta = 0.0;
+    _bodyIPS = _yawRate = 0.0;
+}
+
+
+// advance one side by dt, returning the force its track puts on the ground
+void DrivePlant::stepSide( PlantSide& side, float dt, int throttle, float groundIPS, float& traction )
+{
+    // motor drive follows the throttle, with some lag
+    float target = constrain( throttle, -255, 255 ) / 255.0;
+    side.effort += _motorLagSec > dt ? ( target - side.effort ) * dt / _motorLagSec : target - side.effort;
+
+    // back EMF reduces the force as we speed up
+    float motorForce = _stallForce * ( side.effort - side.wheelIPS / _freeIPS );
+
+    // the track grips in proportion to its slip, up to what its share of the weight allows
+    float tractionLimit = _grip * _massKg * PLANT_GRAVITY_IPS2 / 2.0;
+    traction = constrain( _slipStiffness * ( side.wheelIPS - groundIPS ), -tractionLimit, tractionLimit );
+
+    float net = motorForce - traction - _viscous * side.dragRatio * side.wheelIPS;
+    float coulomb = _coulomb * side.dragRatio;
+    if ( side.wheelIPS == 0.0 ) {
+        // static friction holds the drivetrain until the other forces overcome it
+        net = fabs( net ) <= coulomb ? 0.0 : net - ( net > 0.0 ? coulomb : -coulomb );
+    }
+    else {
+        net -= side.wheelIPS > 0.0 ? coulomb : -coulomb;
+    }
+
+    // friction can stop the drivetrain, but never reverse it
+    float wheelIPS = side.wheelIPS + net / _drivetrainKg * dt;
+    if ( side.wheelIPS != 0.0 && ( wheelIPS > 0.0 ) != ( side.wheelIPS > 0.0 ) ) {
+        wheelIPS = 0.0;
+    }
+
+    side.wheelIPS = wheelIPS;
+    side.wheelInches += wheelIPS * dt;
+}
+
+
+void DrivePlant::step( float dt, int leftThrottle, int rightThrottle )
+{
+    float halfSpacing = _pPosition->GetWheelSpacing() / 2.0;
+    float tractionLeft, tractionRight;
+
+    // the ground under each track moves with the body, plus or minus the turn
+    stepSide( _left, dt, leftThrottle, _bodyIPS + _yawRate * halfSpacing, tractionLeft );
+    stepSide( _right, dt, rightThrottle, _bodyIPS - _yawRate * halfSpacing, tractionRight );
+
+    _bodyIPS += ( tractionLeft + tractionRight ) / _massKg * dt;
+    _yawRate += ( ( tractionLeft - tractionRight ) * halfSpacing - _yawDamping * _yawRate ) / _inertia * dt;
+
+    _theta += _yawRate * dt;
+    _xInches += _bodyIPS * sin( _theta ) * dt;
+    _yInches += _bodyIPS * cos( _theta ) * dt;
+}
+
+
+// quantize the track travel to whole ticks, and pass on the change, as the encoder interrupts would
+void DrivePlant::updateEncoder( PlantSide& side, int32_t& encoder )
+{
+    float ticks = side.wheelInches * _pPosition->GetTicksPerInch();
+    if ( _noiseTicks > 0.0 ) {
+        ticks += _noiseTicks * random( -1000, 1001 ) / 1000.0;
+    }
+    int32_t count = floor( ticks );
+
+    noInterrupts();
+    encoder += count - side.ticks;
+    interrupts();
+
+    side.ticks = count;
+}
+
+
+void DrivePlant::handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams )
+{
+    // we aren't a reflex, so this is a regular tick, and a whole interval to simulate.  Whatever the
+    // motors were told on an urgent tick since the last one is picked up here.
+    if ( _bEnabled ) {
+        // these throttles drive the motors until the next tick
+        int leftThrottle = _pOutput ? _pOutput->GetLeft() : pSubsumptionParams->GetLeftThrottle();
+        int rightThrottle = _pOutput ? _pOutput->GetRight() : pSubsumptionParams->GetRightThrottle();
+
+        // if the output is ramping, follow it to its target over the interval, as the motors will
+        int leftTarget = _pOutput && _pOutput->IsRamping() ? _pOutput->GetTargetLeft() : leftThrottle;
+        int rightTarget = _pOutput && _pOutput->IsRamping() ? _pOutput->GetTargetRight() : rightThrottle;
+
+        uint16_t interval = pSubsumptionParams->GetInterval();
+        uint16_t nSteps = max( ( interval + _substepMS - 1 ) / _substepMS, 1 );
+        float dt = interval / 1000.0 / nSteps;
+
+        for ( uint16_t ix = 0; ix < nSteps; ix++ ) {
+            step( dt,
+                leftThrottle + (int32_t) ( leftTarget - leftThrottle ) * ( ix + 1 ) / nSteps,
+                rightThrottle + (int32_t) ( rightTarget - rightThrottle ) * ( ix + 1 ) / nSteps );
+        }
+
+        updateEncoder( _left, _pPosition->_currentEncoderPositionLeft );
+        updateEncoder( _right, _pPosition->_currentEncoderPositionRight );
+
+        IF_MASK( MM_CALC ) {
+            PRINT_VAR( _left.wheelIPS );
+            PRINT_VAR( _right.wheelIPS );
+            PRINT_VAR( _bodyIPS );
+            PRINT_VAR( _yawRate );
+        }
+
+        IF_CSV( MM_CSVBASIC ) {
+            CSV_OUT( _xInches );
+            CSV_OUT( _yInches );
+            CSV_OUT( _bodyIPS );
+            CSV_OUT( _left.wheelIPS );
+            CSV_OUT( _right.wheelIPS );
+        }
+    }
+}
+
+
+void DrivePlant::handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs )
+{
+    switch( pArgs->inputBuffer[1] ) {
+        case 'M' : // mass and inertia
+            _massKg = max( pArgs->fParams[ 0 ], 0.1 );
+            if ( pArgs->fParams[ 1 ] > 0.0 ) {
+                _inertia = pArgs->fParams[ 1 ];
+            }
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Mass/inertia set to " ) );
+                SerialTx.print( _massKg ); SerialTx.print( '/' );
+                SerialTx.println( _inertia );
+            }
+            break;
+
+        case 'L' : // motor lag
+            _motorLagSec = max( pArgs->fParams[ 0 ], 0.0 ) / 1000.0;
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Motor lag (sec) set to " ) );
+                SerialTx.println( _motorLagSec, 3 );
+            }
+            break;
+
+        case 'F' : // motor stall force and free speed
+            _stallForce = max( pArgs->fParams[ 0 ], 1.0 );
+            if ( pArgs->fParams[ 1 ] > 0.0 ) {
+                _freeIPS = pArgs->fParams[ 1 ];
+            }
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Stall force/free speed set to " ) );
+                SerialTx.print( _stallForce ); SerialTx.print( '/' );
+                SerialTx.println( _freeIPS );
+            }
+            break;
+
+        case 'D' : // drag ratios
+            _left.dragRatio = max( pArgs->fParams[ 0 ], 0.0 );
+            _right.dragRatio = max( pArgs->fParams[ 1 ], 0.0 );
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Drag ratios set to " ) );
+                SerialTx.print( _left.dragRatio ); SerialTx.print( '\t' );
+                SerialTx.println( _right.dragRatio );
+            }
+            break;
+
+        case 'G' : // grip
+            _grip = max( pArgs->fParams[ 0 ], 0.0 );
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Grip set to " ) );
+                SerialTx.println( _grip );
+            }
+            break;
+
+        case 'N' : // encoder noise
+            _noiseTicks = max( pArgs->fParams[ 0 ], 0.0 );
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Encoder noise (ticks) set to " ) );
+                SerialTx.println( _noiseTicks );
+            }
+            break;
+
+        case 'U' : // sub-step.  Much longer than 5 ms, and the slip model goes unstable.
+            _substepMS = constrain( pArgs->nParams[ 0 ], 1, 5 );
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Sub-step (ms) set to " ) );
+                SerialTx.println( _substepMS );
+            }
+            break;
+
+        case 'R' : // stop
+            stop();
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.println( F( "Plant stopped at the origin" ) );
+            }
+            break;
+    }
+}
+
+
+void DrivePlant::PrintSpecificParameterValues()
+{
+    SerialTx.print( F( " True x, y, heading: " ) );
+    SerialTx.print( _xInches ); SerialTx.print( F( ", " ) );
+    SerialTx.print( _yInches ); SerialTx.print( F( ", " ) );
+    SerialTx.println( _theta * RAD_TO_DEG );
+
+    SerialTx.print( F( " Speed body/left/right (IPS): " ) );
+    SerialTx.print( _bodyIPS ); SerialTx.print( '/' );
+    SerialTx.print( _left.wheelIPS ); SerialTx.print( '/' );
+    SerialTx.println( _right.wheelIPS );
+
+    SerialTx.print( F( " Mass/inertia: " ) );
+    SerialTx.print( _massKg ); SerialTx.print( '/' );
+    SerialTx.println( _inertia );
+
+    SerialTx.print( F( " Motor lag (ms): " ) );
+    SerialTx.println( _motorLagSec * 1000.0 );
+
+    SerialTx.print( F( " Stall force/free speed: " ) );
+    SerialTx.print( _stallForce ); SerialTx.print( '/' );
+    SerialTx.println( _freeIPS );
+
+    SerialTx.print( F( " Drag ratios: " ) );
+    SerialTx.print( _left.dragRatio ); SerialTx.print( '/' );
+    SerialTx.println( _right.dragRatio );
+
+    SerialTx.print( F( " Grip: " ) );
+    SerialTx.println( _grip );
+
+    SerialTx.print( F( " Encoder noise (ticks): " ) );
+    SerialTx.println( _noiseTicks );
+
+    SerialTx.print( F( " Sub-step (ms): " ) );
+    SerialTx.println( _substepMS );
+}
@@ -0,0 +1,112 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+#include <CommandDispatcher.h>
+#include <Director.h>
+#include <Position.h>
+#include <MotorOutput.h>
+
+// standard gravity, in inches/sec^2
+#define PLANT_GRAVITY_IPS2      386.09
+
+
+// the state of one side (track) of the simulated platform
+struct PlantSide
+{
+    float       effort;         // motor drive, -1 to 1, lagging behind the throttle
+    float       wheelIPS;       // track surface speed
+    float       wheelInches;    // track travel, which is what the encoder measures
+    int32_t     ticks;          // encoder count last written to Position
+    float       dragRatio;      // drivetrain friction relative to nominal
+};
+
+
+// DrivePlant
+//
+// DrivePlant simulates the physics of a tracked, differential drive platform like the Rover5, so
+// we can run (and tune) the rest of the chain in an emulator, without the robot.  It takes the
+// final throttle settings from the end of the Subsumption chain, and drives Position's encoder
+// counts the way the real encoders would.
+//
+// Each side is modelled as:
+//
+//  * a motor whose drive follows the throttle with a first-order lag, and whose force falls off
+//    linearly with speed (back EMF), from the stall force at rest to zero at the free speed.
+//  * a drivetrain with its own small mass, Coulomb (static) and viscous friction.  The friction
+//    can be scaled per side, to model a side which drags.
+//  * a track which grips the ground with a force proportional to its slip, limited by the grip
+//    (friction coefficient) times its share of the weight.  Wheel spin shows up in the encoder
+//    counts, but not in the true pose.
+//
+// The body has mass and a moment of inertia about its center, with some yaw damping from the
+// tracks scrubbing sideways as it turns.  The encoder counts are the track travel quantized to
+// whole ticks, with optional jitter on the edges.
+//
+// The model is integrated with a fixed sub-step, independent of the Director interval, so changing
+// the interval doesn't change the physics.  Each Director tick advances it by one interval, so the
+// simulation runs in step with the Director, even when the Director is stepped faster than real time.
+//
+// DrivePlant should be subscribed to the Director first, so it comes last in the chain, after
+// the motor driver.  Given the driver's MotorOutput, it follows what the driver actually wrote,
+// after slew limiting and deadband;  otherwise it takes the throttles from the chain.  It never
+// takes control.
+class DrivePlant : public Behavior
+{
+    Position*       _pPosition;
+    MotorOutput*    _pOutput;
+
+    PlantSide       _left;
+    PlantSide       _right;
+
+    // the true pose and motion of the body, which odometry tries to follow
+    float           _xInches;
+    float           _yInches;
+    float           _theta;         // radians, clockwise from North, as Position has it
+    float           _bodyIPS;
+    float           _yawRate;       // radians/sec
+
+    // platform parameters
+    float           _massKg;
+    float           _inertia;       // kg-in^2
+    float           _drivetrainKg;  // effective mass of each side's motor, gears and track
+    float           _motorLagSec;
+    float           _stallForce;    // per side, kg-in/sec^2
+    float           _freeIPS;       // no-load speed at full throttle
+    float           _coulomb;       // drivetrain static friction, per side, kg-in/sec^2
+    float           _viscous;       // drivetrain viscous friction, per side, kg/sec
+    float           _slipStiffness; // traction force per IPS of slip, kg/sec
+    float           _grip;          // coefficient of friction between track and ground
+    float           _yawDamping;    // kg-in^2/sec
+    float           _noiseTicks;    // encoder edge jitter, in ticks
+
+    uint8_t         _substepMS;
+
+    void            stop();
+    void            step( float dt, int leftThrottle, int rightThrottle );
+    void            stepSide( PlantSide& side, float dt, int throttle, float groundIPS, float& traction );
+    void            updateEncoder( PlantSide& side, int32_t& encoder );
+
+public:
+
+    DrivePlant( CommandDispatcher* pCD, Position* pPos );
+
+    void            DriveFrom( MotorOutput* pOutput )   { _pOutput = pOutput; }
+
+    float           GetTrueX()          { return _xInches; }
+    float           GetTrueY()          { return _yInches; }
+    float           GetTrueTheta()      { return _theta; }
+    float           GetTrueIPS()        { return _bodyIPS; }
+
+    virtual void    handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs );
+    virtual void    handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams );
+    virtual void    PrintSpecificParameterValues();
+};
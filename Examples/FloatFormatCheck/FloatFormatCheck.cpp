@@ -0,0 +1,180 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+// FloatFormatCheck
+//
+// A host program (not a sketch) which checks FormatFixed() and FormatCompact() against the C
+// library.  It formats floats with every number of decimals:  random bit patterns, which cover
+// every exponent, and the sort of values telemetry prints, plus a few awkward ones.  Each result
+// is parsed back with strtod() and must be within half a unit of its last place of the float's
+// exact value;  FormatFixed() must also match printf( "%.*f" ) character for character, other
+// than on exact ties, which it rounds away from zero where printf rounds to even.
+//
+// FormatCompact() scales by 32-bit powers of 10, so it's allowed COMPACT_TOLERANCE of the value
+// as well:  at most six products (five for the bits of the exponent, one to put the estimate
+// right), each rounded to 32 bits from a power rounded to 32 bits, so 1.5 parts in 2^32 apiece.
+//
+// Build it from this directory with, e.g.:
+//
+//   g++ -std=c++11 -O2 -pthread -I../.. -o ffcheck FloatFormatCheck.cpp ../../*.cpp
+//
+// Options:
+//   --count n          random values of each kind (default 1000000)
+//   --seed n           (default 1)
+//
+// It prints the first few failures, and the totals, and exits 1 if there were any failures.
+
+#include "CommonDefs.h"
+#include <FloatFormat.h>
+
+#include <float.h>
+#include <random>
+#include <string>
+
+#define COMPACT_TOLERANCE   2.5e-9
+#define FAILURES_SHOWN      10
+
+static unsigned long _checks = 0;
+static unsigned long _failures = 0;
+
+
+static void fail( const char* pWhat, float value, uint8_t decimals, const char* pResult, const char* pExpected )
+{
+    if ( _failures++ < FAILURES_SHOWN ) {
+        printf( "%s %.9g, %u decimals:  %s, expected %s\n", pWhat, value, decimals, pResult, pExpected );
+    }
+}
+
+
+// the float's exact value is within half a unit of the last place of pResult, whose unit is
+// 10^-decimals times 10^exponent, give or take strtod()'s own rounding
+static bool roundTrips( const char* pResult, float value, int decimals, int exponent, double slack )
+{
+    double back = strtod( pResult, NULL );
+    double halfUnit = 0.5 * pow( 10.0, exponent - decimals );
+    return fabs( back - (double) value ) <= halfUnit * ( 1 + 1e-9 ) + fabs( back ) * 2 * DBL_EPSILON + slack;
+}
+
+
+static void checkFixed( float value, uint8_t decimals )
+{
+    char buf[ FLOAT_FORMAT_SIZE ];
+    char expected[ 64 ];
+
+    // values of 2^32 and more come out compact, and are checked as such
+    if ( fabsf( value ) >= 4294967296.0f ) {
+        return;
+    }
+    _checks++;
+    FormatFixed( buf, value, decimals );
+    snprintf( expected, sizeof( expected ), "%.*f", decimals, (double) value );
+
+    if ( ! roundTrips( buf, value, decimals, 0, 0.0 ) ) {
+        fail( "FormatFixed", value, decimals, buf, expected );
+    }
+    else if ( strcmp( buf, expected ) ) {
+        // only an exact tie may differ, and "-0" is printed as "0"
+        double back = strtod( buf, NULL );
+        double halfUnit = 0.5 * pow( 10.0, -decimals );
+        bool bTie = fabs( fabs( back - (double) value ) - halfUnit ) <= 1e-12 * fmax( 1.0, fabs( value ) );
+        bool bNegativeZero = expected[ 0 ] == '-' && strtod( expected, NULL ) == 0.0;
+        if ( ! bTie && ! bNegativeZero ) {
+            fail( "FormatFixed", value, decimals, buf, expected );
+        }
+    }
+}
+
+
+static void checkCompact( float value, uint8_t decimals )
+{
+    char buf[ FLOAT_FORMAT_SIZE ];
+    char expected[ 64 ];
+
+    _checks++;
+    FormatCompact( buf, value, decimals );
+    snprintf( expected, sizeof( expected ), "%.*e", decimals, (double) value );
+
+    // one digit before the point, and not 0 unless the value is
+    const char* pDigits = buf[ 0 ] == '-' ? buf + 1 : buf;
+    const char* pE = strchr( buf, 'e' );
+    int exponent = pE ? atoi( pE + 1 ) : 0;
+    if ( ! isdigit( pDigits[ 0 ] ) || isdigit( pDigits[ 1 ] ) || ( pDigits[ 0 ] == '0' && value != 0.0 ) ) {
+        fail( "FormatCompact", value, decimals, buf, expected );
+    }
+    else if ( ! roundTrips( buf, value, decimals, exponent, COMPACT_TOLERANCE * fabs( value ) ) ) {
+        fail( "FormatCompact", value, decimals, buf, expected );
+    }
+}
+
+
+static void check( float value, uint8_t decimals )
+{
+    if ( isnan( value ) || isinf( value ) ) {
+        return;
+    }
+    checkFixed( value, decimals );
+    checkCompact( value, decimals );
+}
+
+
+static void usage()
+{
+    fprintf( stderr, "usage: ffcheck [--count n] [--seed n]\n" );
+    exit( 1 );
+}
+
+
+int main( int argc, char* argv[] )
+{
+    unsigned long count = 1000000;
+    unsigned seed = 1;
+
+    for ( int i = 1; i < argc; i++ ) {
+        std::string arg = argv[ i ];
+        bool bHasValue = i + 1 < argc;
+
+        if ( arg == "--count" && bHasValue ) {
+            count = strtoul( argv[ ++i ], NULL, 10 );
+        }
+        else if ( arg == "--seed" && bHasValue ) {
+            seed = atoi( argv[ ++i ] );
+        }
+        else {
+            usage();
+        }
+    }
+
+    std::mt19937 rng( seed );
+    for ( unsigned long n = 0; n < count; n++ ) {
+        // any bit pattern
+        uint32_t bits = rng();
+        float value;
+        memcpy( &value, &bits, sizeof( value ) );
+        check( value, n % ( FLOAT_MAX_DECIMALS + 1 ) );
+
+        // a telemetry sort of value:  a few digits, and a few binary places
+        value = (float) ( (int32_t) ( rng() % 200000 ) - 100000 ) / (float) ( 1UL << ( rng() % 12 ) );
+        check( value, n % 7 );
+    }
+
+    static const float special[] =
+    {
+        0.0f, -0.0f, 0.5f, 0.005f, 0.125f, 9.995f, 99.5f, -1.5f, 1e-45f, 1.17549435e-38f,
+        3.40282347e38f, 4294967040.0f, 4294967296.0f, 12.345f, 1.0f, 10.0f, 1e10f, 1e-10f, 9.9999999f
+    };
+    for ( size_t ix = 0; ix < sizeof( special ) / sizeof( special[ 0 ] ); ix++ ) {
+        for ( uint8_t decimals = 0; decimals <= FLOAT_MAX_DECIMALS; decimals++ ) {
+            check( special[ ix ], decimals );
+        }
+    }
+
+    printf( "%lu checks, %lu failures\n", _checks, _failures );
+    return _failures ? 1 : 0;
+}
@@ -0,0 +1,233 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+// HostConsole
+//
+// A host program (Linux) which runs simulated robots in real time, each with a console that
+// the usual serial tools can talk to, as they would to the robot.  The robots are shared out
+// over a pool of threads, each with its own RobotContext, so there can be thousands.  A thread
+// sleeps in epoll until one of its robots has a command or is due a tick, so idle robots cost
+// next to nothing.
+//
+// Build it from this directory with, e.g.:
+//
+//   g++ -std=c++11 -O2 -pthread -I../.. -o console HostConsole.cpp ../../*.cpp
+//
+// and then:
+//
+//   ./console                          one robot, on stdin and stdout
+//   ./console --pty                    one robot on a pty;  its name is printed, for screen or minicom
+//   ./console --socket /tmp/robot      one robot on a Unix socket:  socat - UNIX-CONNECT:/tmp/robot
+//   ./console --socket /tmp/robot --robots 1000
+//                                      a thousand robots, on /tmp/robot.0 ... /tmp/robot.999
+//
+// Other options:
+//   --threads n        threads to share the robots (default: one per core, but no more than robots)
+//   --interval ms      Director interval (default 50)
+//   --seed n           each robot's random() is seeded with n plus its number (default 1)
+//
+// Each robot starts with the 4-foot square mission;  NR and DG set it going.  With the console
+// on stdin, the program ends with the input;  otherwise, with ^C.
+
+#include "CommonDefs.h"
+#include <SimRobot.h>
+#include <HostTransport.h>
+
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct Options
+{
+    enum { eStdio, ePty, eSocket } transport = eStdio;
+    std::string     socketPath;
+    unsigned        robots = 1;
+    unsigned        threads = std::max( 1u, std::thread::hardware_concurrency() );
+    unsigned        interval = 50;
+    unsigned        seed = 1;
+};
+
+
+// a robot and its console
+struct Slot
+{
+    SimRobot*       pRobot;
+    HostStream      console;
+};
+
+
+static bool openConsole( const Options& options, unsigned index, HostStream& console )
+{
+    std::string name;
+
+    switch ( options.transport ) {
+        case Options::eStdio :
+            console.OpenStdio();
+            break;
+        case Options::ePty :
+            if ( const char* pName = console.OpenPty() ) {
+                name = pName;
+            }
+            break;
+        case Options::eSocket :
+            name = options.robots > 1 ? options.socketPath + "." + std::to_string( index ) : options.socketPath;
+            if ( ! console.ListenUnix( name.c_str() ) ) {
+                name.clear();
+            }
+            break;
+    }
+    if ( ! console.IsOpen() ) {
+        fprintf( stderr, "robot %u: can't open its console\n", index );
+        return false;
+    }
+    if ( ! name.empty() ) {
+        fprintf( stderr, "robot %u: %s\n", index, name.c_str() );
+    }
+    return true;
+}
+
+
+// run robots first, first + step, ... on this thread, until all their consoles have closed
+static void runRobots( const Options& options, unsigned first, unsigned step )
+{
+    std::vector<Slot*> slots;
+    std::unordered_map<HostStream*, Slot*> slotOf;
+    HostEventLoop events;
+
+    for ( unsigned index = first; index < options.robots; index += step ) {
+        Slot* pSlot = new Slot;
+        if ( ! openConsole( options, index, pSlot->console ) ) {
+            delete pSlot;
+            continue;
+        }
+
+        // the new robot's context is current as it's set up
+        pSlot->pRobot = new SimRobot( options.interval );
+        pSlot->pRobot->dispatcher.SetConsole( &pSlot->console );
+        pSlot->pRobot->AppendSquare();
+        randomSeed( options.seed + index );
+
+        events.Add( &pSlot->console );
+        slotOf[ &pSlot->console ] = pSlot;
+        slots.push_back( pSlot );
+    }
+
+    HostStream* ready[ 64 ];
+    unsigned long nextTick = millis();
+
+    while ( ! slots.empty() ) {
+        // sleep until there's a command, or one of the robots is due a tick
+        long wait = (long) ( nextTick - millis() );
+        int nReady = events.Wait( max( 0L, wait ), ready, 64 );
+
+        for ( int ix = 0; ix < min( nReady, 64 ); ix++ ) {
+            Slot* pSlot = slotOf[ ready[ ix ] ];
+            pSlot->pRobot->context.MakeCurrent();
+            while ( pSlot->console.available() ) {
+                pSlot->pRobot->dispatcher.Update();
+            }
+            pSlot->pRobot->director.StepIfRequested();     // a BP press gets its urgent tick now
+            SerialTx.Drain();
+        }
+
+        // the clock is the same real one in every context
+        unsigned long now = millis();
+        nextTick = now + options.interval;
+        for ( size_t ix = 0; ix < slots.size(); ) {
+            Slot* pSlot = slots[ ix ];
+            SimRobot* pRobot = pSlot->pRobot;
+
+            if ( (long) ( pRobot->director.GetNextTickMillis() - now ) <= 0 ) {
+                pRobot->context.MakeCurrent();
+                pRobot->director.Update();
+                pRobot->bumper.Update();
+                pRobot->led.Update();
+                pRobot->waypoints.Update();
+                SerialTx.Drain();
+            }
+
+            if ( ! pSlot->console.IsOpen() ) {
+                // stdin has ended
+                pRobot->context.MakeCurrent();
+                SerialTx.Drain( true );
+                events.Remove( &pSlot->console );
+                slotOf.erase( &pSlot->console );
+                delete pRobot;
+                delete pSlot;
+                slots[ ix ] = slots.back();
+                slots.pop_back();
+                continue;
+            }
+
+            if ( (long) ( pRobot->director.GetNextTickMillis() - nextTick ) < 0 ) {
+                nextTick = pRobot->director.GetNextTickMillis();
+            }
+            ix++;
+        }
+    }
+}
+
+
+static void usage()
+{
+    fprintf( stderr, "usage: console [--pty | --socket path] [--robots n] [--threads n] [--interval ms] [--seed n]\n" );
+    exit( 1 );
+}
+
+
+int main( int argc, char* argv[] )
+{
+    Options options;
+
+    for ( int i = 1; i < argc; i++ ) {
+        std::string arg = argv[ i ];
+        bool bHasValue = i + 1 < argc;
+
+        if ( arg == "--pty" ) {
+            options.transport = Options::ePty;
+        }
+        else if ( arg == "--socket" && bHasValue ) {
+            options.transport = Options::eSocket;
+            options.socketPath = argv[ ++i ];
+        }
+        else if ( arg == "--robots" && bHasValue ) {
+            options.robots = std::max( 1, atoi( argv[ ++i ] ) );
+        }
+        else if ( arg == "--threads" && bHasValue ) {
+            options.threads = std::max( 1, atoi( argv[ ++i ] ) );
+        }
+        else if ( arg == "--interval" && bHasValue ) {
+            options.interval = std::max( 1, atoi( argv[ ++i ] ) );
+        }
+        else if ( arg == "--seed" && bHasValue ) {
+            options.seed = atoi( argv[ ++i ] );
+        }
+        else {
+            usage();
+        }
+    }
+
+    // stdin can only be one robot's console
+    if ( options.transport == Options::eStdio ) {
+        options.robots = 1;
+    }
+
+    options.threads = std::min( options.threads, options.robots );
+
+    std::vector<std::thread> pool;
+    for ( unsigned first = 0; first < options.threads; first++ ) {
+        pool.push_back( std::thread( runRobots, std::cref( options ), first, options.threads ) );
+    }
+    for ( size_t i = 0; i < pool.size(); i++ ) {
+        pool[ i ].join();
+    }
+    return 0;
+}
@@ -0,0 +1,190 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+// LatencyBounds
+//
+// A host program (not a sketch) which checks the robot's reaction times against their bounds.
+// A simulated robot runs its mission as loop() would run it, with the clock moving on through
+// each pass, a share after each call, while the program pokes at it at random moments:  bumper
+// presses, through the simulated switch pins and the interrupt handler (BP), and console
+// commands.  A stimulus lands between two of the pass's calls, as an interrupt or a console line
+// would, so it waits for the rest of the pass, and the Director's next Update(), as it would on
+// the robot.  Every tick also stamps its encoder snapshot.  The output stage times each of these
+// to the pins showing the response, and at the end the program prints the latency report and
+// fails if any source went over its bound, was never seen at all, or was never seen to take any
+// time (which would mean the clock didn't move between the stimulus and the pins).
+//
+// Build it from this directory with, e.g.:
+//
+//   g++ -std=c++11 -O2 -pthread -I../.. -o latency LatencyBounds.cpp ../../*.cpp
+//
+// Options:
+//   --interval ms             Director interval (default 50)
+//   --loop us                 simulated time per pass of loop() (default 250)
+//   --seconds s               simulated time to run for (default 120)
+//   --seed n                  seed for random(), which times the stimuli (default 1)
+//   --bound source=us         a bound (source 0 bump, 1 command, 2 snapshot), replacing the default
+//
+// The default bounds are what the design promises, given the loop pass:
+//   bump        the rest of the pass the press happens in:  the urgent tick writes the pins
+//               straight away
+//   command     two intervals:  up to one waiting for the tick, and one more for the ramp
+//   snapshot    one interval, for the ramp
+// each plus the passes it takes loop() to notice.  The exit status is 0 if all were met.
+
+#include "CommonDefs.h"
+#include <SimRobot.h>
+
+#include <string>
+
+struct Options
+{
+    unsigned        interval = 50;
+    unsigned long   loopMicros = 250;
+    unsigned        seconds = 120;
+    unsigned        seed = 1;
+    long            bound[ eLatencySources ] = { -1, -1, -1 };   // -1 for the default
+};
+
+
+// commands which leave the mission alone, for the command stimulus
+static const char* _commands[] = { "NT 2", "LL 64" };
+
+// the calls loop() makes in each pass
+#define LOOP_CALLS  5
+
+
+static void usage()
+{
+    fprintf( stderr, "usage: latency [--interval ms] [--loop us] [--seconds s] [--seed n] [--bound source=us]...\n" );
+    exit( 1 );
+}
+
+
+int main( int argc, char* argv[] )
+{
+    Options options;
+
+    for ( int i = 1; i < argc; i++ ) {
+        std::string arg = argv[ i ];
+        bool bHasValue = i + 1 < argc;
+
+        if ( arg == "--interval" && bHasValue ) {
+            options.interval = std::max( 1, atoi( argv[ ++i ] ) );
+        }
+        else if ( arg == "--loop" && bHasValue ) {
+            options.loopMicros = std::max( 1, atoi( argv[ ++i ] ) );
+        }
+        else if ( arg == "--seconds" && bHasValue ) {
+            options.seconds = std::max( 1, atoi( argv[ ++i ] ) );
+        }
+        else if ( arg == "--seed" && bHasValue ) {
+            options.seed = atoi( argv[ ++i ] );
+        }
+        else if ( arg == "--bound" && bHasValue ) {
+            int source;
+            long us;
+            if ( sscanf( argv[ ++i ], "%d=%ld", &source, &us ) != 2 || source < 0 || source >= eLatencySources || us < 0 ) {
+                usage();
+            }
+            options.bound[ source ] = us;
+        }
+        else {
+            usage();
+        }
+    }
+
+    SimRobot* pRobot = new SimRobot( options.interval );
+    LatencyStats* pLatency = pRobot->led.GetOutput()->GetLatency();
+
+    // the robot's console goes nowhere until the report, and its clock only moves as we move it
+    Serial.SetOutput( NULL );
+    randomSeed( options.seed );
+    pRobot->context.UseSimulatedClock();
+
+    unsigned long intervalMicros = options.interval * 1000UL;
+    unsigned long defaults[ eLatencySources ];
+    defaults[ eLatencyBump ] = options.loopMicros;
+    defaults[ eLatencyCommand ] = 2 * intervalMicros + 2 * options.loopMicros;
+    defaults[ eLatencySnapshot ] = intervalMicros + options.loopMicros;
+    for ( uint8_t source = 0; source < eLatencySources; source++ ) {
+        pLatency->SetBound( source, options.bound[ source ] >= 0 ? options.bound[ source ] : defaults[ source ] );
+    }
+
+    pRobot->AppendSquare();
+    pRobot->dispatcher.Execute( "NR" );
+    pRobot->cruise.SetCruiseSpeed( 5 );
+    pRobot->dispatcher.Execute( "DG" );
+
+    unsigned long endMicros = options.seconds * 1000000UL;
+    unsigned long nextStimulus = random( 100000, 600000 );
+    unsigned long releaseMicros = 0;     // when the bumper held down now is let go, or 0
+
+    while ( micros() < endMicros ) {
+        // where in this pass anything due lands
+        long stimulusCall = random( LOOP_CALLS );
+
+        for ( uint8_t call = 0; call < LOOP_CALLS; call++ ) {
+            unsigned long now = micros();
+
+            if ( call == stimulusCall ) {
+                if ( releaseMicros && now >= releaseMicros ) {
+                    pRobot->dispatcher.Execute( "BP 0 0" );
+                    releaseMicros = 0;
+                }
+                else if ( ! releaseMicros && now >= nextStimulus ) {
+                    if ( random( 2 ) ) {
+                        // one side or the other, or both, held for longer than the debounce
+                        long sides = random( 1, 4 );
+                        char line[ 16 ];
+                        snprintf( line, sizeof( line ), "BP %d %d", (int) ( sides & BUMP_LEFT ? 1 : 0 ), (int) ( sides & BUMP_RIGHT ? 1 : 0 ) );
+                        pRobot->dispatcher.Execute( line );
+                        releaseMicros = now + random( 10000, 80000 );
+                    }
+                    else {
+                        pRobot->dispatcher.Execute( _commands[ random( sizeof( _commands ) / sizeof( _commands[ 0 ] ) ) ] );
+                    }
+                    nextStimulus = now + random( 100000, 600000 );
+                }
+            }
+
+            // loop(), as in the sketch
+            switch ( call ) {
+                case 0 : pRobot->director.Update();     break;
+                case 1 : pRobot->bumper.Update();       break;
+                case 2 : pRobot->led.Update();          break;
+                case 3 : pRobot->waypoints.Update();    break;
+                case 4 : SerialTx.Drain();              break;
+            }
+            pRobot->context.AdvanceClock( ( options.loopMicros * ( call + 1 ) ) / LOOP_CALLS - ( options.loopMicros * call ) / LOOP_CALLS );
+        }
+    }
+
+    // the firmware's own report, on stdout
+    Serial.SetOutput( stdout );
+    pLatency->Print();
+    SerialTx.Drain( true );
+
+    bool bPassed = pLatency->WithinBounds();
+    for ( uint8_t source = 0; source < eLatencySources; source++ ) {
+        if ( pLatency->GetCount( source ) == 0 ) {
+            printf( "source %u was never stimulated\n", source );
+            bPassed = false;
+        }
+        else if ( pLatency->GetMax( source ) == 0 ) {
+            printf( "source %u never took any time, so its bound wasn't tested\n", source );
+            bPassed = false;
+        }
+    }
+    printf( bPassed ? "Latency within bounds\n" : "Latency OVER bounds\n" );
+
+    delete pRobot;
+    return bPassed ? 0 : 1;
+}
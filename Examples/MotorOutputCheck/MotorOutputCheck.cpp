@@ -0,0 +1,378 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+// MotorOutputCheck
+//
+// A host program (not a sketch) which checks the output stage against what it promises, using the
+// writes MotorOutput records on the host.  On a simulated clock, it drives Set(), SetUrgent() and
+// Update() through a script of steps, and checks each recorded write:
+//
+//  * the pins:  every write's PWM values and direction bits must be its throttles with the
+//    deadband and the channel's inversion applied, and the PWM inverted in reverse for LEDs.
+//  * the slew limit:  a Set() moves the throttles by no more than the limit.
+//  * the ramp:  the throttles move from the last target to the new one in a straight line over
+//    the ramp, never overshoot it, and are at it once the ramp is over.
+//  * urgent ticks:  a throttle coming down toward zero is written at once, mid-ramp or not, and
+//    anything else is slew limited.
+//
+// Then it does the same with random throttles, slew limits, deadbands and ramps.
+//
+// Build it from this directory with, e.g.:
+//
+//   g++ -std=c++11 -O2 -pthread -I../.. -o mocheck MotorOutputCheck.cpp ../../*.cpp
+//
+// Options:
+//   --count n          random steps (default 100000)
+//   --seed n           (default 1)
+//
+// It prints the first few failures, and the totals, and exits 1 if there were any failures.
+
+#include "CommonDefs.h"
+#include <MotorOutput.h>
+#include <RobotContext.h>
+
+#include <random>
+#include <string>
+
+#define FAILURES_SHOWN      10
+
+// the channels:  one on each side, and a second on the left which is mounted backward
+#define CHANNELS            3
+static const eMotorSide _sides[ CHANNELS ] = { eLeftSide, eRightSide, eLeftSide };
+static const bool _inverted[ CHANNELS ] = { false, false, true };
+
+static unsigned long _checks = 0;
+static unsigned long _failures = 0;
+static const char* _pStep = "";
+
+
+static void fail( const char* pFormat, ... )
+{
+    if ( _failures++ < FAILURES_SHOWN ) {
+        va_list args;
+        va_start( args, pFormat );
+        printf( "%s:  ", _pStep );
+        vprintf( pFormat, args );
+        printf( "\n" );
+        va_end( args );
+    }
+}
+
+
+static void check( bool bOK, const char* pFormat, int a, int b )
+{
+    _checks++;
+    if ( ! bOK ) {
+        fail( pFormat, a, b );
+    }
+}
+
+
+// where an urgent tick may take a throttle:  straight to it when coming down toward zero, and
+// otherwise slew limited
+static int urgentThrottle( int from, int to, int slewLimit )
+{
+    bool bTowardZero = from >= 0 ? to >= 0 && to <= from : to <= 0 && to >= from;
+    return bTowardZero ? to : constrain( to, from - slewLimit, from + slewLimit );
+}
+
+
+// the pins must show the record's throttles
+static void checkPins( const MotorOutputRecord& record, eMotorOutputMode eMode, uint8_t nChannels, int deadband )
+{
+    for ( uint8_t ch = 0; ch < nChannels; ch++ ) {
+        int throttle = _sides[ ch ] == eLeftSide ? record.left : record.right;
+        if ( abs( throttle ) < deadband ) {
+            throttle = 0;
+        }
+        if ( _inverted[ ch ] ) {
+            throttle = -throttle;
+        }
+        bool bReverse = throttle < 0;
+        int pwm = bReverse && eMode == eBipolarLed ? 255 - abs( throttle ) : abs( throttle );
+
+        _checks++;
+        if ( record.pwm[ ch ] != pwm || ( ( record.dirBits >> ch ) & 1 ) != bReverse ) {
+            fail( "throttles %d, %d:  channel %u PWM %u reverse %u, expected %d %u", record.left, record.right,
+                ch, record.pwm[ ch ], ( record.dirBits >> ch ) & 1, pwm, bReverse );
+        }
+    }
+}
+
+
+// The output stage, with a model of where it should be
+class Checker
+{
+public:
+
+    RobotContext&       _context;
+    MotorOutput         _output;
+    eMotorOutputMode    _eMode;
+    uint8_t             _nChannels;
+    int                 _slewLimit;
+    int                 _deadband;
+
+    int                 _fromLeft, _fromRight;
+    int                 _targetLeft, _targetRight;
+    unsigned long       _rampStart;
+    unsigned long       _rampMicros;
+
+    Checker( RobotContext& context, eMotorOutputMode eMode, uint8_t nChannels ) :
+        _context( context ), _output( eMode ), _eMode( eMode ), _nChannels( nChannels )
+    {
+        for ( uint8_t ch = 0; ch < nChannels; ch++ ) {
+            _output.AddChannel( 2 + 2 * ch, 3 + 2 * ch, _sides[ ch ], _inverted[ ch ] );
+        }
+        _output.ClearRecords();
+        _slewLimit = _output.GetSlewLimit();
+        _deadband = 0;
+        _fromLeft = _fromRight = _targetLeft = _targetRight = 0;
+        _rampStart = _rampMicros = 0;
+    }
+
+    void SetSlewLimit( int limit )  { _output.SetSlewLimit( limit ); _slewLimit = limit; }
+    void SetDeadband( int deadband ) { _output.SetDeadband( deadband ); _deadband = deadband; }
+
+    // the records written since the last check, which must all be at the given throttles, now
+    void checkWritten( int left, int right, bool bMustWrite )
+    {
+        uint16_t count = _output.GetRecordCount();
+        check( ! bMustWrite || count > 0, "no write, expected %d, %d", left, right );
+        for ( uint16_t ix = 0; ix < count; ix++ ) {
+            const MotorOutputRecord& record = _output.GetRecord( ix );
+            checkPins( record, _eMode, _nChannels, _deadband );
+            check( record.us == micros(), "written at %d us, expected %d", (int) record.us, (int) micros() );
+            check( record.left == left && record.right == right, "wrote %d, %d", record.left, record.right );
+        }
+        _output.ClearRecords();
+    }
+
+    void Set( int left, int right, uint16_t rampMS )
+    {
+        // each ramp starts from the last target, where the output goes straight away
+        _fromLeft = _targetLeft;
+        _fromRight = _targetRight;
+        _targetLeft = constrain( left, _fromLeft - _slewLimit, _fromLeft + _slewLimit );
+        _targetRight = constrain( right, _fromRight - _slewLimit, _fromRight + _slewLimit );
+        bool bRamp = rampMS && ( _targetLeft != _fromLeft || _targetRight != _fromRight );
+
+        _output.Set( left, right, rampMS );
+        check( abs( _output.GetTargetLeft() - _fromLeft ) <= _slewLimit, "left target moved by %d, limit %d",
+            _output.GetTargetLeft() - _fromLeft, _slewLimit );
+        check( abs( _output.GetTargetRight() - _fromRight ) <= _slewLimit, "right target moved by %d, limit %d",
+            _output.GetTargetRight() - _fromRight, _slewLimit );
+        if ( bRamp ) {
+            _rampStart = micros();
+            _rampMicros = rampMS * 1000UL;
+            checkWritten( _fromLeft, _fromRight, true );
+        }
+        else {
+            _rampMicros = 0;
+            checkWritten( _targetLeft, _targetRight, true );
+        }
+    }
+
+    void SetUrgent( int left, int right, int expectedLeft, int expectedRight )
+    {
+        _output.SetUrgent( left, right );
+        _targetLeft = expectedLeft;
+        _targetRight = expectedRight;
+        _rampMicros = 0;
+        checkWritten( expectedLeft, expectedRight, true );
+    }
+
+    // move the clock on, calling Update() every stepMicros
+    void Run( unsigned long us, unsigned long stepMicros )
+    {
+        for ( unsigned long elapsed = 0; elapsed < us; elapsed += stepMicros ) {
+            _context.AdvanceClock( stepMicros );
+            _output.Update();
+            checkRamp();
+        }
+    }
+
+    // any write while ramping must be on the straight line from the last target to the new one,
+    // and once the ramp is over, the output must be at the target
+    void checkRamp()
+    {
+        uint16_t count = _output.GetRecordCount();
+        unsigned long elapsed = micros() - _rampStart;
+
+        if ( _rampMicros == 0 || elapsed >= _rampMicros ) {
+            bool bEnding = _rampMicros != 0;
+            _rampMicros = 0;
+            checkWritten( _targetLeft, _targetRight, bEnding );
+            check( _output.GetLeft() == _targetLeft && _output.GetRight() == _targetRight,
+                "after the ramp, the output is at %d, %d", _output.GetLeft(), _output.GetRight() );
+            return;
+        }
+
+        for ( uint16_t ix = 0; ix < count; ix++ ) {
+            const MotorOutputRecord& record = _output.GetRecord( ix );
+            checkPins( record, _eMode, _nChannels, _deadband );
+            checkAlongRamp( record.left, _fromLeft, _targetLeft, elapsed );
+            checkAlongRamp( record.right, _fromRight, _targetRight, elapsed );
+        }
+        _output.ClearRecords();
+    }
+
+    void checkAlongRamp( int throttle, int from, int target, unsigned long elapsed )
+    {
+        // within a step of the line, for a ramp moving in 256ths, and between the ends
+        double line = from + ( target - from ) * (double) elapsed / _rampMicros;
+        check( fabs( throttle - line ) <= 1.0 + abs( target - from ) / 256.0, "ramp wrote %d, expected about %d", throttle, (int) line );
+        check( ( throttle - from ) * ( target - throttle ) >= 0, "ramp wrote %d, outside the ramp to %d",
+            throttle, target );
+    }
+};
+
+
+// the script:  each property on its own, from a known state
+static void runScript( RobotContext& context )
+{
+    Checker c( context, eSignMagnitude, CHANNELS );
+
+    _pStep = "slew limit";
+    c.SetSlewLimit( 64 );
+    c.Set( 255, -255, 0 );
+    c.Set( 255, -255, 0 );
+    c.Set( 255, -255, 0 );
+    c.Set( 255, -255, 0 );
+    check( c._output.GetLeft() == 255 && c._output.GetRight() == -255, "got to %d, %d after four steps",
+        c._output.GetLeft(), c._output.GetRight() );
+    c.Set( 0, 0, 0 );
+    check( c._output.GetLeft() == 191, "slowing, left went to %d, expected %d", c._output.GetLeft(), 191 );
+
+    _pStep = "deadband";
+    c._output.Write( 0, 0 );
+    c._targetLeft = c._targetRight = 0;
+    c.checkWritten( 0, 0, true );
+    c.SetDeadband( 20 );
+    c.Set( 10, -19, 0 );
+    check( c._output.GetPwm( 0 ) == 0 && c._output.GetPwm( 1 ) == 0, "PWM %d, %d inside the deadband",
+        c._output.GetPwm( 0 ), c._output.GetPwm( 1 ) );
+    c.Set( 20, -30, 0 );
+    check( c._output.GetPwm( 0 ) == 20 && c._output.GetPwm( 1 ) == 30, "PWM %d, %d outside the deadband",
+        c._output.GetPwm( 0 ), c._output.GetPwm( 1 ) );
+    c.SetDeadband( 0 );
+
+    _pStep = "inversion";
+    c.Set( 50, 50, 0 );
+    check( ! c._output.GetReverse( 0 ) && c._output.GetReverse( 2 ), "forward, the inverted channel's direction is %d",
+        c._output.GetReverse( 2 ), 0 );
+    c.Set( -10, -10, 0 );
+    check( c._output.GetReverse( 0 ) && ! c._output.GetReverse( 2 ), "reverse, the inverted channel's direction is %d",
+        c._output.GetReverse( 2 ), 0 );
+
+    _pStep = "ramp";
+    c.Set( 0, 0, 0 );
+    c.Set( 64, -64, 50 );
+    check( c._output.IsRamping(), "not ramping to %d, %d", 64, -64 );
+    c.Run( 60000, 1000 );
+    check( ! c._output.IsRamping(), "still ramping after %d ms of a %d ms ramp", 60, 50 );
+
+    // Update() called seldom, then not at all:  the next Set() steps to the last target
+    c.Set( 128, -128, 50 );
+    c.Run( 20000, 7000 );
+    c.Set( 192, -192, 50 );
+    c.Set( 192, -192, 50 );
+    c.Run( 60000, 1000 );
+
+    _pStep = "urgent";
+    c.Set( 128, -128, 50 );
+    c.Run( 25000, 1000 );
+    c.SetUrgent( 0, 0, 0, 0 );
+    check( ! c._output.IsRamping(), "still ramping after an urgent stop to %d, %d", 0, 0 );
+    c.SetUrgent( 200, -200, 64, -64 );
+    c.SetUrgent( -50, 50, 0, 0 );
+    c.Set( 200, 200, 0 );
+    c.SetUrgent( 100, 150, 100, 128 );
+
+    _pStep = "LED mode";
+    Checker led( context, eBipolarLed, 2 );
+    led.SetSlewLimit( 255 );
+    led.Set( -100, 100, 0 );
+    check( led._output.GetPwm( 0 ) == 155 && led._output.GetPwm( 1 ) == 100, "PWM %d, %d",
+        led._output.GetPwm( 0 ), led._output.GetPwm( 1 ) );
+}
+
+
+// random steps, with the model checking every write
+static void runRandom( RobotContext& context, unsigned long count, unsigned seed )
+{
+    std::mt19937 rng( seed );
+    Checker c( context, eSignMagnitude, CHANNELS );
+    Checker led( context, eBipolarLed, CHANNELS );
+
+    _pStep = "random";
+    for ( unsigned long n = 0; n < count; n++ ) {
+        Checker& k = n & 1 ? c : led;
+        int left = (int) ( rng() % 601 ) - 300;
+        int right = (int) ( rng() % 601 ) - 300;
+
+        switch ( rng() % 8 ) {
+            case 0 :
+                k.SetSlewLimit( 1 + rng() % 255 );
+                break;
+            case 1 :
+                k.SetDeadband( rng() % 40 );
+                break;
+            case 2 : {
+                // the model's urgent step
+                int expectedLeft = urgentThrottle( k._output.GetLeft(), constrain( left, -255, 255 ), k._slewLimit );
+                int expectedRight = urgentThrottle( k._output.GetRight(), constrain( right, -255, 255 ), k._slewLimit );
+                k.SetUrgent( left, right, expectedLeft, expectedRight );
+                break;
+            }
+            default :
+                k.Set( constrain( left, -255, 255 ), constrain( right, -255, 255 ), rng() % 3 ? 1 + rng() % 100 : 0 );
+                k.Run( 1000 + rng() % 120000, 1 + rng() % 5000 );
+                break;
+        }
+    }
+}
+
+
+static void usage()
+{
+    fprintf( stderr, "usage: mocheck [--count n] [--seed n]\n" );
+    exit( 1 );
+}
+
+
+int main( int argc, char* argv[] )
+{
+    unsigned long count = 100000;
+    unsigned seed = 1;
+
+    for ( int i = 1; i < argc; i++ ) {
+        std::string arg = argv[ i ];
+        bool bHasValue = i + 1 < argc;
+
+        if ( arg == "--count" && bHasValue ) {
+            count = strtoul( argv[ ++i ], NULL, 10 );
+        }
+        else if ( arg == "--seed" && bHasValue ) {
+            seed = atoi( argv[ ++i ] );
+        }
+        else {
+            usage();
+        }
+    }
+
+    RobotContext context( true );
+    context.UseSimulatedClock();
+
+    runScript( context );
+    runRandom( context, count, seed );
+
+    printf( "%lu checks, %lu failures\n", _checks, _failures );
+    return _failures ? 1 : 0;
+}
@@ -0,0 +1,442 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+// ParameterSweep
+//
+// A host program (not a sketch) which runs complete simulated missions, the same Behaviors as
+// PubSubsumptionTest with DrivePlant standing in for the robot, over a range of parameter
+// settings, and reports how well each setting did.  Missions run on every core at once, as fast
+// as the CPU allows, using Director::Step() rather than waiting on the clock.  Each robot's clock
+// is simulated, and moves on by the interval each tick, so the results don't depend on how busy
+// the machine is (and the Behaviors' time budgets never run out).
+//
+// Build it from this directory with, e.g.:
+//
+//   g++ -std=c++11 -O2 -pthread -I../.. -o sweep ParameterSweep.cpp ../../*.cpp
+//
+// Parameters are named, with a range, and reach the robot through console commands with the
+// names in braces replaced by the values for each run:
+//
+//   ./sweep --param kP=0.5:4 --param kI=0:1 --command "CP {kP} {kI} 0" --grid 5
+//   ./sweep --param tol=1:10 --param limit=16:128 --command "NT {tol}" --command "LL {limit}" --lhs 200
+//
+// Options:
+//   --param name=lo:hi        a parameter and its range (any number of these)
+//   --command "..."           a command run on each robot, after substituting parameters
+//   --setup "..."             a command run on each robot before any --command, e.g. obstacles
+//   --grid n                  n evenly spaced values per parameter, all combinations (default 5)
+//   --random n                n points chosen at random
+//   --lhs n                   n points by Latin hypercube sampling
+//   --mission file            mission image saved by WS on a host build (default: a 4-foot square)
+//   --speed ips               cruising speed (default 5)
+//   --interval ms             Director interval (default 50)
+//   --seconds s               simulated time limit per mission (default 120)
+//   --threads n               worker threads (default: one per core)
+//   --seed n                  seed for sampling, and for each run's random() (default 1)
+//   --weights t e o           score weights, see below (default 1 1 0.1)
+//   --trace file              write a Chrome trace of every tick, for chrome://tracing or Perfetto
+//
+// For each point, the table reports
+//   time        seconds to reach the last Waypoint, or "DNF" if it didn't within the limit
+//   rmsError    RMS distance (inches) of the plant's true position from the path, sampled each tick
+//   maxError    the largest distance from the path
+//   overshoot   how far the speed exceeded the cruising speed, as a percentage
+//   score       t * time + e * rmsError + o * overshoot;  lower is better
+// sorted by score, on stdout.  Progress goes to stderr.
+
+#include "CommonDefs.h"
+#include <MissionStore.h>
+#include <SimRobot.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Parameter
+{
+    std::string     name;
+    double          lo;
+    double          hi;
+};
+
+
+struct Result
+{
+    size_t          point;
+    bool            bFinished;
+    double          seconds;
+    double          rmsError;
+    double          maxError;
+    double          overshoot;
+    double          score;
+};
+
+
+struct Options
+{
+    std::vector<Parameter>      params;
+    std::vector<std::string>    commands;
+    std::vector<std::string>    setup;
+    enum { eGrid, eRandom, eLHS } sampling = eGrid;
+    unsigned        samples = 5;
+    const char*     pMission = NULL;
+    double          speed = 5.0;
+    unsigned        interval = 50;
+    double          seconds = 120.0;
+    unsigned        threads = std::max( 1u, std::thread::hardware_concurrency() );
+    unsigned        seed = 1;
+    double          weightTime = 1.0;
+    double          weightError = 1.0;
+    double          weightOvershoot = 0.1;
+    const char*     pTrace = NULL;
+};
+
+
+// A pool of worker threads, each with its own queue of jobs.  Workers take from the back of
+// their own queue, and when it's empty, steal from the front of the others', so a worker which
+// draws quick missions (or a crash into the first obstacle) helps out the rest.
+class WorkStealingPool
+{
+    struct Queue
+    {
+        std::mutex          lock;
+        std::deque<size_t>  jobs;
+    };
+
+    std::vector<Queue>      _queues;
+
+    bool take( size_t self, size_t& job )
+    {
+        {
+            std::lock_guard<std::mutex> guard( _queues[ self ].lock );
+            if ( ! _queues[ self ].jobs.empty() ) {
+                job = _queues[ self ].jobs.back();
+                _queues[ self ].jobs.pop_back();
+                return true;
+            }
+        }
+        for ( size_t i = 1; i < _queues.size(); i++ ) {
+            Queue& victim = _queues[ ( self + i ) % _queues.size() ];
+            std::lock_guard<std::mutex> guard( victim.lock );
+            if ( ! victim.jobs.empty() ) {
+                job = victim.jobs.front();
+                victim.jobs.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+
+    WorkStealingPool( size_t nThreads ) : _queues( nThreads ) {}
+
+    // run fn( job ) for each job in 0 .. nJobs-1.  No jobs are added once we start, so a worker
+    // which finds every queue empty is done.
+    template <class Fn>
+    void Run( size_t nJobs, Fn fn )
+    {
+        for ( size_t job = 0; job < nJobs; job++ ) {
+            _queues[ job % _queues.size() ].jobs.push_back( job );
+        }
+
+        std::vector<std::thread> workers;
+        for ( size_t self = 0; self < _queues.size(); self++ ) {
+            workers.push_back( std::thread( [ this, self, &fn ]() {
+                size_t job;
+                while ( take( self, job ) ) {
+                    fn( job );
+                }
+            } ) );
+        }
+        for ( size_t i = 0; i < workers.size(); i++ ) {
+            workers[ i ].join();
+        }
+    }
+};
+
+
+// the points to run, each a value for every parameter
+static std::vector< std::vector<double> > samplePoints( const Options& options )
+{
+    std::vector< std::vector<double> > points;
+    size_t nParams = options.params.size();
+    std::mt19937 rng( options.seed );
+    std::uniform_real_distribution<double> uniform( 0.0, 1.0 );
+
+    if ( options.sampling == Options::eGrid ) {
+        // count through the grid like an odometer
+        std::vector<unsigned> level( nParams, 0 );
+        do {
+            std::vector<double> point;
+            for ( size_t p = 0; p < nParams; p++ ) {
+                double t = options.samples > 1 ? (double) level[ p ] / ( options.samples - 1 ) : 0.0;
+                point.push_back( options.params[ p ].lo + t * ( options.params[ p ].hi - options.params[ p ].lo ) );
+            }
+            points.push_back( point );
+
+            size_t p = 0;
+            while ( p < nParams && ++level[ p ] == options.samples ) {
+                level[ p++ ] = 0;
+            }
+            if ( p == nParams ) {
+                break;
+            }
+        } while ( true );
+    }
+    else {
+        points.assign( options.samples, std::vector<double>( nParams ) );
+        for ( size_t p = 0; p < nParams; p++ ) {
+            // Latin hypercube:  each parameter's range is cut into as many strata as there are
+            // points, and each stratum is used exactly once, in a random order
+            std::vector<unsigned> strata( options.samples );
+            for ( unsigned i = 0; i < options.samples; i++ ) {
+                strata[ i ] = i;
+            }
+            std::shuffle( strata.begin(), strata.end(), rng );
+
+            for ( unsigned i = 0; i < options.samples; i++ ) {
+                double t = options.sampling == Options::eLHS ? ( strata[ i ] + uniform( rng ) ) / options.samples : uniform( rng );
+                points[ i ][ p ] = options.params[ p ].lo + t * ( options.params[ p ].hi - options.params[ p ].lo );
+            }
+        }
+    }
+    return points;
+}
+
+
+// replace each {name} with its value for this point
+static std::string substitute( std::string command, const Options& options, const std::vector<double>& point )
+{
+    for ( size_t p = 0; p < options.params.size(); p++ ) {
+        std::string key = "{" + options.params[ p ].name + "}";
+        char value[ 32 ];
+        snprintf( value, sizeof( value ), "%g", point[ p ] );
+        for ( size_t at = command.find( key ); at != std::string::npos; at = command.find( key, at ) ) {
+            command.replace( at, key.size(), value );
+        }
+    }
+    return command;
+}
+
+
+static Result runMission( size_t index, const Options& options, const std::vector<double>& point )
+{
+    Result result = { index, false, 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+    SimRobot* pRobot = new SimRobot( options.interval );
+
+    // the robot talks to nobody, has its own repeatable random(), and its clock moves a tick at a
+    // time, however long the tick takes to run
+    Serial.SetOutput( NULL );
+    randomSeed( options.seed + index );
+    pRobot->context.UseSimulatedClock();
+
+    bool bLoaded = false;
+    if ( options.pMission ) {
+        FileMissionStore store( options.pMission );
+        pRobot->waypoints.SetMissionStore( &store );
+        bLoaded = pRobot->waypoints.LoadMission();
+        pRobot->waypoints.SetMissionStore( NULL );
+    }
+    if ( ! bLoaded ) {
+        pRobot->AppendSquare();
+    }
+    pRobot->dispatcher.Execute( "NR" );
+    pRobot->cruise.SetCruiseSpeed( options.speed );
+
+    for ( size_t i = 0; i < options.setup.size(); i++ ) {
+        pRobot->dispatcher.Execute( options.setup[ i ].c_str() );
+    }
+    for ( size_t i = 0; i < options.commands.size(); i++ ) {
+        pRobot->dispatcher.Execute( substitute( options.commands[ i ], options, point ).c_str() );
+    }
+    pRobot->dispatcher.Execute( "DG" );
+
+    double  sumSquares = 0.0;
+    double  maxSpeed = 0.0;
+    float   xPrev = pRobot->plant.GetTrueX();
+    float   yPrev = pRobot->plant.GetTrueY();
+    unsigned maxTicks = options.seconds * 1000 / options.interval;
+    unsigned tick;
+
+    // each mission is its own process in the trace, on whichever worker thread ran it
+    TRACE_BEGIN( "Mission", "point", index );
+    for ( tick = 1; tick <= maxTicks; tick++ ) {
+        pRobot->context.AdvanceClock( options.interval * 1000UL );
+        pRobot->director.StepIfRequested();     // a simulated bump gets its urgent tick, as in loop()
+        pRobot->director.Step();
+
+        float x = pRobot->plant.GetTrueX();
+        float y = pRobot->plant.GetTrueY();
+        float error = 0.0;
+        pRobot->waypoints.NearestLeg( x, y, 0.0, &error );
+        sumSquares += (double) error * error;
+        result.maxError = std::max( result.maxError, (double) error );
+        maxSpeed = std::max( maxSpeed, hypot( x - xPrev, y - yPrev ) * 1000.0 / options.interval );
+        xPrev = x;
+        yPrev = y;
+
+        if ( pRobot->navigator.GetCurrentWaypoint() == NO_WAYPOINT ) {
+            result.bFinished = true;
+            break;
+        }
+    }
+    TRACE_END();
+
+    tick = std::min( tick, maxTicks );
+    result.seconds = tick * options.interval / 1000.0;
+    result.rmsError = sqrt( sumSquares / tick );
+    result.overshoot = std::max( 0.0, 100.0 * ( maxSpeed - options.speed ) / options.speed );
+    result.score = result.bFinished
+        ? options.weightTime * result.seconds + options.weightError * result.rmsError + options.weightOvershoot * result.overshoot
+        : HUGE_VAL;
+
+    delete pRobot;
+    return result;
+}
+
+
+static void usage()
+{
+    fprintf( stderr, "usage: sweep --param name=lo:hi ... --command \"...\" ... [--grid n | --random n | --lhs n]\n"
+                     "             [--setup \"...\"] [--mission file] [--speed ips] [--interval ms] [--seconds s]\n"
+                     "             [--threads n] [--seed n] [--weights time error overshoot] [--trace file]\n" );
+    exit( 1 );
+}
+
+
+static Options parseOptions( int argc, char* argv[] )
+{
+    Options options;
+
+    for ( int i = 1; i < argc; i++ ) {
+        std::string arg = argv[ i ];
+        bool bHasValue = i + 1 < argc;
+
+        if ( arg == "--param" && bHasValue ) {
+            Parameter param;
+            char name[ 64 ];
+            if ( sscanf( argv[ ++i ], "%63[^=]=%lf:%lf", name, &param.lo, &param.hi ) != 3 ) {
+                usage();
+            }
+            param.name = name;
+            options.params.push_back( param );
+        }
+        else if ( arg == "--command" && bHasValue ) {
+            options.commands.push_back( argv[ ++i ] );
+        }
+        else if ( arg == "--setup" && bHasValue ) {
+            options.setup.push_back( argv[ ++i ] );
+        }
+        else if ( ( arg == "--grid" || arg == "--random" || arg == "--lhs" ) && bHasValue ) {
+            options.sampling = arg == "--grid" ? Options::eGrid : arg == "--random" ? Options::eRandom : Options::eLHS;
+            options.samples = std::max( 1, atoi( argv[ ++i ] ) );
+        }
+        else if ( arg == "--mission" && bHasValue ) {
+            options.pMission = argv[ ++i ];
+        }
+        else if ( arg == "--speed" && bHasValue ) {
+            options.speed = atof( argv[ ++i ] );
+        }
+        else if ( arg == "--interval" && bHasValue ) {
+            options.interval = std::max( 1, atoi( argv[ ++i ] ) );
+        }
+        else if ( arg == "--seconds" && bHasValue ) {
+            options.seconds = atof( argv[ ++i ] );
+        }
+        else if ( arg == "--threads" && bHasValue ) {
+            options.threads = std::max( 1, atoi( argv[ ++i ] ) );
+        }
+        else if ( arg == "--seed" && bHasValue ) {
+            options.seed = atoi( argv[ ++i ] );
+        }
+        else if ( arg == "--weights" && i + 3 < argc ) {
+            options.weightTime = atof( argv[ ++i ] );
+            options.weightError = atof( argv[ ++i ] );
+            options.weightOvershoot = atof( argv[ ++i ] );
+        }
+        else if ( arg == "--trace" && bHasValue ) {
+            options.pTrace = argv[ ++i ];
+        }
+        else {
+            usage();
+        }
+    }
+
+    if ( options.speed <= 0.0 ) {
+        usage();
+    }
+    return options;
+}
+
+
+int main( int argc, char* argv[] )
+{
+    Options options = parseOptions( argc, argv );
+    std::vector< std::vector<double> > points = samplePoints( options );
+    std::vector<Result> results( points.size() );
+    std::atomic<size_t> done( 0 );
+
+    fprintf( stderr, "%u points on %u threads\n", (unsigned) points.size(), options.threads );
+
+    if ( options.pTrace && ! TraceStart( options.pTrace ) ) {
+        fprintf( stderr, "can't write %s\n", options.pTrace );
+        return 1;
+    }
+
+    WorkStealingPool pool( options.threads );
+    pool.Run( points.size(), [ & ]( size_t job ) {
+        results[ job ] = runMission( job, options, points[ job ] );
+        size_t n = ++done;
+        if ( n % 100 == 0 || n == points.size() ) {
+            fprintf( stderr, "%u/%u\r", (unsigned) n, (unsigned) points.size() );
+        }
+    } );
+    fprintf( stderr, "\n" );
+
+    // the workers are idle, so their last events can be handed over for them
+    TraceStop();
+
+    std::stable_sort( results.begin(), results.end(), []( const Result& a, const Result& b ) { return a.score < b.score; } );
+
+    printf( "point" );
+    for ( size_t p = 0; p < options.params.size(); p++ ) {
+        printf( "\t%s", options.params[ p ].name.c_str() );
+    }
+    printf( "\ttime\trmsError\tmaxError\tovershoot\tscore\n" );
+
+    for ( size_t i = 0; i < results.size(); i++ ) {
+        const Result& r = results[ i ];
+        printf( "%u", (unsigned) r.point );
+        for ( size_t p = 0; p < options.params.size(); p++ ) {
+            printf( "\t%g", points[ r.point ][ p ] );
+        }
+        if ( r.bFinished ) {
+            printf( "\t%.2f", r.seconds );
+        }
+        else {
+            printf( "\tDNF" );
+        }
+        printf( "\t%.2f\t%.2f\t%.1f", r.rmsError, r.maxError, r.overshoot );
+        if ( r.bFinished ) {
+            printf( "\t%.2f\n", r.score );
+        }
+        else {
+            printf( "\t-\n" );
+        }
+    }
+    return 0;
+}
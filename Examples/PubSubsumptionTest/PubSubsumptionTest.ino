@@ -12,6 +12,10 @@ Subsumption Architecture as described by David P. Anderson.
 //#define ROVER5_DUE
 #define USE_CSV
 
+// The obstacle map, and the PathPlanner, ObstacleMapper and CollisionAvoidance which work from it.
+// Comment this out to leave them out, and their RAM with them.
+#define USE_OBSTACLE_MAP
+
 // Platform geometry defines
 #define WHEEL_DIAMETER                  2.5
 #define WHEEL_SPACING                   7.25
@@ -23,20 +27,27 @@ Subsumption Architecture as described by David P. Anderson.
 #include <Actor.h>
 #include <CruiseControl.h>
 #include <WaypointManager.h>
+#include <MissionStore.h>
+#include <RangeSensor.h>
 #include <CollisionAvoidance.h>
 #include <CollisionRecovery.h>
+#include <BumperPinChange.h>        // the bumpers use the pin change interrupts
 #include <Position.h>
 #include <PubSub.h>
 #include <Director.h>
 #include <Navigator.h>
+#include <OccupancyGrid.h>
+#include <PathPlanner.h>
+#include <ObstacleMapper.h>
 #include <LEDDriver.h>
+#include <DrivePlant.h>
 #include <MotorDriver.h>
 
 /// these will point to the member elements in the Position class which track
 /// encoder positions.  These pointers are global so we can update them in
 /// interrupt handlers
-uint32_t* _pEncoderPositionLeft;
-uint32_t* _pEncoderPositionRight;
+int32_t* _pEncoderPositionLeft;
+int32_t* _pEncoderPositionRight;
 
 #ifdef ROVER5_DUE
 
@@ -47,6 +58,9 @@ uint8_t _pinRightEncoderB = 51;
 uint8_t _pinLeftEncoderXor = 45;//grn,brn,ch3int
 uint8_t _pinRightEncoderXor = 44;//red,grn,ch4int
 
+uint8_t _pinBumperLeft = 41;
+uint8_t _pinBumperRight = 43;
+
 #else   // Pro Micro
 
 uint8_t _pinLeftEncoderA = 2;
@@ -54,6 +68,10 @@ uint8_t _pinLeftEncoderB = 10;
 uint8_t _pinRightEncoderA = 3;
 uint8_t _pinRightEncoderB = 12;
 
+// on port B, which has pin change interrupts
+uint8_t _pinBumperLeft = 15;
+uint8_t _pinBumperRight = 16;
+
 #endif
 
 
@@ -64,15 +82,21 @@ Director            director( &dispatcher, 1000 );    // 1000 ms interval
 // other entities
 WaypointManager     waypointManager( &dispatcher );
 
+// the saved mission, if any, lives in EEPROM
+#ifdef __AVR__
+EepromMissionStore  missionStore;
+#endif
+
 Position            position( &dispatcher, &director, _pEncoderPositionLeft, _pEncoderPositionRight, TicksPerInch( ENCODER_TICKS_PER_REVOLUTION, WHEEL_DIAMETER ), WHEEL_SPACING );     // this carries the current positions of all motors.
 
 // Actors.  These are objects which participate in the Subsumption chain.
 // They will be subscribed to Director command events in setup().
 //
 // LEDDriver is the last Behavior, consuming any adjustments made by higher-priority behaviors.
-// LEDDriver is a motor simulator
+// LEDDriver is a motor simulator, and DrivePlant turns its throttles into encoder counts
 #ifdef USE_LED_EMULATOR
-LEDDriver           led( 10, 9, 14, 5, &dispatcher, &position, TicksPerInch( ENCODER_TICKS_PER_REVOLUTION, WHEEL_DIAMETER ) );
+LEDDriver           led( 10, 9, 14, 5, &dispatcher );
+DrivePlant          plant( &dispatcher, &position );
 #else
 MotorDriver         motor( 2, 3, 4, 5, 8, 9, 10, 11, &dispatcher, &position );
 #endif
@@ -80,22 +104,60 @@ MotorDriver         motor( 2, 3, 4, 5, 8, 9, 10, 11, &dispatcher, &position );
 // Navigator keeps us on course toward the next waypoint
 Navigator           navigator( &dispatcher, &position, &waypointManager );
 
+#ifdef USE_OBSTACLE_MAP
+// the map of known obstacles, and the planner which routes Navigator around them
+OccupancyGrid       obstacleMap;
+PathPlanner         planner( &dispatcher, &position, &waypointManager, &navigator, &obstacleMap );
+
+// CollisionAvoidance slows or steers us away from things before we hit them.
+// The emulator's range sensor "sees" whatever is marked on the map.
+#ifdef USE_LED_EMULATOR
+SimRangeSensor      rangeSensor( &position, &obstacleMap, 48 );
+#else
+EchoRangeSensor     rangeSensor( 6, 7, 48 );
+#endif
+CollisionAvoidance  avoidance( &dispatcher, &rangeSensor );
+#endif
+
 // CollisionRecovery responds to bumping into things.
-CollisionRecovery   bumper( &dispatcher, 0, 0 );
+CollisionRecovery   bumper( &dispatcher, &director, &position, _pinBumperLeft, _pinBumperRight );
+
+// RAM for editing the recovery table from the console.  The Pro Mini can't spare it, so there the
+// table stays as built.
+#ifndef __AVR__
+BallisticStep       recoverySteps[ RECOVERY_EDIT_STEPS ];
+#endif
+
+#ifdef USE_OBSTACLE_MAP
+// ObstacleMapper marks the map wherever we bump into something
+ObstacleMapper      mapper( &dispatcher, &position, &bumper, &obstacleMap );
+#endif
 
 // CruiseControl maintains the current heading and speed
 CruiseControl       cruise( &dispatcher, &position );
 
 void setup()
 {
-    waypointManager.AppendWaypoint( 0, 24, 2 );
-    waypointManager.AppendWaypoint( 24, 24, 2 );
-    waypointManager.AppendWaypoint( 24, 0, 2 );
-    waypointManager.AppendWaypoint( 0, 0, 2 );
+    Serial.begin(38400);
+
+    // use the saved mission if there is one, otherwise a 2-foot square
+#ifdef __AVR__
+    waypointManager.SetMissionStore( &missionStore );
+    if ( ! waypointManager.LoadMission() )
+#endif
+    {
+        waypointManager.AppendWaypoint( 0, 24, 2 );
+        waypointManager.AppendWaypoint( 24, 24, 2 );
+        waypointManager.AppendWaypoint( 24, 0, 2 );
+        waypointManager.AppendWaypoint( 0, 0, 2 );
+    }
 
     cruise.SetCruiseSpeed( 1.0 );
 
-    Serial.begin(38400);
+    bumper.Begin();
+#ifndef __AVR__
+    bumper.SetEditBuffer( recoverySteps, RECOVERY_EDIT_STEPS );
+#endif
 
 #ifndef USE_LED_EMULATOR
     pinMode( _pinLeftEncoderA , INPUT );
@@ -119,6 +181,8 @@ void setup()
     // subscribe Actors to the Director in reverse priority order
 
 #ifdef USE_LED_EMULATOR
+    plant.DriveFrom( led.GetOutput() );
+    plant.SubscribeTo( &director );     // the plant follows the motors
     led.SubscribeTo( &director );
 #else
     motor.SubscribeTo( &director, 0 );    // this is first (last) because it's the endpoint.
@@ -126,7 +190,14 @@ void setup()
 
     cruise.SubscribeTo( &director );
     navigator.SubscribeTo( &director );
+#ifdef USE_OBSTACLE_MAP
+    planner.SubscribeTo( &director );   // planner goes ahead of Navigator, so Navigator sees any new waypoints this tick
+    avoidance.SubscribeTo( &director );
+#endif
     bumper.SubscribeTo( &director );
+#ifdef USE_OBSTACLE_MAP
+    mapper.SubscribeTo( &director );    // mapper follows Position, so it marks bumps at the current pose
+#endif
     position.SubscribeTo( &director );  // Position is top priority so it can snapshot encoders at regular intervals
 }
 
@@ -137,8 +208,15 @@ void loop()
     director.Update();
 
     // time slices for other objects which need time:
-//    led1.Update();
-//    led2.Update();
+    // the motor outputs ramp between Director ticks, the bumpers are watched, and a mission
+    // stream's credit goes out after the tick which freed it
+    bumper.Update();
+    waypointManager.Update();
+#ifdef USE_LED_EMULATOR
+    led.Update();
+#else
+    motor.Update();
+#endif
   /* add main program code here */
 
 }
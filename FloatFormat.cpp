@@ -0,0 +1,262 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#include <FloatFormat.h>
+
+static const uint32_t _powersOf10[ FLOAT_MAX_DECIMALS + 1 ] PROGMEM =
+{
+    1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL, 100000000UL, 1000000000UL
+};
+
+// 10^1, 10^2, 10^4 ... 10^32, then 10^-1 ... 10^-32, for getting a value near 1 in a few
+// multiplies.  Each is mantissa * 2^exponent, the mantissa rounded to 32 bits with the top one set.
+struct ScaledPower
+{
+    uint32_t    mantissa;
+    int16_t     exponent;
+};
+
+static const ScaledPower _binaryPowersOf10[ 2 ][ 6 ] PROGMEM =
+{
+    { { 0xA0000000UL, -28 }, { 0xC8000000UL, -25 }, { 0x9C400000UL, -18 },
+      { 0xBEBC2000UL, -5 },  { 0x8E1BC9BFUL, 22 },  { 0x9DC5ADA8UL, 75 } },
+    { { 0xCCCCCCCDUL, -35 }, { 0xA3D70A3DUL, -38 }, { 0xD1B71759UL, -45 },
+      { 0xABCC7712UL, -58 }, { 0xE69594BFUL, -85 }, { 0xCFB11EADUL, -138 } }
+};
+
+
+// a * b, as a 64-bit hi:lo pair put together from 16 x 16 bit products.  libgcc does those on the
+// AVR's hardware multiplier in a few cycles, where a uint64_t multiply (and the shifts after it)
+// are long loops.
+static void multiply( uint32_t a, uint32_t b, uint32_t* pHi, uint32_t* pLo )
+{
+    uint16_t aHi = a >> 16;
+    uint16_t aLo = a;
+    uint16_t bHi = b >> 16;
+    uint16_t bLo = b;
+
+    uint32_t lo = (uint32_t) aLo * bLo;
+    uint32_t hi = (uint32_t) aHi * bHi;
+    uint32_t mid1 = (uint32_t) aHi * bLo;
+    uint32_t mid = mid1 + (uint32_t) aLo * bHi;
+    if ( mid < mid1 ) {
+        hi += 0x10000UL;    // the middle carried
+    }
+
+    uint32_t sum = lo + ( mid << 16 );
+    if ( sum < lo ) {
+        hi++;
+    }
+    *pHi = hi + ( mid >> 16 );
+    *pLo = sum;
+}
+
+
+// hi:lo >> shift, where the caller knows the result fits in 32 bits
+static uint32_t shiftRight( uint32_t hi, uint32_t lo, int16_t shift )
+{
+    if ( shift >= 64 ) {
+        return 0;
+    }
+    if ( shift >= 32 ) {
+        return hi >> ( shift - 32 );
+    }
+    return shift ? lo >> shift | hi << ( 32 - shift ) : lo;
+}
+
+
+// mantissa / 2^shift times a power of 10 from the table, keeping the top 32 bits of the product
+static void scaleBy( uint32_t* pMantissa, int16_t* pShift, const ScaledPower* pPower )
+{
+    uint32_t hi, lo;
+    multiply( *pMantissa, pgm_read_dword( &pPower->mantissa ), &hi, &lo );
+    *pShift -= (int16_t) pgm_read_word( &pPower->exponent ) + 32;
+
+    // both had their top bit set, so the product's is one of the top two
+    if ( ! ( hi & 0x80000000UL ) ) {
+        hi = hi << 1 | lo >> 31;
+        lo <<= 1;
+        ( *pShift )++;
+    }
+
+    // and round, rather than letting the errors all go the same way
+    if ( lo & 0x80000000UL ) {
+        if ( ++hi == 0 ) {
+            hi = 0x80000000UL;
+            ( *pShift )--;
+        }
+    }
+    *pMantissa = hi;
+}
+
+
+// write n, with at least minDigits digits, returning the number of chars
+static uint8_t writeDecimal( char* pBuf, uint32_t n, uint8_t minDigits )
+{
+    char digits[ 10 ];
+    uint8_t nDigits = 0;
+
+    do {
+        digits[ nDigits++ ] = '0' + n % 10;
+        n /= 10;
+    } while ( n || nDigits < minDigits );
+
+    for ( uint8_t ix = 0; ix < nDigits; ix++ ) {
+        pBuf[ ix ] = digits[ nDigits - 1 - ix ];
+    }
+    return nDigits;
+}
+
+
+// nan or inf, if it's one of those
+static uint8_t formatSpecial( char* pBuf, uint32_t bits )
+{
+    strcpy( pBuf, bits & 0x7FFFFF ? "nan" : "inf" );
+    return 3;
+}
+
+
+// mantissa / 2^shift, which must be under 2^32, in fixed point with the given decimals (no more
+// than FLOAT_MAX_DECIMALS), rounded to nearest
+static uint8_t formatFixed( char* pBuf, uint32_t mantissa, int16_t shift, uint8_t decimals )
+{
+    uint32_t scale = pgm_read_dword( &_powersOf10[ decimals ] );
+    uint32_t integer;
+    uint32_t fraction = 0;
+
+    if ( shift <= 0 ) {
+        integer = mantissa << -shift;
+    }
+    else {
+        // split off the fraction's bits, scale them to the decimals, and round to nearest
+        uint32_t fractionBits = mantissa;
+        integer = 0;
+        if ( shift < 32 ) {
+            integer = mantissa >> shift;
+            fractionBits &= ( 1UL << shift ) - 1;
+        }
+        uint32_t hi, lo;
+        multiply( fractionBits, scale, &hi, &lo );
+        fraction = shiftRight( hi, lo, shift ) + ( shiftRight( hi, lo, shift - 1 ) & 1 );
+        if ( fraction == scale ) {
+            fraction = 0;
+            integer++;
+        }
+    }
+
+    uint8_t length = writeDecimal( pBuf, integer, 1 );
+    if ( decimals ) {
+        pBuf[ length++ ] = '.';
+        length += writeDecimal( pBuf + length, fraction, decimals );
+    }
+    pBuf[ length ] = 0;
+    return length;
+}
+
+
+uint8_t FormatFixed( char* pBuf, float value, uint8_t decimals )
+{
+    uint32_t bits;
+    memcpy( &bits, &value, sizeof( bits ) );
+
+    uint8_t exponent = bits >> 23 & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if ( exponent == 0xFF ) {
+        return formatSpecial( pBuf, bits );
+    }
+
+    // value = mantissa / 2^shift
+    int16_t shift = 149;
+    if ( exponent ) {
+        mantissa |= 0x800000;
+        shift = 150 - exponent;
+    }
+    if ( shift < -8 ) {
+        return FormatCompact( pBuf, value, decimals );  // 2^32 or more
+    }
+
+    uint8_t length = 0;
+    if ( bits >> 31 && bits << 1 ) {   // but not for -0
+        pBuf[ length++ ] = '-';
+    }
+    return length + formatFixed( pBuf + length, mantissa, shift, min( decimals, FLOAT_MAX_DECIMALS ) );
+}
+
+
+uint8_t FormatCompact( char* pBuf, float value, uint8_t decimals )
+{
+    uint32_t bits;
+    memcpy( &bits, &value, sizeof( bits ) );
+
+    uint8_t exponent = bits >> 23 & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if ( exponent == 0xFF ) {
+        return formatSpecial( pBuf, bits );
+    }
+    if ( ( bits & 0x7FFFFFFF ) == 0 ) {
+        return FormatFixed( pBuf, value, decimals );
+    }
+    decimals = min( decimals, FLOAT_MAX_DECIMALS );
+
+    // value = mantissa / 2^shift, the mantissa shifted up to 32 bits to carry through the scaling
+    int16_t shift = 149;
+    if ( exponent ) {
+        mantissa |= 0x800000;
+        shift = 150 - exponent;
+    }
+    while ( ! ( mantissa & 0x80000000UL ) ) {
+        mantissa <<= 1;
+        shift++;
+    }
+
+    // estimate the power of 10 from the power of 2 (1233/4096 is near enough log10( 2 )), and
+    // divide by it, a multiply from the table for each of its bits.  Each product is rounded to 32
+    // bits, so the error is a few units in the 10th significant digit, beyond what a float has.
+    int8_t exp10 = (int32_t) ( 31 - shift ) * 1233 >> 12;
+    uint8_t steps = abs( exp10 );
+    for ( uint8_t ix = 0; steps; ix++, steps >>= 1 ) {
+        if ( steps & 1 ) {
+            scaleBy( &mantissa, &shift, &_binaryPowersOf10[ exp10 > 0 ][ ix ] );
+        }
+    }
+
+    // the estimate can be one out
+    uint32_t integer = shift < 32 ? mantissa >> shift : 0;
+    if ( integer >= 10 ) {
+        scaleBy( &mantissa, &shift, &_binaryPowersOf10[ 1 ][ 0 ] );
+        exp10++;
+    }
+    else if ( integer == 0 ) {
+        scaleBy( &mantissa, &shift, &_binaryPowersOf10[ 0 ][ 0 ] );
+        exp10--;
+    }
+
+    uint8_t length = 0;
+    if ( bits >> 31 ) {
+        pBuf[ length++ ] = '-';
+    }
+    uint8_t digits = formatFixed( pBuf + length, mantissa, shift, decimals );
+    if ( pBuf[ length + 1 ] == '0' && pBuf[ length ] == '1' ) {
+        // 9.99 rounded up to 10.0
+        digits = formatFixed( pBuf + length, 1, 0, decimals );
+        exp10++;
+    }
+    length += digits;
+
+    if ( exp10 ) {
+        pBuf[ length++ ] = 'e';
+        if ( exp10 < 0 ) {
+            pBuf[ length++ ] = '-';
+        }
+        length += writeDecimal( pBuf + length, abs( exp10 ), 1 );
+    }
+    pBuf[ length ] = 0;
+    return length;
+}
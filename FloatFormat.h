@@ -0,0 +1,40 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+#include <CommonDefs.h>
+
+// room for any result, including the terminating 0
+#define FLOAT_FORMAT_SIZE       24
+
+// the most decimals (or significant digits, less one) we'll print
+#define FLOAT_MAX_DECIMALS      9
+
+
+// Float formatting
+//
+// Print's float output works digit by digit in floating point, which costs the AVR a software
+// multiply, subtract and conversion for every digit, and telemetry is mostly floats.  FormatFixed()
+// works from the float's bits instead:  the mantissa is scaled by a power of 10 and shifted by
+// the exponent, in integers, once, and the digits come from 32-bit divisions.  The one wide
+// product is put together from 16 x 16 bit multiplies, which the AVR does quickly, rather than
+// a uint64_t multiply, which it doesn't.  FormatCompact() brings the value near 1 with a few
+// 32-bit multiplies by powers of 10, and formats that the same way, with no float arithmetic.
+//
+// Both write a terminated string to pBuf, which must have FLOAT_FORMAT_SIZE chars, and return
+// its length.  Like Print, they write "nan" and "inf";  values too big for 32 bits in fixed
+// point come out in the compact form instead.
+
+// fixed point, with the given number of decimals, rounded to nearest:  -12.35
+uint8_t     FormatFixed( char* pBuf, float value, uint8_t decimals );
+
+// scientific, with decimals + 1 significant digits, and the exponent only if it isn't 0:  1.23e-4
+uint8_t     FormatCompact( char* pBuf, float value, uint8_t decimals );
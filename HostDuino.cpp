@@ -0,0 +1,226 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+// host builds only; the Arduino core supplies all of this on a real board
+#ifndef ARDUINO
+
+#include <CommonDefs.h>
+#include <chrono>
+#include <thread>
+
+// the pins, their interrupt handlers and random() are the current robot's.  digitalPinToInterrupt()
+// is the pin itself.
+#define _pinLevel       ( RobotContext::Current()->pinLevel )
+#define _pinISR         ( RobotContext::Current()->pinISR )
+#define _pinISRMode     ( RobotContext::Current()->pinISRMode )
+#define _randomState    ( RobotContext::Current()->randomState )
+
+
+void pinMode( uint8_t pin, uint8_t mode )
+{
+    if ( pin < HOST_PINS && mode == INPUT_PULLUP ) {
+        _pinLevel[ pin ] = HIGH;
+    }
+}
+
+
+void digitalWrite( uint8_t pin, uint8_t value )
+{
+    HostSetPin( pin, value );
+}
+
+
+int digitalRead( uint8_t pin )
+{
+    return pin < HOST_PINS ? _pinLevel[ pin ] : LOW;
+}
+
+
+int analogRead( uint8_t pin ) { return 0; }
+void analogWrite( uint8_t pin, int value ) {}
+
+
+void attachInterrupt( uint8_t interrupt, void ( *pISR )( void ), int mode )
+{
+    if ( interrupt < HOST_PINS ) {
+        _pinISR[ interrupt ] = pISR;
+        _pinISRMode[ interrupt ] = mode;
+    }
+}
+
+
+void detachInterrupt( uint8_t interrupt )
+{
+    if ( interrupt < HOST_PINS ) {
+        _pinISR[ interrupt ] = NULL;
+    }
+}
+
+
+void HostSetPin( uint8_t pin, uint8_t level )
+{
+    if ( pin >= HOST_PINS ) {
+        return;
+    }
+
+    level = level ? HIGH : LOW;
+    if ( level == _pinLevel[ pin ] ) {
+        return;
+    }
+    _pinLevel[ pin ] = level;
+
+    uint8_t mode = _pinISRMode[ pin ];
+    if ( _pinISR[ pin ] && ( mode == CHANGE || ( mode == RISING ) == ( level == HIGH ) ) ) {
+        _pinISR[ pin ]();
+    }
+}
+
+// nothing is ever connected, so every pulse times out
+unsigned long pulseIn( uint8_t pin, uint8_t state, unsigned long timeout ) { return 0; }
+
+
+unsigned long millis()
+{
+    return RobotContext::Current()->Millis();
+}
+
+
+unsigned long micros()
+{
+    return RobotContext::Current()->Micros();
+}
+
+
+// a simulated clock just moves on, as there's nothing to wait for
+void delay( unsigned long ms )
+{
+    RobotContext* pContext = RobotContext::Current();
+    if ( pContext->IsClockSimulated() ) {
+        pContext->AdvanceClock( ms * 1000 );
+    }
+    else {
+        std::this_thread::sleep_for( std::chrono::milliseconds( ms ) );
+    }
+}
+
+
+void delayMicroseconds( unsigned int us )
+{
+    RobotContext* pContext = RobotContext::Current();
+    if ( pContext->IsClockSimulated() ) {
+        pContext->AdvanceClock( us );
+    }
+    else {
+        std::this_thread::sleep_for( std::chrono::microseconds( us ) );
+    }
+}
+
+
+long map( long x, long inMin, long inMax, long outMin, long outMax )
+{
+    return ( x - inMin ) * ( outMax - outMin ) / ( inMax - inMin ) + outMin;
+}
+
+
+void randomSeed( unsigned long seed )
+{
+    _randomState = seed ? seed : 1;
+}
+
+
+// xorshift32:  small, fast, and good enough for simulation
+long random( long howBig )
+{
+    if ( howBig <= 0 ) {
+        return 0;
+    }
+    _randomState ^= _randomState << 13;
+    _randomState ^= _randomState >> 17;
+    _randomState ^= _randomState << 5;
+    return _randomState % howBig;
+}
+
+
+long random( long howSmall, long howBig )
+{
+    return howSmall >= howBig ? howSmall : howSmall + random( howBig - howSmall );
+}
+
+
+size_t Print::write( const uint8_t* pBuf, size_t n )
+{
+    size_t written = 0;
+    while ( n-- && write( *pBuf++ ) ) {
+        written++;
+    }
+    return written;
+}
+
+
+size_t Print::print( long n, int base )
+{
+    if ( base == DEC && n < 0 ) {
+        return print( '-' ) + printNumber( - (unsigned long) n, DEC );
+    }
+    return printNumber( n, base );
+}
+
+
+size_t Print::print( unsigned long n, int base )
+{
+    return printNumber( n, base );
+}
+
+
+size_t Print::printNumber( unsigned long n, uint8_t base )
+{
+    char buf[ 8 * sizeof( long ) + 1 ];
+    char* pCh = &buf[ sizeof( buf ) - 1 ];
+    *pCh = 0;
+
+    if ( base < 2 ) {
+        base = DEC;
+    }
+    do {
+        uint8_t digit = n % base;
+        n /= base;
+        *--pCh = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    } while ( n );
+
+    return write( pCh );
+}
+
+
+size_t Print::printFloat( double n, uint8_t digits )
+{
+    char buf[ 64 ];
+    snprintf( buf, sizeof( buf ), "%.*f", digits, n );
+    return write( buf );
+}
+
+
+size_t HostSerial::write( uint8_t ch )
+{
+    if ( _pOutput ) {
+        fputc( ch, _pOutput );
+    }
+    return 1;
+}
+
+
+size_t HostSerial::write( const uint8_t* pBuf, size_t n )
+{
+    if ( _pOutput ) {
+        fwrite( pBuf, 1, n, _pOutput );
+    }
+    return n;
+}
+
+#endif
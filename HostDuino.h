@@ -0,0 +1,178 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+// HostDuino
+//
+// Just enough of the Arduino core to build and run the library on a PC, for simulation and
+// testing.  CommonDefs.h includes this in place of Arduino.h whenever ARDUINO is not defined.
+//
+// Pins are ignored (reads return 0), the clock is the host's monotonic clock, and the console
+// is HostSerial.  Serial, the clock, the pins and the random() generator are per robot (see
+// RobotContext.h), so a program can run any number of simulated robots at once, on as many
+// threads as it likes, without their consoles getting mixed up.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <type_traits>
+
+typedef uint8_t     byte;
+typedef bool        boolean;
+
+// strings live in RAM here, so the flash string helpers are just casts
+class __FlashStringHelper;
+#define F( s )              ( reinterpret_cast<const __FlashStringHelper*>( s ) )
+#define PSTR( s )           ( s )
+#define PROGMEM
+#define pgm_read_byte( p )  ( *(const uint8_t*) ( p ) )
+#define pgm_read_word( p )  ( *(const uint16_t*) ( p ) )
+#define pgm_read_dword( p ) ( *(const uint32_t*) ( p ) )
+#define pgm_read_float( p ) ( *(const float*) ( p ) )
+#define memcpy_P            memcpy
+
+#define DEC     10
+#define HEX     16
+#define OCT     8
+#define BIN     2
+
+#define PI          3.1415926535897932384626433832795
+#define HALF_PI     1.5707963267948966192313216916398
+#define TWO_PI      6.283185307179586476925286766559
+#define DEG_TO_RAD  0.017453292519943295769236907684886
+#define RAD_TO_DEG  57.295779513082320876798154814105
+
+#define INPUT           0x0
+#define OUTPUT          0x1
+#define INPUT_PULLUP    0x2
+#define HIGH            0x1
+#define LOW             0x0
+#define CHANGE          1
+#define FALLING         2
+#define RISING          3
+
+#define constrain( amt, low, high ) ( ( amt ) < ( low ) ? ( low ) : ( ( amt ) > ( high ) ? ( high ) : ( amt ) ) )
+
+// functions rather than the Arduino macros, so they don't break the host's standard headers
+template <class A, class B> inline typename std::common_type<A, B>::type min( A a, B b )  { return a < b ? a : b; }
+template <class A, class B> inline typename std::common_type<A, B>::type max( A a, B b )  { return a < b ? b : a; }
+
+#define noInterrupts()
+#define interrupts()
+
+#define digitalPinToInterrupt( p )  ( p )
+
+inline int  toUpperCase( int c )    { return toupper( c ); }
+
+void            pinMode( uint8_t pin, uint8_t mode );
+void            digitalWrite( uint8_t pin, uint8_t value );
+int             digitalRead( uint8_t pin );
+int             analogRead( uint8_t pin );
+void            analogWrite( uint8_t pin, int value );
+unsigned long   pulseIn( uint8_t pin, uint8_t state, unsigned long timeout = 1000000L );
+void            attachInterrupt( uint8_t interrupt, void ( *pISR )( void ), int mode );
+void            detachInterrupt( uint8_t interrupt );
+
+// the host has no pins, so a simulation drives the inputs:  this sets an input's level, as the
+// outside world would, and calls its interrupt handler if the change should trigger it
+#define HOST_PINS       72
+void            HostSetPin( uint8_t pin, uint8_t level );
+
+unsigned long   millis();
+unsigned long   micros();
+void            delay( unsigned long ms );
+void            delayMicroseconds( unsigned int us );
+
+long            map( long x, long inMin, long inMax, long outMin, long outMax );
+void            randomSeed( unsigned long seed );
+long            random( long howBig );
+long            random( long howSmall, long howBig );
+
+
+// Print formats values as text, and hands the characters to write(), as Arduino's does.
+class Print
+{
+    size_t          printNumber( unsigned long n, uint8_t base );
+    size_t          printFloat( double n, uint8_t digits );
+
+public:
+
+    virtual         ~Print() {}
+
+    virtual size_t  write( uint8_t ch ) = 0;
+    virtual size_t  write( const uint8_t* pBuf, size_t n );
+    size_t          write( const char* pStr )   { return pStr ? write( (const uint8_t*) pStr, strlen( pStr ) ) : 0; }
+
+    virtual int     availableForWrite()         { return 0; }
+    virtual void    flush() {}
+
+    size_t          print( const __FlashStringHelper* pStr )    { return write( (const char*) pStr ); }
+    size_t          print( const char* pStr )                   { return write( pStr ); }
+    size_t          print( char ch )                            { return write( (uint8_t) ch ); }
+    size_t          print( unsigned char n, int base = DEC )    { return print( (unsigned long) n, base ); }
+    size_t          print( int n, int base = DEC )              { return print( (long) n, base ); }
+    size_t          print( unsigned int n, int base = DEC )     { return print( (unsigned long) n, base ); }
+    size_t          print( long n, int base = DEC );
+    size_t          print( unsigned long n, int base = DEC );
+    size_t          print( double n, int digits = 2 )           { return printFloat( n, digits ); }
+
+    size_t          println()                                   { return write( (uint8_t) '\n' ); }
+    template <class T>
+    size_t          println( T value )                          { size_t n = print( value ); return n + println(); }
+    template <class T>
+    size_t          println( T value, int format )              { size_t n = print( value, format ); return n + println(); }
+};
+
+
+class Stream : public Print
+{
+public:
+    virtual int     available() = 0;
+    virtual int     read() = 0;
+    virtual int     peek() = 0;
+};
+
+
+// The host console.  Output goes to stdout, or any other FILE* given to SetOutput(), or
+// nowhere if that's NULL.  Input is read from a string given to SetInput(), so a program can
+// feed the CommandDispatcher a script.
+class HostSerial : public Stream
+{
+    FILE*           _pOutput;
+    const char*     _pInput;
+
+public:
+
+    HostSerial() : _pOutput( stdout ), _pInput( "" ) {}
+
+    void            begin( long baud ) {}
+    operator        bool()                      { return true; }
+
+    void            SetOutput( FILE* pOutput )  { _pOutput = pOutput; }
+    void            SetInput( const char* pInput )  { _pInput = pInput ? pInput : ""; }
+
+    virtual size_t  write( uint8_t ch );
+    virtual size_t  write( const uint8_t* pBuf, size_t n );
+    using Print::write;
+
+    virtual int     availableForWrite()         { return 64; }
+    virtual void    flush()                     { if ( _pOutput ) fflush( _pOutput ); }
+
+    virtual int     available()                 { return *_pInput ? 1 : 0; }
+    virtual int     read()                      { return *_pInput ? (uint8_t) *_pInput++ : -1; }
+    virtual int     peek()                      { return *_pInput ? (uint8_t) *_pInput : -1; }
+};
+
+// Serial is per robot, in its RobotContext
@@ -0,0 +1,397 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+// host builds on Linux only
+#if ! defined( ARDUINO ) && defined( __linux__ )
+
+#include <HostTransport.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+enum { eWatchInput, eWatchOutput, eWatchListener, eWatches };
+
+
+HostStream::HostStream() : _inFd( -1 ), _outFd( -1 ), _listenFd( -1 ), _holdFd( -1 ), _bSocket( false ), _bLastCR( false ),
+                           _inHead( 0 ), _inTail( 0 ), _outLength( 0 ), _epollFd( -1 )
+{
+    _path[ 0 ] = 0;
+    for ( uint8_t ix = 0; ix < eWatches; ix++ ) {
+        _watchedFd[ ix ] = -1;
+        _watchedEvents[ ix ] = 0;
+    }
+}
+
+
+bool HostStream::OpenStdio()
+{
+    Close();
+    _inFd = STDIN_FILENO;
+    _outFd = STDOUT_FILENO;
+    watch();
+    return true;
+}
+
+
+const char* HostStream::OpenPty()
+{
+    Close();
+
+    int fd = posix_openpt( O_RDWR | O_NOCTTY );
+    if ( fd < 0 ) {
+        return NULL;
+    }
+    const char* pName = grantpt( fd ) == 0 && unlockpt( fd ) == 0 ? ptsname( fd ) : NULL;
+    if ( ! pName || strlen( pName ) >= sizeof( _path ) ) {
+        close( fd );
+        return NULL;
+    }
+    strcpy( _path, pName );
+
+    // bytes through untouched, as a serial port would pass them
+    struct termios tio;
+    tcgetattr( fd, &tio );
+    cfmakeraw( &tio );
+    tcsetattr( fd, TCSANOW, &tio );
+    fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) | O_NONBLOCK );
+    fcntl( fd, F_SETFD, FD_CLOEXEC );
+
+    // with nobody on the other end, the pty reads as hung up, and epoll would never stop saying
+    // so;  holding it open ourselves lets terminal programs come and go
+    _holdFd = open( _path, O_RDWR | O_NOCTTY | O_CLOEXEC );
+
+    _inFd = _outFd = fd;
+    watch();
+    return _path;
+}
+
+
+bool HostStream::ListenUnix( const char* pPath )
+{
+    Close();
+
+    struct sockaddr_un addr;
+    memset( &addr, 0, sizeof( addr ) );
+    if ( strlen( pPath ) >= sizeof( addr.sun_path ) ) {
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy( addr.sun_path, pPath );
+
+    int fd = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+    if ( fd < 0 ) {
+        return false;
+    }
+    unlink( pPath );    // left over from last time
+    if ( bind( fd, (struct sockaddr*) &addr, sizeof( addr ) ) < 0 || listen( fd, 1 ) < 0 ) {
+        close( fd );
+        return false;
+    }
+
+    strcpy( _path, pPath );
+    _listenFd = fd;
+    _bSocket = true;
+    watch();
+    return true;
+}
+
+
+void HostStream::Close()
+{
+    flushOutput( HOST_STREAM_WRITE_TIMEOUT );
+    if ( _bSocket ) {
+        closeClient();
+    }
+    else if ( _inFd > STDERR_FILENO ) {
+        close( _inFd );     // the pty;  stdin and stdout stay open for the rest of the program
+    }
+    if ( _listenFd >= 0 ) {
+        close( _listenFd );
+        unlink( _path );
+    }
+    if ( _holdFd >= 0 ) {
+        close( _holdFd );
+    }
+
+    _inFd = _outFd = _listenFd = _holdFd = -1;
+    _bSocket = false;
+    _path[ 0 ] = 0;
+    _inHead = _inTail = 0;
+    _outLength = 0;
+    watch();
+}
+
+
+void HostStream::acceptClient()
+{
+    int fd = accept4( _listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC );
+    if ( fd < 0 ) {
+        return;
+    }
+    // the newest client gets the console
+    closeClient();
+    _inFd = _outFd = fd;
+    watch();
+}
+
+
+void HostStream::closeClient()
+{
+    if ( _bSocket ) {
+        if ( _inFd >= 0 ) {
+            close( _inFd );
+        }
+        _outFd = -1;
+        _outLength = 0;
+    }
+    _inFd = -1;         // and for stdin, it's the end of the input
+    _inHead = _inTail = 0;
+    _bLastCR = false;
+    watch();
+}
+
+
+void HostStream::fillInput()
+{
+    if ( _listenFd >= 0 ) {
+        acceptClient();
+    }
+    if ( _inFd < 0 ) {
+        return;
+    }
+
+    struct pollfd pfd = { _inFd, POLLIN, 0 };
+    if ( poll( &pfd, 1, 0 ) <= 0 ) {
+        return;
+    }
+
+    uint8_t raw[ HOST_STREAM_INPUT_SIZE ];
+    ssize_t n = ::read( _inFd, raw, sizeof( raw ) );
+    if ( n < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ) ) {
+        return;
+    }
+    if ( n <= 0 ) {
+        closeClient();  // hung up, or the end of the input
+        return;
+    }
+
+    _inHead = _inTail = 0;
+    for ( ssize_t ix = 0; ix < n; ix++ ) {
+        uint8_t ch = raw[ ix ];
+        bool bCR = ch == '\r';
+        if ( ch == '\n' ) {
+            if ( _bLastCR ) {
+                _bLastCR = false;
+                continue;
+            }
+            ch = '\r';
+        }
+        _bLastCR = bCR;
+        _input[ _inTail++ ] = ch;
+    }
+}
+
+
+int HostStream::available()
+{
+    if ( _inHead == _inTail ) {
+        fillInput();
+    }
+    return _inTail - _inHead;
+}
+
+
+int HostStream::read()
+{
+    return available() ? _input[ _inHead++ ] : -1;
+}
+
+
+int HostStream::peek()
+{
+    return available() ? _input[ _inHead ] : -1;
+}
+
+
+// write what's pending, waiting up to timeoutMs for the other end to take it.  Returns true if
+// it's all gone, one way or another.
+bool HostStream::flushOutput( int timeoutMs )
+{
+    while ( _outLength ) {
+        if ( _outFd < 0 ) {
+            _outLength = 0;     // nobody to write to
+            break;
+        }
+
+        ssize_t n = _bSocket ? send( _outFd, _output, _outLength, MSG_NOSIGNAL ) : ::write( _outFd, _output, _outLength );
+        if ( n > 0 ) {
+            memmove( _output, _output + n, _outLength - n );
+            _outLength -= n;
+        }
+        else if ( n < 0 && errno == EINTR ) {
+            continue;
+        }
+        else if ( n < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) ) {
+            if ( ! timeoutMs ) {
+                break;
+            }
+            struct pollfd pfd = { _outFd, POLLOUT, 0 };
+            if ( poll( &pfd, 1, timeoutMs ) <= 0 ) {
+                _outLength = 0;     // the other end isn't reading;  carry on without it
+            }
+        }
+        else if ( _bSocket ) {
+            closeClient();          // the client has gone
+        }
+        else {
+            _outLength = 0;
+        }
+    }
+
+    watch();
+    return _outLength == 0;
+}
+
+
+size_t HostStream::write( const uint8_t* pBuf, size_t n )
+{
+    for ( size_t done = 0; done < n && _outFd >= 0; ) {
+        if ( _outLength == sizeof( _output ) ) {
+            flushOutput( HOST_STREAM_WRITE_TIMEOUT );
+        }
+        size_t chunk = min( n - done, sizeof( _output ) - _outLength );
+        memcpy( _output + _outLength, pBuf + done, chunk );
+        _outLength += chunk;
+        done += chunk;
+    }
+    flushOutput( 0 );
+    return n;
+}
+
+
+int HostStream::availableForWrite()
+{
+    flushOutput( 0 );
+    return sizeof( _output ) - _outLength;
+}
+
+
+// keep the event loop's registrations in step with the descriptors, and with whether there's
+// output waiting to go
+void HostStream::watch()
+{
+    uint32_t outEvents = _outLength ? EPOLLOUT : 0;
+    if ( _inFd >= 0 && _inFd == _outFd ) {
+        watchFd( eWatchInput, _inFd, EPOLLIN | outEvents );
+        watchFd( eWatchOutput, -1, 0 );
+    }
+    else {
+        watchFd( eWatchInput, _inFd, EPOLLIN );
+        watchFd( eWatchOutput, _outFd, outEvents );
+    }
+    watchFd( eWatchListener, _listenFd, EPOLLIN );
+}
+
+
+void HostStream::watchFd( uint8_t ix, int fd, uint32_t events )
+{
+    if ( fd < 0 || ! events || _epollFd < 0 ) {
+        fd = -1;
+        events = 0;
+    }
+    if ( fd == _watchedFd[ ix ] && events == _watchedEvents[ ix ] ) {
+        return;
+    }
+
+    // a closed descriptor has already left the epoll set, and its number may be back already as
+    // another one, so a failed MOD or DEL is expected now and then
+    if ( _watchedFd[ ix ] >= 0 && _watchedFd[ ix ] != fd ) {
+        epoll_ctl( _epollFd, EPOLL_CTL_DEL, _watchedFd[ ix ], NULL );
+    }
+    if ( fd >= 0 ) {
+        struct epoll_event event;
+        event.events = events;
+        event.data.ptr = this;
+        if ( fd != _watchedFd[ ix ] || epoll_ctl( _epollFd, EPOLL_CTL_MOD, fd, &event ) < 0 ) {
+            if ( epoll_ctl( _epollFd, EPOLL_CTL_ADD, fd, &event ) < 0 && errno == EEXIST ) {
+                epoll_ctl( _epollFd, EPOLL_CTL_MOD, fd, &event );
+            }
+        }
+    }
+    // epoll won't take a plain file, so stdout redirected to one just isn't waited on
+    _watchedFd[ ix ] = fd;
+    _watchedEvents[ ix ] = events;
+}
+
+
+HostEventLoop::HostEventLoop()
+{
+    _epollFd = epoll_create1( EPOLL_CLOEXEC );
+}
+
+
+HostEventLoop::~HostEventLoop()
+{
+    if ( _epollFd >= 0 ) {
+        close( _epollFd );
+    }
+}
+
+
+bool HostEventLoop::Add( HostStream* pStream )
+{
+    if ( _epollFd < 0 || pStream->_epollFd >= 0 ) {
+        return false;
+    }
+    pStream->_epollFd = _epollFd;
+    pStream->watch();
+    return true;
+}
+
+
+void HostEventLoop::Remove( HostStream* pStream )
+{
+    if ( pStream->_epollFd == _epollFd ) {
+        for ( uint8_t ix = 0; ix < eWatches; ix++ ) {
+            pStream->watchFd( ix, -1, 0 );
+        }
+        pStream->_epollFd = -1;
+    }
+}
+
+
+int HostEventLoop::Wait( int timeoutMs, HostStream** ppReady, int maxReady )
+{
+    struct epoll_event events[ 64 ];
+    int n = epoll_wait( _epollFd, events, 64, timeoutMs );
+
+    int nReady = 0;
+    for ( int ix = 0; ix < n; ix++ ) {
+        HostStream* pStream = (HostStream*) events[ ix ].data.ptr;
+        if ( pStream->_listenFd >= 0 ) {
+            pStream->acceptClient();
+        }
+        pStream->flushOutput( 0 );
+        if ( pStream->available() ) {
+            if ( nReady < maxReady ) {
+                ppReady[ nReady ] = pStream;
+            }
+            nReady++;
+        }
+    }
+    return nReady;
+}
+
+#endif
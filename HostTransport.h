@@ -0,0 +1,125 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+// host builds on Linux only:  the event loop is epoll
+#if ! defined( ARDUINO ) && defined( __linux__ )
+
+#include <CommonDefs.h>
+
+#define HOST_STREAM_INPUT_SIZE      64
+#define HOST_STREAM_OUTPUT_SIZE     1024
+
+// how long a write waits on a console which isn't reading before its output is thrown away
+#define HOST_STREAM_WRITE_TIMEOUT   1000
+
+
+// Host transports
+//
+// HostStream is a console for a simulated robot, on a file descriptor rather than a UART, so
+// the same serial tools and scripts that talk to the robot can talk to the simulation.  Give it
+// to CommandDispatcher::SetConsole().  It can be
+//
+//   stdin and stdout       OpenStdio();  stdin must be a terminal or a pipe
+//   a pty                  OpenPty(), which returns the name to give a terminal program
+//   a Unix socket          ListenUnix( path );  one client at a time, a new one replacing the last
+//
+// The pty and sockets are non-blocking;  stdin and stdout are left as the shell set them, and
+// stdin is only read when poll() says there's something there.  Input is read into a small
+// buffer as the Stream is asked for it.  Output is buffered too, and availableForWrite() is the
+// room left, so SerialTx only hands over what can be written without waiting;  only its blocking
+// drain waits, for up to HOST_STREAM_WRITE_TIMEOUT ms.  Nobody connected counts as a console
+// which reads everything.
+//
+// Lines may end in CR, LF or CR LF;  the dispatcher sees a CR.
+class HostStream : public Stream
+{
+    int         _inFd;
+    int         _outFd;
+    int         _listenFd;      // a socket waiting for clients
+    int         _holdFd;        // our own handle on a pty's other end, so it isn't hung up
+    bool        _bSocket;
+    bool        _bLastCR;       // the last char in was a CR, so an LF after it is dropped
+
+    uint8_t     _input[ HOST_STREAM_INPUT_SIZE ];
+    uint8_t     _inHead;
+    uint8_t     _inTail;
+    uint8_t     _output[ HOST_STREAM_OUTPUT_SIZE ];
+    uint16_t    _outLength;
+
+    char        _path[ 108 ];   // the socket's, to remove it when we're done, or the pty's
+
+    // the event loop we're registered with, and what for:  the input, the output (when it's
+    // another descriptor), and the listening socket
+    int         _epollFd;
+    int         _watchedFd[ 3 ];
+    uint32_t    _watchedEvents[ 3 ];
+
+    void        fillInput();
+    bool        flushOutput( int timeoutMs );
+    void        acceptClient();
+    void        closeClient();
+    void        watch();
+    void        watchFd( uint8_t ix, int fd, uint32_t events );
+
+    friend class HostEventLoop;
+
+public:
+
+    HostStream();
+    ~HostStream()           { Close(); }
+
+    bool            OpenStdio();
+    const char*     OpenPty();
+    bool            ListenUnix( const char* pPath );
+    void            Close();
+
+    // false once the input has ended (stdin at EOF), or if nothing was opened;  a socket with no
+    // client, or a pty with no terminal on it, is still open
+    bool            IsOpen()        { return _inFd >= 0 || _listenFd >= 0; }
+    bool            IsConnected()   { return _inFd >= 0; }
+
+    virtual int     available();
+    virtual int     read();
+    virtual int     peek();
+
+    virtual size_t  write( uint8_t ch )     { return write( &ch, 1 ); }
+    virtual size_t  write( const uint8_t* pBuf, size_t n );
+    using Print::write;
+    virtual int     availableForWrite();
+    virtual void    flush()                 { flushOutput( HOST_STREAM_WRITE_TIMEOUT ); }
+};
+
+
+// HostEventLoop waits on any number of HostStreams, so a host program can sleep until there's
+// a command to read or it's time for the next tick, rather than polling available().  Streams
+// keep their registration up to date themselves (a socket's client comes and goes, and output
+// is only waited on while some is pending), so after Add(), just call Wait().
+class HostEventLoop
+{
+    int     _epollFd;
+
+public:
+
+    HostEventLoop();
+    ~HostEventLoop();
+
+    bool    Add( HostStream* pStream );
+    void    Remove( HostStream* pStream );
+
+    // wait for up to timeoutMs (-1 for ever) for a stream to have input, accepting clients and
+    // writing pending output on the way.  Returns how many of the streams which woke us have
+    // input, and puts (up to maxReady of) them in ppReady, so a loop with many streams needn't
+    // ask them all.
+    int     Wait( int timeoutMs, HostStream** ppReady = NULL, int maxReady = 0 );
+};
+
+#endif
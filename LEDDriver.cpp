@@ -12,154 +12,84 @@ Subsumption Architecture as described by David P. Anderson.
 
 // LED motor emulator
 
-LEDDriver::LEDDriver( uint8_t pwmPinLeft, uint8_t pwmPinRight, uint8_t dirPinLeft, uint8_t dirPinRight, CommandDispatcher* pCD, Position* pOD, float ticksPerInch ) : 
+LEDDriver::LEDDriver( uint8_t pwmPinLeft, uint8_t pwmPinRight, uint8_t dirPinLeft, uint8_t dirPinRight, CommandDispatcher* pCD ) : 
     Behavior( pCD ),
-    _ledPwmPinLeft(pwmPinLeft), 
-    _ledPwmPinRight(pwmPinRight), 
-    _ledDirPinLeft(dirPinLeft), 
-    _ledDirPinRight(dirPinRight),
-    _pPosition( pOD ),
-    _ticksPerInch( ticksPerInch )
+    _output( eBipolarLed )
 {
     _pName = F("LED 'Motor'");
+    _bReflex = true;    // the output stage acts on urgent ticks too
     // note that pNextSub is being overwritten here, but this should not be a problem as long as
     // the next subscriber for each event is the same, which it should be here.
     // if necessary, these could be separate variables, and the appropriate pointer would need
     // to be returned in HandleEvent().
     SubscribeTo( pCD, 'L' );    // All our commands begin with "L"
 
-    _leftRatio = 1.0;
-    _rightRatio = 1.0;   // introduce a differential to simulate extra drag on this side
-
-    _throttleChangeLimit = 64;  // prevent throttle from changing more than this in each step
-
-    pinMode( _ledPwmPinLeft, OUTPUT );
-    pinMode( _ledPwmPinRight, OUTPUT );
-    pinMode( _ledDirPinLeft, OUTPUT );
-    pinMode( _ledDirPinRight, OUTPUT );
-
-    _pHelpString =  F(  "  D <LeftRatio> <RightRatio>: Set 'Motor' differential ratios\n"
-                        "  L <Limit>: Set throttle change limit\n"
-                        "  S <LeftSpeed> <RightSpeed>: Set 'Motor' speeds"
+    _output.AddChannel( pwmPinLeft, dirPinLeft, eLeftSide );
+    _output.AddChannel( pwmPinRight, dirPinRight, eRightSide );
+
+    _pHelpString =  F(  "  L <Limit>: Set throttle change limit\n"
+                        "  S <LeftSpeed> <RightSpeed>: Set 'Motor' speeds\n"
+                        "  D <Deadband>: Set smallest throttle to show\n"
+                        "  R <0|1>: Ramp throttle changes over each interval\n"
+                        "  I <Mask>: Set inverted channels (1 left, 2 right)\n"
+                        "  T : Latency report\n"
+                        "  U <Source> <us>: Set latency bound (0 bump, 1 command, 2 snapshot)\n"
+                        "  Z : Clear latency statistics"
                     );
 }
 
-void LEDDriver::Update( void ) {
-/*    if ( LED_On_duration_ms > 0 ) {
-        unsigned int currTime = millis();
-        if ( currTime > LED_Change_Time ) {
-            LED_State = !LED_State;
-            digitalWrite( ledPin, LED_State );
-            LED_Change_Time = currTime + (LED_State == LOW ? LED_Off_duration_ms : LED_On_duration_ms);
-        }
-    }
-*/
+// called from loop(), to ramp the outputs between ticks
+void LEDDriver::Update( void )
+{
+    _output.Update();
 }
 
 
 void LEDDriver::handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams )
 {
     if ( _bEnabled ) {
-        SubsumptionParams* pSubsumptionParams = (SubsumptionParams*) pEvent->pData;
-
-        // don't allow rapid throttle changes
-        _throttleLeft = constrain( pSubsumptionParams->GetLeftThrottle(), _throttleLeft - _throttleChangeLimit, _throttleLeft + _throttleChangeLimit );
-        _throttleRight = constrain( pSubsumptionParams->GetRightThrottle(), _throttleRight - _throttleChangeLimit, _throttleRight + _throttleChangeLimit );
-
-        SetLED( _throttleLeft, _ledPwmPinLeft, _ledDirPinLeft );
-        SetLED( _throttleRight, _ledPwmPinRight, _ledDirPinRight );
-
-        // display name of subsuming Behavior, and requested throttle settings
-        if ( _messageMask & MM_INFO && pSubsumptionParams->ControlFreak() ) {
-            Serial.print( '[' );
-            Serial.print( pSubsumptionParams->ControlFreak()->GetName() );
-            Serial.print( F( "] " ) );
-            Serial.print( _throttleLeft );
-            Serial.print( '/' );
-            Serial.println( _throttleRight );
+        if ( pSubsumptionParams->IsUrgent() ) {
+            // a reflex:  don't wait for the ramp
+            _output.SetUrgent( pSubsumptionParams->GetLeftThrottle(), pSubsumptionParams->GetRightThrottle(), pSubsumptionParams );
+        }
+        else {
+            // ramp to the new throttles over the interval, as Update() is called
+            _output.Set( pSubsumptionParams->GetLeftThrottle(), pSubsumptionParams->GetRightThrottle(), pSubsumptionParams->GetInterval(), pSubsumptionParams );
         }
 
-        // simulate Position update.  Assume full throttle yields 10 IPS, scale to produce encoder ticks per step
-        // apply differential ratios to simulate motor/gear/wheel differences in throttle response.
-        float maxTicksPerStep = _ticksPerInch * 10.0 * ( (float) pSubsumptionParams->GetInterval() / 1000.0 );
-        _pPosition->_currentEncoderPositionLeft += map( _throttleLeft, 0, 255, 0, maxTicksPerStep ) * _leftRatio;
-        _pPosition->_currentEncoderPositionRight += map( _throttleRight, 0, 255, 0, maxTicksPerStep )  * _rightRatio;
-
-        if ( _messageMask & MM_PROGRESS ) {
-            PRINT_VAR( maxTicksPerStep );
-            Serial.print( F( "Positions set to: " ) );
-
-            Serial.print( _pPosition->_currentEncoderPositionLeft );
-            Serial.print( '/' );
-            Serial.println( _pPosition->_currentEncoderPositionRight );
+        // display name of subsuming Behavior, and requested throttle settings
+        if ( MM_ON( MM_INFO ) && pSubsumptionParams->ControlFreak() ) {
+            ConsoleLine.Format( F( "[%S] %d/%d\n" ), pSubsumptionParams->ControlFreak()->GetName(), _output.GetLeft(), _output.GetRight() );
+            ConsoleLine.Flush();
         }
 
         IF_CSV( MM_CSVBASIC ) {
-            CSV_OUT( _throttleLeft );
-            CSV_OUT( _throttleRight );
+            int throttleLeft = _output.GetLeft();
+            int throttleRight = _output.GetRight();
+            CSV_OUT( throttleLeft );
+            CSV_OUT( throttleRight );
             CSV_OUT( pSubsumptionParams->ControlFreak()->GetName() );
         }
     }
 }
 
 
+// The LED's are bipolar red/green, connected so that driving with one polarity produces green
+// and reversing the polarity produces red.  One side of the LED pair is connected to a digital
+// pin which is set low for forward and high for reverse.  The other side is connected to a
+// PWM output for dimming to reflect speed.  MotorOutput's eBipolarLed mode inverts the PWM
+// when the direction pin is high, to maintain the correct brightness/speed relationship.
+
 void LEDDriver::handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs )
 {
-    CommandArgs* pData = (CommandArgs*) pEvent->pData;
-
-    // check the sub-command.
-    switch( pData->inputBuffer[1] ) {
-        case 'S' : // set "speeds"
-            if ( _bEnabled ) {
-
-                int leftSpeed = pData->nParams[0];
-                int rightSpeed = pData->nParams[1];
-
-                SetLED( leftSpeed, _ledPwmPinLeft, _ledDirPinLeft );
-                SetLED( rightSpeed, _ledPwmPinRight, _ledDirPinRight );
-
-                IF_MASK( MM_RESPONSES ) {
-                    Serial.print( F( "LED simulator speeds directly set to: " ) );
-                    Serial.print( leftSpeed ); Serial.print( '\t' );
-                    Serial.println( rightSpeed );
-                }
-            }
-            break;
-
-        case 'D' : // set throttle/speed differential
-            _leftRatio = pData->fParams[0];
-            _rightRatio = pData->fParams[1];
-
-            IF_MASK( MM_RESPONSES ) {
-                Serial.print( F( "LED simulator throttle/speed ratios set to: " ) );
-                Serial.print( _leftRatio ); Serial.print( '\t' );
-                Serial.println( _rightRatio );
-            }
-            break;
-
-        case 'L' : // set throttle limit
-            _throttleChangeLimit = pData->nParams[0];
-
-            IF_MASK( MM_RESPONSES ) {
-                Serial.print( F( "LED throttle change limit set to " ) );
-                Serial.println( _throttleChangeLimit );
-            }
-            break;
+    // speeds can only be set directly while we're enabled
+    if ( pArgs->inputBuffer[1] != 'S' || _bEnabled ) {
+        _output.HandleCommand( pArgs, MM_ON( MM_RESPONSES ) );
     }
 }
 
 
-// The LED's are bipolar red/green, connected so that driving with one polarity produces green
-// and reversing the polarity produces red.  One side of the LED pair is connected to a digital
-// pin which is set high for forward and low for reverse.  The other side is connected to a
-// PWM output for dimming to reflect speed.  When the direction pin is high, PWM is inverted
-// to maintain the correct brightness/speed relationship.
-
-void LEDDriver::SetLED( int speed, int pwmPin, int dirPin )
+void LEDDriver::PrintSpecificParameterValues()
 {
-    bool bFwd  = speed >= 0;
-    int throttle  = constrain( speed, -255, 255 );
-        
-    analogWrite( pwmPin,  bFwd  ? throttle  : 255 + throttle ); // slightly non-obvious: !bFwd means throttle is negative
-    digitalWrite( dirPin,  !bFwd  );
-}
\ No newline at end of file
+    _output.Print();
+}
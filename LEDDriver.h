@@ -12,7 +12,7 @@ Subsumption Architecture as described by David P. Anderson.
 
 #include <CommandDispatcher.h>
 #include <Director.h>
-#include <Position.h>
+#include <MotorOutput.h>
 
 /// LEDDriver simulates motors in a simplistic way:
 /// A motor is represented by two LED's, one to indicate forward motion, the other to indicate backward motion.
@@ -25,29 +25,20 @@ Subsumption Architecture as described by David P. Anderson.
 /// For diagnostic and testing purposes (which is what the LEDDriver is for anyway),
 /// the "L <LeftSpeed> <RightSpeed>" command sets the speed
 /// of the two "motors".  Reverse direction is indicated by negative speeds.
+///
+/// LEDDriver only shows the throttles.  In the emulator, DrivePlant turns them into motion.
 
 class LEDDriver : public Behavior
 {
-    uint8_t         _ledPwmPinLeft, _ledPwmPinRight, _ledDirPinLeft, _ledDirPinRight;
-
-    Position*       _pPosition;
-    float           _ticksPerInch;
-
-    int             _throttleLeft;
-    int             _throttleRight;
-
-    float           _leftRatio;
-    float           _rightRatio;
-
-    int             _throttleChangeLimit;
-
-    void            SetLED( int speed, int pwmPin, int dirPin );
-
+    MotorOutput     _output;
 
 public:
 
-    LEDDriver( uint8_t pwmPinLeft, uint8_t pwmPinRight, uint8_t dirPinLeft, uint8_t dirPinRight, CommandDispatcher* pCD, Position* pOD, float ticksPerInch );
+    LEDDriver( uint8_t pwmPinLeft, uint8_t pwmPinRight, uint8_t dirPinLeft, uint8_t dirPinRight, CommandDispatcher* pCD );
     void                Update( void );
+    MotorOutput*        GetOutput()     { return &_output; }
+
     virtual void        handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs );
     virtual void        handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams );
+    virtual void        PrintSpecificParameterValues();
 };
@@ -0,0 +1,150 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#include <Latency.h>
+#include <Director.h>
+
+LatencyStats::LatencyStats()
+{
+    Clear();
+    memset( _bound, 0, sizeof( _bound ) );
+}
+
+
+void LatencyStats::Clear()
+{
+    memset( _count, 0, sizeof( _count ) );
+    memset( _max, 0, sizeof( _max ) );
+    memset( _hist, 0, sizeof( _hist ) );
+    _heldMask = 0;
+    for ( uint8_t source = 0; source < eLatencySources; source++ ) {
+        _min[ source ] = 0xFFFFFFFFUL;
+    }
+}
+
+
+void LatencyStats::Record( uint8_t source, unsigned long us )
+{
+    uint8_t bucket = 0;
+    for ( unsigned long n = us; n > 1 && bucket < LATENCY_BUCKETS - 1; n >>= 1 ) {
+        bucket++;
+    }
+
+    uint16_t* pHist = _hist[ source ];
+    if ( pHist[ bucket ] == 0xFFFF ) {
+        // halve the lot, which keeps the shape of the distribution
+        for ( uint8_t ix = 0; ix < LATENCY_BUCKETS; ix++ ) {
+            pHist[ ix ] >>= 1;
+        }
+    }
+    pHist[ bucket ]++;
+
+    _count[ source ]++;
+    _min[ source ] = min( _min[ source ], us );
+    _max[ source ] = max( _max[ source ], us );
+}
+
+
+void LatencyStats::Hold( SubsumptionParams* pParams )
+{
+    if ( ! pParams ) {
+        return;
+    }
+    for ( uint8_t source = 0; source < eLatencySources; source++ ) {
+        const LatencyStamp& stamp = pParams->GetStamp( source );
+        if ( stamp.id && ! ( _heldMask & ( 1 << source ) ) ) {
+            _heldMicros[ source ] = stamp.micros;
+            _heldMask |= 1 << source;
+        }
+    }
+}
+
+
+void LatencyStats::RecordHeld()
+{
+    if ( ! _heldMask ) {
+        return;
+    }
+    unsigned long now = micros();
+    for ( uint8_t source = 0; source < eLatencySources; source++ ) {
+        if ( _heldMask & ( 1 << source ) ) {
+            Record( source, now - _heldMicros[ source ] );
+        }
+    }
+    _heldMask = 0;
+}
+
+
+// the histogram only knows which power of 2 each latency fell in, so assume they're spread
+// evenly across their bucket
+unsigned long LatencyStats::GetPercentile( uint8_t source, uint8_t percent )
+{
+    uint32_t total = 0;
+    for ( uint8_t ix = 0; ix < LATENCY_BUCKETS; ix++ ) {
+        total += _hist[ source ][ ix ];
+    }
+    if ( total == 0 ) {
+        return 0;
+    }
+
+    float rank = total * ( percent / 100.0 );
+    uint32_t below = 0;
+    for ( uint8_t ix = 0; ix < LATENCY_BUCKETS; ix++ ) {
+        uint16_t n = _hist[ source ][ ix ];
+        if ( n && below + n >= rank ) {
+            float lo = ix ? 1UL << ix : 0;
+            float hi = 1UL << ( ix + 1 );
+            unsigned long us = lo + ( hi - lo ) * ( rank - below ) / n;
+            return constrain( us, GetMin( source ), _max[ source ] );
+        }
+        below += n;
+    }
+    return _max[ source ];
+}
+
+
+bool LatencyStats::WithinBounds()
+{
+    for ( uint8_t source = 0; source < eLatencySources; source++ ) {
+        if ( _bound[ source ] && _max[ source ] > _bound[ source ] ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void LatencyStats::Print()
+{
+    SerialTx.println( F( " Latency (us)\tcount\tmin\tp50\tp90\tp99\tmax\tbound" ) );
+    for ( uint8_t source = 0; source < eLatencySources; source++ ) {
+        SerialTx.print( F( "  " ) );
+        SerialTx.print( source ); SerialTx.print( ' ' );
+        switch ( source ) {
+            case eLatencyBump :     SerialTx.print( F( "Bump\t" ) );     break;
+            case eLatencyCommand :  SerialTx.print( F( "Command\t" ) );  break;
+            case eLatencySnapshot : SerialTx.print( F( "Snapshot\t" ) ); break;
+        }
+        SerialTx.print( _count[ source ] ); SerialTx.print( '\t' );
+        SerialTx.print( GetMin( source ) ); SerialTx.print( '\t' );
+        SerialTx.print( GetPercentile( source, 50 ) ); SerialTx.print( '\t' );
+        SerialTx.print( GetPercentile( source, 90 ) ); SerialTx.print( '\t' );
+        SerialTx.print( GetPercentile( source, 99 ) ); SerialTx.print( '\t' );
+        SerialTx.print( _max[ source ] ); SerialTx.print( '\t' );
+        if ( _bound[ source ] ) {
+            SerialTx.print( _bound[ source ] );
+            SerialTx.print( _max[ source ] > _bound[ source ] ? F( " OVER" ) : F( " ok" ) );
+        }
+        else {
+            SerialTx.print( '-' );
+        }
+        SerialTx.println();
+    }
+}
@@ -0,0 +1,90 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+#include <CommonDefs.h>
+
+class SubsumptionParams;
+
+// where a stimulus came from
+enum eLatencySource
+{
+    eLatencyBump,       // a bumper press, from the interrupt
+    eLatencyCommand,    // the CR at the end of a command line
+    eLatencySnapshot,   // the start of a regular tick, when Position snapshots the encoders:  every tick
+                        // has one, so this is the chain and output stage's own share of the latency
+    eLatencySources
+};
+
+// bucket n counts latencies from 2^n to 2^(n+1) - 1 us;  the last bucket takes anything longer,
+// which at 2^20 us is over a second
+#define LATENCY_BUCKETS     21
+
+
+// a stimulus, stamped where it happened, and carried through the tick in SubsumptionParams
+struct LatencyStamp
+{
+    uint16_t        id;         // 0 if there's no stamp
+    unsigned long   micros;
+};
+
+
+// LatencyStats
+//
+// LatencyStats keeps the distribution of the time from each kind of stimulus to the output stage
+// writing the pins in response.  The sources stamp the stimulus (Director::Stamp()), the Director
+// carries the stamps through the tick in SubsumptionParams, and the output stage Hold()s them until
+// the pins show the tick's target:  at once for an urgent tick, or where there's no ramp, or
+// otherwise when the ramp gets there (or the next tick writes the target anyway), when it calls
+// RecordHeld().
+//
+// Each source has a log2 histogram, from which the percentiles are estimated, along with the exact
+// count, min and max.  A source can be given a bound, which its max is checked against, so host
+// programs (or a safety review) can see whether the reaction time was ever exceeded.
+class LatencyStats
+{
+    uint32_t        _count[ eLatencySources ];
+    unsigned long   _min[ eLatencySources ];
+    unsigned long   _max[ eLatencySources ];
+    unsigned long   _bound[ eLatencySources ];  // 0 for none
+    uint16_t        _hist[ eLatencySources ][ LATENCY_BUCKETS ];
+
+    unsigned long   _heldMicros[ eLatencySources ];
+    uint8_t         _heldMask;                  // bit n for source n
+
+public:
+
+    LatencyStats();
+
+    void            Clear();
+
+    void            Record( uint8_t source, unsigned long us );
+
+    // keep the stamps carried by this tick until its target is written.  A source already held
+    // keeps its earlier stamp.
+    void            Hold( SubsumptionParams* pParams );
+
+    // record the held stamps, as of now, and let them go
+    void            RecordHeld();
+
+    uint32_t        GetCount( uint8_t source )      { return _count[ source ]; }
+    unsigned long   GetMin( uint8_t source )        { return _count[ source ] ? _min[ source ] : 0; }
+    unsigned long   GetMax( uint8_t source )        { return _max[ source ]; }
+    unsigned long   GetPercentile( uint8_t source, uint8_t percent );
+
+    void            SetBound( uint8_t source, unsigned long us )    { _bound[ source ] = us; }
+    unsigned long   GetBound( uint8_t source )                      { return _bound[ source ]; }
+
+    // true if no source has gone over its bound
+    bool            WithinBounds();
+
+    void            Print();
+};
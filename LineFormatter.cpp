@@ -0,0 +1,140 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#include <LineFormatter.h>
+#include <TxRing.h>
+
+#ifdef ARDUINO
+LineFormatter   ConsoleLine( &SerialTx );
+#endif
+
+
+size_t LineFormatter::write( uint8_t ch )
+{
+    if ( _length == LINE_FORMAT_SIZE ) {
+        Flush();
+    }
+    _buffer[ _length++ ] = ch;
+    return 1;
+}
+
+
+size_t LineFormatter::write( const uint8_t* pBuf, size_t n )
+{
+    for ( size_t done = 0; done < n; ) {
+        if ( _length == LINE_FORMAT_SIZE ) {
+            Flush();
+        }
+        size_t chunk = min( n - done, (size_t) ( LINE_FORMAT_SIZE - _length ) );
+        memcpy( _buffer + _length, pBuf + done, chunk );
+        _length += chunk;
+        done += chunk;
+    }
+    return n;
+}
+
+
+void LineFormatter::Flush()
+{
+    if ( _length && _pOutput ) {
+        _pOutput->write( (const uint8_t*) _buffer, _length );
+    }
+    _length = 0;
+}
+
+
+size_t LineFormatter::print( double n, int digits )
+{
+    char buffer[ FLOAT_FORMAT_SIZE ];
+    return write( (const uint8_t*) buffer, FormatFixed( buffer, n, digits ) );
+}
+
+
+size_t LineFormatter::printCompact( double n, int digits )
+{
+    char buffer[ FLOAT_FORMAT_SIZE ];
+    return write( (const uint8_t*) buffer, FormatCompact( buffer, n, digits ) );
+}
+
+
+size_t LineFormatter::Format( const __FlashStringHelper* pFormat, ... )
+{
+    va_list args;
+    va_start( args, pFormat );
+    size_t n = FormatV( pFormat, args );
+    va_end( args );
+    return n;
+}
+
+
+size_t LineFormatter::FormatV( const __FlashStringHelper* pFormat, va_list args )
+{
+    const char* pCh = (const char*) pFormat;
+    size_t n = 0;
+
+    for ( char ch = pgm_read_byte( pCh++ ); ch; ch = pgm_read_byte( pCh++ ) ) {
+        if ( ch != '%' ) {
+            n += write( (uint8_t) ch );
+            continue;
+        }
+
+        // precision, for %f
+        uint8_t digits = 2;
+        ch = pgm_read_byte( pCh++ );
+        if ( ch == '.' ) {
+            digits = 0;
+            for ( ch = pgm_read_byte( pCh++ ); ch >= '0' && ch <= '9'; ch = pgm_read_byte( pCh++ ) ) {
+                digits = digits * 10 + ch - '0';
+            }
+        }
+
+        bool bLong = ch == 'l';
+        if ( bLong ) {
+            ch = pgm_read_byte( pCh++ );
+        }
+
+        switch ( ch ) {
+            case 'd' :
+            case 'i' :
+                n += bLong ? print( va_arg( args, long ) ) : print( va_arg( args, int ) );
+                break;
+            case 'u' :
+                n += bLong ? print( va_arg( args, unsigned long ) ) : print( va_arg( args, unsigned int ) );
+                break;
+            case 'x' :
+                n += bLong ? print( va_arg( args, unsigned long ), HEX ) : print( va_arg( args, unsigned int ), HEX );
+                break;
+            case 'c' :
+                n += write( (uint8_t) va_arg( args, int ) );
+                break;
+            case 's' :
+                n += print( va_arg( args, const char* ) );
+                break;
+            case 'S' :
+                n += print( va_arg( args, const __FlashStringHelper* ) );
+                break;
+            case 'f' :
+                n += print( va_arg( args, double ), digits );
+                break;
+            case 'e' :
+                n += printCompact( va_arg( args, double ), digits );
+                break;
+            case '%' :
+                n += write( (uint8_t) '%' );
+                break;
+            case 0 :
+                return n;   // a stray % at the end
+            default :
+                n += write( (uint8_t) '%' ) + write( (uint8_t) ch );
+                break;
+        }
+    }
+    return n;
+}
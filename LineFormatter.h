@@ -0,0 +1,79 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+#include <CommonDefs.h>
+#include <FloatFormat.h>
+#include <stdarg.h>
+
+// the longest line composed in one piece.  Anything longer goes out in pieces this size.
+#ifndef LINE_FORMAT_SIZE
+#define LINE_FORMAT_SIZE    64
+#endif
+
+
+// LineFormatter
+//
+// LineFormatter composes a line of console output in RAM, and hands it to the output (normally
+// Serial) in a single write() when it's flushed.  That saves going down the whole Print stack for
+// each piece, and keeps the line in one piece, so a reply isn't broken up by telemetry.
+//
+// It's a Print, so print() and println() work as usual, except that floats go through FormatFixed(),
+// which is several times quicker than Print's.  Format() does a little of printf():
+//
+//   %d %i %u       int, unsigned               %ld %li %lu     long, unsigned long
+//   %x %lx         hex                         %c              char
+//   %s             string in RAM               %S              string in flash, from F()
+//   %f %.nf        double, n decimals (2)      %e %.ne         double, compact, n decimals (2)
+//   %%             %
+//
+// The format itself is a flash string, from F().  Nothing is written until Flush(), or until
+// the buffer fills, so a line should end with one.
+//
+// ConsoleLine is the one the library uses, composing for the console's TxRing, SerialTx.  PRINT_VAR,
+// PROGRESS_MSG and CSV_OUT go through it.
+class LineFormatter : public Print
+{
+    Print*          _pOutput;
+    uint8_t         _length;
+    char            _buffer[ LINE_FORMAT_SIZE ];
+
+public:
+
+    LineFormatter( Print* pOutput ) : _pOutput( pOutput ), _length( 0 ) {}
+
+    void            SetOutput( Print* pOutput )     { Flush(); _pOutput = pOutput; }
+
+    virtual size_t  write( uint8_t ch );
+    virtual size_t  write( const uint8_t* pBuf, size_t n );
+    using Print::write;
+
+    // floats, by FormatFixed()
+    using Print::print;
+    using Print::println;
+    size_t          print( double n, int digits = 2 );
+    size_t          println( double n, int digits = 2 )    { size_t length = print( n, digits ); return length + println(); }
+    size_t          println( float n, int digits = 2 )     { return println( (double) n, digits ); }
+    size_t          printCompact( double n, int digits = 2 );
+
+    size_t          Format( const __FlashStringHelper* pFormat, ... );
+    size_t          FormatV( const __FlashStringHelper* pFormat, va_list args );
+
+    // hand the line over, in one write
+    void            Flush();
+
+    uint8_t         GetLength()     { return _length; }
+};
+
+// on the host, each simulated robot has its own, in its RobotContext
+#ifdef ARDUINO
+extern LineFormatter    ConsoleLine;
+#endif
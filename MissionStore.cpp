@@ -0,0 +1,367 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#include <MissionStore.h>
+#include <WaypointManager.h>
+
+// the image is read and written through a small buffer, to keep the storage calls few and large
+#define MISSION_BLOCK   32
+
+// zigzag encoding maps signed values to unsigned, so small negative deltas stay small:
+// 0, -1, 1, -2, 2 ... become 0, 1, 2, 3, 4 ...
+static uint32_t zigzag( int32_t n )     { return ( (uint32_t) n << 1 ) ^ (uint32_t) ( n >> 31 ); }
+static int32_t  unzigzag( uint32_t n )  { return (int32_t) ( n >> 1 ) ^ -(int32_t) ( n & 1 ); }
+
+// store a varint:  7 bits per byte, low bits first, high bit set on all but the last byte
+static uint8_t putVarint( uint8_t* pBuf, uint32_t n )
+{
+    uint8_t len = 0;
+    while ( n >= 0x80 ) {
+        pBuf[ len++ ] = (uint8_t) n | 0x80;
+        n >>= 7;
+    }
+    pBuf[ len++ ] = (uint8_t) n;
+    return len;
+}
+
+
+uint16_t MissionStore::crc16( uint16_t crc, const uint8_t* pBuf, uint16_t n )
+{
+    while ( n-- ) {
+        crc ^= (uint16_t) *pBuf++ << 8;
+        for ( uint8_t bit = 0; bit < 8; bit++ ) {
+            crc = crc & 0x8000 ? ( crc << 1 ) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+
+MissionStore::eMissionStatus MissionStore::Save( WaypointManager* pWM )
+{
+    uint8_t     buf[ MISSION_BLOCK ];
+    uint8_t     nBuf = 0;
+    uint16_t    offset = MISSION_HEADER_SIZE;
+    uint16_t    count = 0;
+    uint16_t    crc = 0xFFFF;
+    int32_t     xPrev = 0, yPrev = 0;
+
+    if ( ! begin( true ) ) {
+        return eMissionIOError;
+    }
+
+    // The payload comes first, since we don't know the count or length until it's done.  That's
+    // why the checksum runs over the payload first, then the header.
+    for ( WaypointHandle h = pWM->First(); h != NO_WAYPOINT; h = pWM->Next( h ) ) {
+        Waypoint* pWaypoint = pWM->GetWaypoint( h );
+        if ( pWaypoint->_bPlanned ) {
+            continue;
+        }
+
+        // worst case is two 5-byte varints and a radius
+        if ( nBuf > MISSION_BLOCK - 11 ) {
+            if ( offset + nBuf > capacity() - 2 ) {
+                end( false );
+                return eMissionTooBig;
+            }
+            if ( ! write( offset, buf, nBuf ) ) {
+                end( false );
+                return eMissionIOError;
+            }
+            crc = crc16( crc, buf, nBuf );
+            offset += nBuf;
+            nBuf = 0;
+        }
+
+        nBuf += putVarint( &buf[ nBuf ], zigzag( pWaypoint->_x - xPrev ) );
+        nBuf += putVarint( &buf[ nBuf ], zigzag( pWaypoint->_y - yPrev ) );
+        buf[ nBuf++ ] = pWaypoint->_radius;
+
+        xPrev = pWaypoint->_x;
+        yPrev = pWaypoint->_y;
+        count++;
+    }
+
+    // the last partial block, and the header
+    if ( offset + nBuf > capacity() - 2 ) {
+        end( false );
+        return eMissionTooBig;
+    }
+    if ( nBuf && ! write( offset, buf, nBuf ) ) {
+        end( false );
+        return eMissionIOError;
+    }
+    crc = crc16( crc, buf, nBuf );
+    offset += nBuf;
+
+    uint16_t payloadLength = offset - MISSION_HEADER_SIZE;
+    buf[ 0 ] = MISSION_MAGIC_0;
+    buf[ 1 ] = MISSION_MAGIC_1;
+    buf[ 2 ] = MISSION_VERSION;
+    buf[ 3 ] = 0;
+    buf[ 4 ] = count & 0xFF;
+    buf[ 5 ] = count >> 8;
+    buf[ 6 ] = payloadLength & 0xFF;
+    buf[ 7 ] = payloadLength >> 8;
+    crc = crc16( crc, buf, MISSION_HEADER_SIZE );
+
+    buf[ 8 ] = crc & 0xFF;
+    buf[ 9 ] = crc >> 8;
+
+    if ( ! write( offset, &buf[ 8 ], 2 ) || ! write( 0, buf, MISSION_HEADER_SIZE ) ) {
+        end( false );
+        return eMissionIOError;
+    }
+
+    return end( true ) ? eMissionOK : eMissionIOError;
+}
+
+
+// Validate the image in storage, without touching the mission.
+MissionStore::eMissionStatus MissionStore::check( uint16_t& count, uint16_t& payloadLength )
+{
+    uint8_t     buf[ MISSION_BLOCK ];
+
+    if ( ! read( 0, buf, MISSION_HEADER_SIZE ) ) {
+        return eMissionIOError;
+    }
+    if ( buf[ 0 ] != MISSION_MAGIC_0 || buf[ 1 ] != MISSION_MAGIC_1 || buf[ 2 ] != MISSION_VERSION ) {
+        return eMissionBadImage;
+    }
+
+    count = buf[ 4 ] | (uint16_t) buf[ 5 ] << 8;
+    payloadLength = buf[ 6 ] | (uint16_t) buf[ 7 ] << 8;
+    if ( (uint32_t) MISSION_HEADER_SIZE + payloadLength + 2 > capacity() ) {
+        return eMissionBadImage;
+    }
+
+    // keep the header for the end of the checksum, so we can reuse buf for the payload
+    uint8_t header[ MISSION_HEADER_SIZE ];
+    memcpy( header, buf, MISSION_HEADER_SIZE );
+
+    uint16_t crc = 0xFFFF;
+    for ( uint16_t done = 0; done < payloadLength; ) {
+        uint16_t n = payloadLength - done;
+        if ( n > MISSION_BLOCK ) {
+            n = MISSION_BLOCK;
+        }
+        if ( ! read( MISSION_HEADER_SIZE + done, buf, n ) ) {
+            return eMissionIOError;
+        }
+        crc = crc16( crc, buf, n );
+        done += n;
+    }
+    crc = crc16( crc, header, MISSION_HEADER_SIZE );
+
+    if ( ! read( MISSION_HEADER_SIZE + payloadLength, buf, 2 ) ) {
+        return eMissionIOError;
+    }
+    return ( buf[ 0 ] | (uint16_t) buf[ 1 ] << 8 ) == crc ? eMissionOK : eMissionBadChecksum;
+}
+
+
+// Decode the payload, appending its Waypoints to the mission, or just counting them if pWM is NULL.
+MissionStore::eMissionStatus MissionStore::decode( WaypointManager* pWM, uint16_t payloadLength, uint16_t& decoded )
+{
+    uint8_t     buf[ MISSION_BLOCK ];
+
+    // decode a byte at a time, refilling the buffer as we go.  Varints may straddle blocks.
+    uint16_t    done = 0;
+    uint8_t     ixBuf = 0, nBuf = 0;
+    int32_t     x = 0, y = 0;
+    int32_t     field[ 2 ];
+    uint8_t     ixField = 0;
+    uint32_t    value = 0;
+    uint8_t     shift = 0;
+
+    decoded = 0;
+    while ( done < payloadLength || ixBuf < nBuf ) {
+        if ( ixBuf == nBuf ) {
+            nBuf = payloadLength - done > MISSION_BLOCK ? MISSION_BLOCK : payloadLength - done;
+            if ( ! read( MISSION_HEADER_SIZE + done, buf, nBuf ) ) {
+                return eMissionIOError;
+            }
+            done += nBuf;
+            ixBuf = 0;
+        }
+
+        uint8_t b = buf[ ixBuf++ ];
+        if ( ixField < 2 ) {
+            if ( shift > 28 ) {
+                return eMissionBadPayload;  // longer than any 32-bit varint
+            }
+            value |= (uint32_t) ( b & 0x7F ) << shift;
+            shift += 7;
+            if ( ! ( b & 0x80 ) ) {
+                field[ ixField++ ] = unzigzag( value );
+                value = 0;
+                shift = 0;
+            }
+        }
+        else {
+            // the radius completes the Waypoint
+            x += field[ 0 ];
+            y += field[ 1 ];
+            if ( pWM && pWM->AppendWaypoint( x, y, b ) == NO_WAYPOINT ) {
+                return eMissionTooBig;
+            }
+            decoded++;
+            ixField = 0;
+        }
+    }
+
+    // a payload which stops part way through a Waypoint
+    return ixField || shift ? eMissionBadPayload : eMissionOK;
+}
+
+
+MissionStore::eMissionStatus MissionStore::Load( WaypointManager* pWM )
+{
+    uint16_t    count, payloadLength, decoded;
+
+    if ( ! begin( false ) ) {
+        return eMissionIOError;
+    }
+
+    eMissionStatus status = check( count, payloadLength );
+    if ( status == eMissionOK && count > pWM->GetCapacity() ) {
+        status = eMissionTooBig;
+    }
+
+    // a dry run, so a payload which is short of Waypoints, or has too many, is turned away while
+    // the mission is still intact
+    if ( status == eMissionOK ) {
+        status = decode( NULL, payloadLength, decoded );
+    }
+    if ( status == eMissionOK && decoded != count ) {
+        status = eMissionBadPayload;
+    }
+    if ( status != eMissionOK ) {
+        end( false );
+        return status;
+    }
+
+    // the image is good, so out with the old mission.  The pool is empty and holds count, so only
+    // the storage failing between the passes can stop this;  then we don't keep half a mission.
+    pWM->Clear();
+    status = decode( pWM, payloadLength, decoded );
+    if ( status != eMissionOK ) {
+        pWM->Clear();
+    }
+
+    end( status == eMissionOK );
+    return status;
+}
+
+
+void MissionStore::PrintStatus( eMissionStatus status )
+{
+    uint8_t lane = SerialTx.GetLane();
+    if ( status != eMissionOK ) {
+        SerialTx.SetLane( eTxError );
+    }
+
+    switch ( status ) {
+        case eMissionOK :
+            SerialTx.println( F( "OK" ) );
+            break;
+        case eMissionIOError :
+            SerialTx.println( F( "storage error" ) );
+            break;
+        case eMissionBadImage :
+            SerialTx.println( F( "no mission saved" ) );
+            break;
+        case eMissionBadChecksum :
+            SerialTx.println( F( "bad checksum" ) );
+            break;
+        case eMissionBadPayload :
+            SerialTx.println( F( "waypoints don't match the header" ) );
+            break;
+        case eMissionTooBig :
+            SerialTx.println( F( "mission too big" ) );
+            break;
+    }
+    SerialTx.SetLane( lane );
+}
+
+
+#if defined( __AVR__ )
+
+bool EepromMissionStore::read( uint16_t offset, uint8_t* pBuf, uint16_t n )
+{
+    eeprom_read_block( pBuf, (const void*) ( _base + offset ), n );
+    return true;
+}
+
+
+bool EepromMissionStore::write( uint16_t offset, const uint8_t* pBuf, uint16_t n )
+{
+    // update, rather than write, so unchanged bytes don't use up the EEPROM's write cycles
+    eeprom_update_block( pBuf, (void*) ( _base + offset ), n );
+    return true;
+}
+
+#elif ! defined( ARDUINO )
+
+FileMissionStore::~FileMissionStore()
+{
+    if ( _pFile ) {
+        fclose( _pFile );
+    }
+}
+
+
+bool FileMissionStore::begin( bool bWriting )
+{
+    char path[ 256 ];
+    snprintf( path, sizeof( path ), bWriting ? "%s.tmp" : "%s", _pPath );
+
+    _bWriting = bWriting;
+    _pFile = fopen( path, bWriting ? "wb" : "rb" );
+    return _pFile != NULL;
+}
+
+
+bool FileMissionStore::end( bool bOK )
+{
+    if ( ! _pFile ) {
+        return false;
+    }
+    bOK = fclose( _pFile ) == 0 && bOK;
+    _pFile = NULL;
+
+    if ( _bWriting ) {
+        char path[ 256 ];
+        snprintf( path, sizeof( path ), "%s.tmp", _pPath );
+
+        // only replace the old image once the new one is complete
+        if ( bOK ) {
+            bOK = rename( path, _pPath ) == 0;
+        }
+        else {
+            remove( path );
+        }
+    }
+    return bOK;
+}
+
+
+bool FileMissionStore::read( uint16_t offset, uint8_t* pBuf, uint16_t n )
+{
+    return fseek( _pFile, offset, SEEK_SET ) == 0 && fread( pBuf, 1, n, _pFile ) == n;
+}
+
+
+bool FileMissionStore::write( uint16_t offset, const uint8_t* pBuf, uint16_t n )
+{
+    return fseek( _pFile, offset, SEEK_SET ) == 0 && fwrite( pBuf, 1, n, _pFile ) == n;
+}
+
+#endif
@@ -0,0 +1,142 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+#include "CommonDefs.h"
+
+#if defined( __AVR__ )
+#include <avr/eeprom.h>
+#elif ! defined( ARDUINO )
+#include <stdio.h>
+#endif
+
+class WaypointManager;
+
+// MissionStore saves and loads the WaypointManager's mission as a compact binary image, so a
+// robot can come up with its mission without having it typed (or replayed) at the console.
+//
+// The image is:
+//
+//   offset  size
+//     0      2    magic, 'W' 'P'
+//     2      1    format version (MISSION_VERSION)
+//     3      1    reserved, 0
+//     4      2    waypoint count
+//     6      2    payload length in bytes
+//     8      n    payload
+//   8+n      2    CRC-16 (CCITT) of the payload, then the header
+//
+// Multi-byte header fields are little-endian.  The payload holds each waypoint as the change in
+// x and y from the previous one (the first is relative to the origin), each zigzag-encoded as a
+// variable-length integer, followed by the radius in one byte.  Waypoints on a typical mission
+// are only a few feet apart, so most take 3 bytes, against the 6 of the in-memory Waypoint.
+//
+// Planned Waypoints are not saved, since the PathPlanner will recreate them as needed.
+//
+// Derived classes supply the storage, as raw block reads and writes.  Load() checks the image
+// first:  its checksum, and that the payload decodes to as many Waypoints as the header says, and
+// no more than the pool holds.  Only then does it replace the mission, so a bad image leaves the
+// current mission alone.
+#define MISSION_MAGIC_0     'W'
+#define MISSION_MAGIC_1     'P'
+#define MISSION_VERSION     1
+#define MISSION_HEADER_SIZE 8
+
+class MissionStore
+{
+public:
+
+    enum eMissionStatus {
+        eMissionOK,
+        eMissionIOError,        // the storage could not be read or written
+        eMissionBadImage,       // no image, or wrong magic/version
+        eMissionBadChecksum,    // image is corrupt
+        eMissionBadPayload,     // the payload doesn't hold the Waypoints the header says it does
+        eMissionTooBig,         // the image would not fit in the storage, or the mission in the pool
+    };
+
+    // write the mission to storage
+    eMissionStatus          Save( WaypointManager* pWM );
+
+    // replace the mission with the one in storage
+    eMissionStatus          Load( WaypointManager* pWM );
+
+    static void             PrintStatus( eMissionStatus status );
+
+protected:
+
+    // read or write n bytes at the given offset into the storage.  Return false on failure.
+    virtual bool            read( uint16_t offset, uint8_t* pBuf, uint16_t n ) = 0;
+    virtual bool            write( uint16_t offset, const uint8_t* pBuf, uint16_t n ) = 0;
+
+    // bracket each Save() or Load(), for storage which needs to be opened and closed.
+    // end() is told whether the operation succeeded.
+    virtual bool            begin( bool bWriting )  { return true; }
+    virtual bool            end( bool bOK )         { return bOK; }
+
+    // size of the storage, in bytes
+    virtual uint16_t        capacity() = 0;
+
+    static uint16_t         crc16( uint16_t crc, const uint8_t* pBuf, uint16_t n );
+
+    eMissionStatus          check( uint16_t& count, uint16_t& payloadLength );
+    eMissionStatus          decode( WaypointManager* pWM, uint16_t payloadLength, uint16_t& decoded );
+};
+
+
+#if defined( __AVR__ )
+
+// Mission image in the AVR's internal EEPROM, starting at the given address.  The Pro Micro has
+// 1K of EEPROM, which holds a mission of roughly 300 waypoints.
+class EepromMissionStore : public MissionStore
+{
+    uint16_t                _base;
+    uint16_t                _size;
+
+protected:
+
+    virtual bool            read( uint16_t offset, uint8_t* pBuf, uint16_t n );
+    virtual bool            write( uint16_t offset, const uint8_t* pBuf, uint16_t n );
+    virtual uint16_t        capacity()  { return _size; }
+
+public:
+
+    EepromMissionStore( uint16_t base = 0, uint16_t size = E2END + 1 ) : _base( base ), _size( size - base ) {}
+};
+
+#elif ! defined( ARDUINO )
+
+// Mission image in a file, for the host build.  The image is written to a temporary file
+// which replaces the original when complete, so a failed save doesn't destroy the previous mission.
+class FileMissionStore : public MissionStore
+{
+    const char*             _pPath;
+    FILE*                   _pFile;
+    bool                    _bWriting;
+
+protected:
+
+    virtual bool            begin( bool bWriting );
+    virtual bool            end( bool bOK );
+    virtual bool            read( uint16_t offset, uint8_t* pBuf, uint16_t n );
+    virtual bool            write( uint16_t offset, const uint8_t* pBuf, uint16_t n );
+    virtual uint16_t        capacity()  { return 0xFFFF; }
+
+public:
+
+    FileMissionStore( const char* pPath ) : _pPath( pPath ), _pFile( NULL ), _bWriting( false ) {}
+    ~FileMissionStore();
+};
+
+#endif
+
+// The Due has no EEPROM, and its flash is rewritten on every upload, so there is no store for
+// it here yet.
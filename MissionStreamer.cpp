@@ -0,0 +1,76 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#ifndef ARDUINO
+
+#include <MissionStreamer.h>
+#include <stdlib.h>
+
+MissionStreamer::MissionStreamer( FILE* pFile, uint16_t window ) :
+    _pFile( pFile ), _window( window ), _credit( 0 ), _sent( 0 ), _bOpened( false ), _bEnded( false ), _bOverrun( false )
+{
+}
+
+
+bool MissionStreamer::HandleLine( const char* pLine )
+{
+    if ( pLine[ 0 ] != '!' ) {
+        return false;
+    }
+
+    switch ( pLine[ 1 ] ) {
+        case 'C' :  // credit
+            _credit += strtoul( pLine + 2, NULL, 10 );
+            break;
+        case 'X' :  // the robot dropped one; there's no recovering the sequence, so give up
+            _bOverrun = true;
+            _bEnded = true;
+            break;
+        default :
+            return false;
+    }
+    return true;
+}
+
+
+bool MissionStreamer::NextCommand( char* pBuf, size_t size )
+{
+    if ( _bEnded ) {
+        return false;
+    }
+
+    if ( ! _bOpened ) {
+        _bOpened = true;
+        snprintf( pBuf, size, "WO %u\r", _window );
+        return true;
+    }
+
+    if ( ! _credit ) {
+        return false;
+    }
+
+    char line[ 80 ];
+    while ( fgets( line, sizeof( line ), _pFile ) ) {
+        int x, y, radius;
+        if ( line[ 0 ] == '#' || sscanf( line, "%d %d %d", &x, &y, &radius ) != 3 ) {
+            continue;
+        }
+        snprintf( pBuf, size, "WP %d %d %d\r", x, y, radius );
+        _credit--;
+        _sent++;
+        return true;
+    }
+
+    _bEnded = true;
+    snprintf( pBuf, size, "WE\r" );
+    return true;
+}
+
+#endif
@@ -0,0 +1,53 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+// MissionStreamer is the host end of WaypointManager's mission stream.  It is only built on the
+// host.
+//
+// It reads a mission file of "x y radius" lines (blank lines and lines starting with '#' are
+// skipped), and produces the commands to stream it:  WO to open, a WP per Waypoint, and WE at the
+// end.  It knows nothing about the transport.  Feed it each line received from the robot with
+// HandleLine(), and send whatever NextCommand() produces; NextCommand() only produces a WP when
+// the robot has granted credit for it.
+#ifndef ARDUINO
+
+#include <stdio.h>
+#include <stdint.h>
+
+class MissionStreamer
+{
+    FILE*       _pFile;
+    uint16_t    _window;
+    uint32_t    _credit;
+    uint32_t    _sent;
+    bool        _bOpened;
+    bool        _bEnded;
+    bool        _bOverrun;
+
+public:
+
+    // window is the number of Waypoints the robot should buffer, or 0 for its default
+    MissionStreamer( FILE* pFile, uint16_t window = 0 );
+
+    // process a line of output from the robot.  Returns true if it was a stream control line.
+    bool        HandleLine( const char* pLine );
+
+    // fill pBuf with the next command to send, including its CR.  Returns false if there is
+    // nothing to send until more credit arrives.
+    bool        NextCommand( char* pBuf, size_t size );
+
+    bool        IsDone()        { return _bEnded; }
+    bool        IsOverrun()     { return _bOverrun; }
+    uint32_t    GetSent()       { return _sent; }
+};
+
+#endif
@@ -19,69 +19,46 @@ MotorDriver::MotorDriver(
     CommandDispatcher* pCD, Position* pOD ) : 
 
                                                 Behavior( pCD ),
-                                                _pwmPinLF(pwmPinLF), 
-                                                _pwmPinRF(pwmPinRF), 
-                                                _pwmPinLR(pwmPinLR), 
-                                                _pwmPinRR(pwmPinRR),
-
-                                                _dirPinLF(dirPinLF), 
-                                                _dirPinRF(dirPinRF), 
-                                                _dirPinLR(dirPinLR), 
-                                                _dirPinRR(dirPinRR),
-
-                                                _pPosition( pOD )
+                                                _pPosition( pOD ),
+                                                _output( eSignMagnitude )
 {
     _pName = F("Motor");
-    _throttleChangeLimit = 64;  // prevent throttle from changing more than this in each step
+    _bReflex = true;    // the output stage acts on urgent ticks too
 
     SubscribeTo( pCD, 'M' );    // All our commands begin with "M"
     
-    pinMode( _pwmPinLF, OUTPUT );
-    pinMode( _pwmPinRF, OUTPUT );
-    pinMode( _pwmPinLR, OUTPUT );
-    pinMode( _pwmPinRR, OUTPUT );
-    pinMode( _dirPinLF, OUTPUT );
-    pinMode( _dirPinRF, OUTPUT );
-    pinMode( _dirPinLR, OUTPUT );
-    pinMode( _dirPinRR, OUTPUT );
+    _output.AddChannel( pwmPinLF, dirPinLF, eLeftSide );
+    _output.AddChannel( pwmPinRF, dirPinRF, eRightSide );
+    _output.AddChannel( pwmPinLR, dirPinLR, eLeftSide );
+    _output.AddChannel( pwmPinRR, dirPinRR, eRightSide );
 
     _pHelpString = F( "  S <LeftSpeed> <RightSpeed>: Set 'Motor' speeds\n"
-                       "  L <Limit>: Set throttle change limit" );
+                       "  L <Limit>: Set throttle change limit\n"
+                       "  D <Deadband>: Set smallest throttle to drive\n"
+                       "  R <0|1>: Ramp throttle changes over each interval\n"
+                       "  I <Mask>: Set inverted channels (1 LF, 2 RF, 4 LR, 8 RR)\n"
+                       "  T : Latency report\n"
+                       "  U <Source> <us>: Set latency bound (0 bump, 1 command, 2 snapshot)\n"
+                       "  Z : Clear latency statistics" );
 }
 
 
 void MotorDriver::handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams )
 {
     if ( _bEnabled ) {
-        SubsumptionParams* pSubsumptionParams = (SubsumptionParams*) pEvent->pData;
-
-        // don't allow rapid throttle changes
-        _throttleLeft = constrain( pSubsumptionParams->GetLeftThrottle(), _throttleLeft - _throttleChangeLimit, _throttleLeft + _throttleChangeLimit );
-        _throttleRight = constrain( pSubsumptionParams->GetRightThrottle(), _throttleRight - _throttleChangeLimit, _throttleRight + _throttleChangeLimit );
-
-        bool bReverseLeft = _throttleLeft < 0;
-        bool bReverseRight = _throttleRight < 0;
-
-        analogWrite( _pwmPinLF, constrain( abs(_throttleLeft), 0, 255 ) );
-        analogWrite( _pwmPinLR, constrain( abs(_throttleLeft), 0, 255 ) );
-        analogWrite( _pwmPinRF, constrain( abs(_throttleRight), 0, 255 ) );
-        analogWrite( _pwmPinRR, constrain( abs(_throttleRight), 0, 255 ) );
-
-        digitalWrite( _dirPinLF, bReverseLeft ? 1 : 0 );
-        digitalWrite( _dirPinLR, bReverseLeft ? 1 : 0 );
-        digitalWrite( _dirPinRF, bReverseRight ? 1 : 0 );
-        digitalWrite( _dirPinRR, bReverseRight ? 1 : 0 );
+        if ( pSubsumptionParams->IsUrgent() ) {
+            // a reflex:  don't wait for the ramp
+            _output.SetUrgent( pSubsumptionParams->GetLeftThrottle(), pSubsumptionParams->GetRightThrottle(), pSubsumptionParams );
+        }
+        else {
+            // ramp to the new throttles over the interval, as Update() is called
+            _output.Set( pSubsumptionParams->GetLeftThrottle(), pSubsumptionParams->GetRightThrottle(), pSubsumptionParams->GetInterval(), pSubsumptionParams );
+        }
 
         // display name of subsuming Behavior
-        if ( _messageMask & MM_INFO && pSubsumptionParams->ControlFreak() ) {
-            Serial.print( '[' );
-            Serial.print( pSubsumptionParams->ControlFreak()->GetName() );
-            Serial.print( F( "] " ) );
-            Serial.print( _throttleLeft );
-            Serial.print( '/' );
-            Serial.println( _throttleRight );
-            PRINT_VAR( bReverseLeft );
-            PRINT_VAR( bReverseRight );
+        if ( MM_ON( MM_INFO ) && pSubsumptionParams->ControlFreak() ) {
+            ConsoleLine.Format( F( "[%S] %d/%d\n" ), pSubsumptionParams->ControlFreak()->GetName(), _output.GetLeft(), _output.GetRight() );
+            ConsoleLine.Flush();
         }
     }
 }
@@ -89,36 +66,14 @@ void MotorDriver::handleSubsumptionEvent( EventNotification* pEvent, Subsumption
 
 void MotorDriver::handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs )
 {
-    CommandArgs* pData = (CommandArgs*) pEvent->pData;
-
-    // check the sub-command.
-    switch( pData->inputBuffer[1] ) {
-        case 'S' : // set "speeds"
-            if ( _bEnabled ) {
-
-                int leftSpeed = pData->nParams[0];
-                int rightSpeed = pData->nParams[1];
-
-                analogWrite( _pwmPinLF, leftSpeed < 0 ? 0 : leftSpeed );
-                analogWrite( _pwmPinRF, rightSpeed < 0 ? 0 : rightSpeed );
-                analogWrite( _pwmPinLR, leftSpeed < 0 ? -leftSpeed : 0 );
-                analogWrite( _pwmPinRR, rightSpeed < 0 ? -rightSpeed : 0 );
-
-                if ( _messageMask & MM_RESPONSES ) {
-                    Serial.print( F( "Motor speeds directly set to: " ) );
-                    Serial.print( leftSpeed ); Serial.print( '\t' );
-                    Serial.println( rightSpeed );
-                }
-            }
-            break;
+    // speeds can only be set directly while we're enabled
+    if ( pArgs->inputBuffer[1] != 'S' || _bEnabled ) {
+        _output.HandleCommand( pArgs, MM_ON( MM_RESPONSES ) );
+    }
+}
 
-        case 'L' : // set throttle limit
-            _throttleChangeLimit = pData->nParams[0];
 
-            IF_MASK( MM_RESPONSES ) {
-                Serial.print( F( "Motor throttle change limit set to " ) );
-                Serial.println( _throttleChangeLimit );
-            }
-            break;
-    }
+void MotorDriver::PrintSpecificParameterValues()
+{
+    _output.Print();
 }
@@ -13,6 +13,7 @@ Subsumption Architecture as described by David P. Anderson.
 #include <CommandDispatcher.h>
 #include <Director.h>
 #include <Position.h>
+#include <MotorOutput.h>
 
 // LEDDriver simulates motors in a simplistic way:
 // A motor is represented by two LED's, one to indicate forward motion, the other to indicate backward motion.
@@ -29,19 +30,10 @@ Subsumption Architecture as described by David P. Anderson.
 
 class MotorDriver : public Behavior
 {
-    uint8_t _pwmPinLF, _dirPinLF,
-            _pwmPinRF, _dirPinRF,
-            _pwmPinLR, _dirPinLR,
-            _pwmPinRR, _dirPinRR;
-
-
-
     Position*       _pPosition;
 
-    int             _throttleChangeLimit;
-
-    int             _throttleLeft;
-    int             _throttleRight;
+    // a channel for each of the four motors, front and rear on each side
+    MotorOutput     _output;
 
 public:
     MotorDriver( 
@@ -52,6 +44,11 @@ public:
         
         CommandDispatcher* pCD, Position* pOD);
 
+    // called from loop() as often as possible, to ramp the outputs between ticks
+    void                Update()        { _output.Update(); }
+    MotorOutput*        GetOutput()     { return &_output; }
+
     virtual void        handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs );
     virtual void        handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams );
+    virtual void        PrintSpecificParameterValues();
 };
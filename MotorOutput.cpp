@@ -0,0 +1,371 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#include <MotorOutput.h>
+
+MotorOutput::MotorOutput( eMotorOutputMode eMode ) : _eMode( eMode )
+{
+    _nChannels = 0;
+    _invertMask = 0;
+    _dirBits = 0;
+    memset( _pwm, 0, sizeof( _pwm ) );
+
+#ifdef __AVR__
+    _nDirPorts = 0;
+#endif
+
+#ifndef ARDUINO
+    _historyHead = _historyCount = 0;
+#endif
+
+    _slewLimit = 64;
+    _deadband = 0;
+    _throttleLeft = _throttleRight = 0;
+
+    _bRamp = true;
+    _fromLeft = _fromRight = 0;
+    _targetLeft = _targetRight = 0;
+    _rampStartMicros = 0;
+    _rampMicros = 0;
+}
+
+
+bool MotorOutput::AddChannel( uint8_t pwmPin, uint8_t dirPin, eMotorSide side, bool bInverted )
+{
+    if ( _nChannels == MOTOR_OUTPUT_CHANNELS ) {
+        return false;
+    }
+
+    uint8_t ch = _nChannels++;
+    _pwmPin[ ch ] = pwmPin;
+    _dirPin[ ch ] = dirPin;
+    _side[ ch ] = side;
+    if ( bInverted ) {
+        _invertMask |= 1 << ch;
+    }
+
+    pinMode( pwmPin, OUTPUT );
+    pinMode( dirPin, OUTPUT );
+
+#ifdef __AVR__
+    // find (or add) the direction pin's port
+    volatile uint8_t* pPort = portOutputRegister( digitalPinToPort( dirPin ) );
+    uint8_t ixPort = 0;
+    while ( ixPort < _nDirPorts && _pDirPort[ ixPort ] != pPort ) {
+        ixPort++;
+    }
+    if ( ixPort == _nDirPorts ) {
+        _pDirPort[ ixPort ] = pPort;
+        _dirPortMask[ ixPort ] = 0;
+        _nDirPorts++;
+    }
+    _dirPortIx[ ch ] = ixPort;
+    _dirBitMask[ ch ] = digitalPinToBitMask( dirPin );
+    _dirPortMask[ ixPort ] |= _dirBitMask[ ch ];
+#endif
+
+    // start out stopped
+    analogWrite( pwmPin, 0 );
+    digitalWrite( dirPin, LOW );
+    _pwm[ ch ] = 0;
+    _dirBits &= ~( 1 << ch );
+
+    return true;
+}
+
+
+void MotorOutput::Set( int left, int right, uint16_t rampMS, SubsumptionParams* pParams )
+{
+    // the last ramp should be finished by now, whether or not Update() got it there
+    _fromLeft = _targetLeft;
+    _fromRight = _targetRight;
+
+    // don't allow rapid throttle changes
+    left = constrain( left, -255, 255 );
+    right = constrain( right, -255, 255 );
+    _targetLeft = constrain( left, _targetLeft - _slewLimit, _targetLeft + _slewLimit );
+    _targetRight = constrain( right, _targetRight - _slewLimit, _targetRight + _slewLimit );
+
+    if ( _bRamp && rampMS && ( _targetLeft != _fromLeft || _targetRight != _fromRight ) ) {
+        _rampStartMicros = micros();
+        _rampMicros = rampMS * 1000UL;
+        writeThrottles( _fromLeft, _fromRight );
+
+        // the last target is written now, if Update() hadn't got there;  this one waits for the ramp
+        _latency.RecordHeld();
+        _latency.Hold( pParams );
+    }
+    else {
+        _rampMicros = 0;
+        writeThrottles( _targetLeft, _targetRight );
+        _latency.Hold( pParams );
+        _latency.RecordHeld();
+    }
+}
+
+
+// where an urgent throttle change can go from here in one step
+static int urgentThrottle( int from, int to, int slewLimit )
+{
+    if ( from >= 0 ? ( to >= 0 && to <= from ) : ( to <= 0 && to >= from ) ) {
+        return to;
+    }
+    return constrain( to, from - slewLimit, from + slewLimit );
+}
+
+
+void MotorOutput::SetUrgent( int left, int right, SubsumptionParams* pParams )
+{
+    // from wherever we are now, part way along the ramp or not
+    left = constrain( left, -255, 255 );
+    right = constrain( right, -255, 255 );
+    _targetLeft = urgentThrottle( _throttleLeft, left, _slewLimit );
+    _targetRight = urgentThrottle( _throttleRight, right, _slewLimit );
+    _rampMicros = 0;
+
+    writeThrottles( _targetLeft, _targetRight );
+    _latency.Hold( pParams );
+    _latency.RecordHeld();
+}
+
+
+void MotorOutput::Update()
+{
+    if ( _rampMicros == 0 ) {
+        return;
+    }
+
+    unsigned long elapsed = micros() - _rampStartMicros;
+    if ( elapsed >= _rampMicros ) {
+        _rampMicros = 0;
+        writeThrottles( _targetLeft, _targetRight );
+        _latency.RecordHeld();
+        return;
+    }
+
+    // how far along the ramp we are, in 256ths, which is finer than the PWM can show.  Only a
+    // ramp of more than 16 seconds would overflow elapsed << 8.
+    int fraction = _rampMicros < 0x1000000UL ? ( elapsed << 8 ) / _rampMicros
+                                             : min( elapsed / ( _rampMicros >> 8 ), 256UL );
+    int left = _fromLeft + (long) ( _targetLeft - _fromLeft ) * fraction / 256;
+    int right = _fromRight + (long) ( _targetRight - _fromRight ) * fraction / 256;
+    if ( left != _throttleLeft || right != _throttleRight ) {
+        writeThrottles( left, right );
+    }
+}
+
+
+void MotorOutput::Write( int left, int right )
+{
+    _targetLeft = constrain( left, -255, 255 );
+    _targetRight = constrain( right, -255, 255 );
+    _rampMicros = 0;
+
+    writeThrottles( _targetLeft, _targetRight );
+    _latency.RecordHeld();
+}
+
+
+void MotorOutput::writeThrottles( int left, int right )
+{
+    _throttleLeft = left;
+    _throttleRight = right;
+    writePins( left, right );
+}
+
+
+void MotorOutput::writePins( int left, int right )
+{
+    uint8_t dirBits = 0;
+
+    for ( uint8_t ch = 0; ch < _nChannels; ch++ ) {
+        int throttle = constrain( _side[ ch ] == eLeftSide ? left : right, -255, 255 );
+        if ( abs( throttle ) < _deadband ) {
+            throttle = 0;
+        }
+        if ( _invertMask & ( 1 << ch ) ) {
+            throttle = -throttle;
+        }
+
+        bool bReverse = throttle < 0;
+        uint8_t pwm = abs( throttle );
+        if ( bReverse ) {
+            dirBits |= 1 << ch;
+            if ( _eMode == eBipolarLed ) {
+                // the direction pin is high, so the LED is lit while the PWM output is low
+                pwm = 255 - pwm;
+            }
+        }
+
+        if ( pwm != _pwm[ ch ] ) {
+            analogWrite( _pwmPin[ ch ], pwm );
+            _pwm[ ch ] = pwm;
+        }
+    }
+
+    if ( dirBits != _dirBits ) {
+        writeDirections( dirBits );
+        _dirBits = dirBits;
+    }
+
+#ifndef ARDUINO
+    MotorOutputRecord& record = _history[ ( _historyHead + _historyCount ) % MOTOR_OUTPUT_HISTORY ];
+    if ( _historyCount < MOTOR_OUTPUT_HISTORY ) {
+        _historyCount++;
+    }
+    else {
+        _historyHead = ( _historyHead + 1 ) % MOTOR_OUTPUT_HISTORY;
+    }
+    record.us = micros();
+    record.left = left;
+    record.right = right;
+    memcpy( record.pwm, _pwm, sizeof( record.pwm ) );
+    record.dirBits = dirBits;
+#endif
+}
+
+
+void MotorOutput::writeDirections( uint8_t dirBits )
+{
+#ifdef __AVR__
+    for ( uint8_t ixPort = 0; ixPort < _nDirPorts; ixPort++ ) {
+        uint8_t set = 0;
+        for ( uint8_t ch = 0; ch < _nChannels; ch++ ) {
+            if ( _dirPortIx[ ch ] == ixPort && ( dirBits & ( 1 << ch ) ) ) {
+                set |= _dirBitMask[ ch ];
+            }
+        }
+
+        // an interrupt handler may write other pins on this port, so don't let it in between
+        volatile uint8_t* pPort = _pDirPort[ ixPort ];
+        uint8_t oldSREG = SREG;
+        cli();
+        *pPort = ( *pPort & ~_dirPortMask[ ixPort ] ) | set;
+        SREG = oldSREG;
+    }
+#else
+    for ( uint8_t ch = 0; ch < _nChannels; ch++ ) {
+        if ( ( dirBits ^ _dirBits ) & ( 1 << ch ) ) {
+            digitalWrite( _dirPin[ ch ], dirBits & ( 1 << ch ) ? HIGH : LOW );
+        }
+    }
+#endif
+}
+
+
+bool MotorOutput::HandleCommand( CommandArgs* pArgs, bool bRespond )
+{
+    switch( pArgs->inputBuffer[1] ) {
+        case 'S' : // set speeds directly
+            Write( pArgs->nParams[ 0 ], pArgs->nParams[ 1 ] );
+            if ( bRespond ) {
+                SerialTx.print( F( "Speeds directly set to: " ) );
+                SerialTx.print( _throttleLeft ); SerialTx.print( '\t' );
+                SerialTx.println( _throttleRight );
+            }
+            break;
+
+        case 'L' : // slew limit
+            SetSlewLimit( pArgs->nParams[ 0 ] );
+            if ( bRespond ) {
+                SerialTx.print( F( "Throttle change limit set to " ) );
+                SerialTx.println( _slewLimit );
+            }
+            break;
+
+        case 'D' : // deadband
+            SetDeadband( constrain( pArgs->nParams[ 0 ], 0, 255 ) );
+            if ( bRespond ) {
+                SerialTx.print( F( "Deadband set to " ) );
+                SerialTx.println( _deadband );
+            }
+            break;
+
+        case 'R' : // ramping
+            SetRamp( pArgs->nParams[ 0 ] );
+            if ( bRespond ) {
+                SerialTx.println( _bRamp ? F( "Ramping on" ) : F( "Ramping off" ) );
+            }
+            break;
+
+        case 'T' : // latency report
+            _latency.Print();
+            SerialTx.println( _latency.WithinBounds() ? F( "Latency within bounds" ) : F( "Latency OVER bounds" ) );
+            break;
+
+        case 'U' : // latency bound
+            if ( pArgs->nParams[ 0 ] >= 0 && pArgs->nParams[ 0 ] < eLatencySources ) {
+                _latency.SetBound( pArgs->nParams[ 0 ], max( pArgs->fParams[ 1 ], 0.0 ) );
+                if ( bRespond ) {
+                    SerialTx.print( F( "Latency bound (us) set to " ) );
+                    SerialTx.println( _latency.GetBound( pArgs->nParams[ 0 ] ) );
+                }
+            }
+            break;
+
+        case 'Z' : // clear latency statistics
+            _latency.Clear();
+            if ( bRespond ) {
+                SerialTx.println( F( "Latency statistics cleared" ) );
+            }
+            break;
+
+        case 'I' : // inverted channels
+            SetInvertMask( pArgs->nParams[ 0 ] );
+            if ( bRespond ) {
+                SerialTx.print( F( "Inverted channels set to 0x" ) );
+                SerialTx.println( _invertMask, HEX );
+            }
+            break;
+
+        default :
+            return false;
+    }
+    return true;
+}
+
+
+void MotorOutput::Print()
+{
+    SerialTx.print( F( " Throttle left/right: " ) );
+    SerialTx.print( _throttleLeft ); SerialTx.print( '/' );
+    SerialTx.println( _throttleRight );
+
+    SerialTx.print( F( " Target left/right: " ) );
+    SerialTx.print( _targetLeft ); SerialTx.print( '/' );
+    SerialTx.println( _targetRight );
+
+    SerialTx.print( F( " Change limit/deadband: " ) );
+    SerialTx.print( _slewLimit ); SerialTx.print( '/' );
+    SerialTx.println( _deadband );
+
+    SerialTx.print( F( " Ramping: " ) );
+    SerialTx.println( _bRamp ? F( "on" ) : F( "off" ) );
+
+    SerialTx.print( F( " Channels (pwm/dir pins, side, output):" ) );
+    for ( uint8_t ch = 0; ch < _nChannels; ch++ ) {
+        SerialTx.print( F( "\n  " ) );
+        SerialTx.print( _pwmPin[ ch ] ); SerialTx.print( '/' );
+        SerialTx.print( _dirPin[ ch ] ); SerialTx.print( '\t' );
+        SerialTx.print( _side[ ch ] == eLeftSide ? 'L' : 'R' );
+        SerialTx.print( _invertMask & ( 1 << ch ) ? F( " inverted\t" ) : F( "\t\t" ) );
+        SerialTx.print( _pwm[ ch ] );
+        SerialTx.print( _dirBits & ( 1 << ch ) ? F( " reverse" ) : F( " forward" ) );
+    }
+    SerialTx.println();
+}
+
+
+#ifndef ARDUINO
+const MotorOutputRecord& MotorOutput::GetRecord( uint16_t ix )
+{
+    return _history[ ( _historyHead + ix ) % MOTOR_OUTPUT_HISTORY ];
+}
+#endif
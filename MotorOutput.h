@@ -0,0 +1,173 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+#include <CommonDefs.h>
+#include <CommandDispatcher.h>
+#include <Latency.h>
+
+// enough for a motor at each corner
+#define MOTOR_OUTPUT_CHANNELS   4
+
+// how many writes the host build keeps for inspection
+#ifndef MOTOR_OUTPUT_HISTORY
+#define MOTOR_OUTPUT_HISTORY    256
+#endif
+
+enum eMotorSide { eLeftSide, eRightSide };
+
+enum eMotorOutputMode
+{
+    eSignMagnitude,     // PWM is the speed, and the direction pin is high for reverse, as for an H-bridge
+    eBipolarLed         // LED pairs between the PWM and direction pins, so PWM is inverted in reverse
+};
+
+
+#ifndef ARDUINO
+// what was written to the pins, for host programs to check
+struct MotorOutputRecord
+{
+    unsigned long   us;         // micros() when it was written
+    int16_t         left;
+    int16_t         right;
+    uint8_t         pwm[ MOTOR_OUTPUT_CHANNELS ];
+    uint8_t         dirBits;    // bit n is channel n's direction pin
+};
+#endif
+
+
+// MotorOutput
+//
+// MotorOutput is the output stage shared by MotorDriver and LEDDriver.  It takes the left and right
+// throttles from the end of the Subsumption chain, and turns them into PWM and direction pin
+// writes for one or more motor channels on each side.
+//
+// On the way, it applies, in this order:
+//
+//  * the slew limit:  the throttle changes by no more than this much per Set().
+//  * the deadband:  throttles smaller than this are written as 0, rather than as a PWM too small
+//    to turn the motor.
+//  * inversion:  a channel may be marked as inverted, for a motor which is wired (or mounted)
+//    backward.
+//
+// Set() is called once per Director tick.  With ramping on, rather than jumping to the new
+// throttle, the output moves there in a straight line over the tick, as Update() is called from
+// loop().  Each ramp starts from the previous tick's target, so the outputs follow the same path
+// however often (or seldom) Update() gets called, and where it's not called at all, the output
+// simply steps from target to target a tick late.
+//
+// The direction pins' ports and bit masks are worked out when the channels are added.  On the AVR
+// all the direction pins on a port are then written at once, with a single read-modify-write of
+// the port, rather than a digitalWrite() per pin.  PWM is only written when it changes.
+//
+// On the host, there are no pins.  The last MOTOR_OUTPUT_HISTORY writes are kept instead, so host
+// programs can check exactly what the motors were told (Examples/MotorOutputCheck does).
+//
+// As the end of the line, the output stage also keeps the latency statistics:  how long from each
+// stimulus to the pins showing the response.  The drivers pass each tick's SubsumptionParams in,
+// and its stamps are recorded once its target is written:  straight away on an urgent tick, and
+// otherwise at the end of the ramp.
+class MotorOutput
+{
+    eMotorOutputMode    _eMode;
+
+    uint8_t             _nChannels;
+    uint8_t             _pwmPin[ MOTOR_OUTPUT_CHANNELS ];
+    uint8_t             _dirPin[ MOTOR_OUTPUT_CHANNELS ];
+    eMotorSide          _side[ MOTOR_OUTPUT_CHANNELS ];
+    uint8_t             _invertMask;                        // bit n set if channel n is inverted
+
+    uint8_t             _pwm[ MOTOR_OUTPUT_CHANNELS ];      // last values written
+    uint8_t             _dirBits;
+
+#ifdef __AVR__
+    // the distinct ports our direction pins are on, and which of their bits are ours
+    uint8_t             _nDirPorts;
+    volatile uint8_t*   _pDirPort[ MOTOR_OUTPUT_CHANNELS ];
+    uint8_t             _dirPortMask[ MOTOR_OUTPUT_CHANNELS ];
+    uint8_t             _dirPortIx[ MOTOR_OUTPUT_CHANNELS ];   // per channel, index into the above
+    uint8_t             _dirBitMask[ MOTOR_OUTPUT_CHANNELS ];  // per channel, its bit on that port
+#endif
+
+#ifndef ARDUINO
+    MotorOutputRecord   _history[ MOTOR_OUTPUT_HISTORY ];
+    uint16_t            _historyHead;
+    uint16_t            _historyCount;
+#endif
+
+    int                 _slewLimit;
+    uint8_t             _deadband;
+
+    LatencyStats        _latency;
+
+    int                 _throttleLeft;      // what's being written now
+    int                 _throttleRight;
+
+    // ramping from one tick's target to the next
+    bool                _bRamp;
+    int                 _fromLeft;
+    int                 _fromRight;
+    int                 _targetLeft;        // after slew limiting
+    int                 _targetRight;
+    unsigned long       _rampStartMicros;
+    unsigned long       _rampMicros;        // 0 when there's no ramp in progress
+
+    void                writeThrottles( int left, int right );
+    void                writePins( int left, int right );
+    void                writeDirections( uint8_t dirBits );
+
+public:
+
+    MotorOutput( eMotorOutputMode eMode );
+
+    // add a motor channel, returning false if there's no room.  Sets the pin modes.
+    bool                AddChannel( uint8_t pwmPin, uint8_t dirPin, eMotorSide side, bool bInverted = false );
+
+    // apply the slew limit, deadband and inversion, and write the pins.  With ramping on, the
+    // output gets to the new throttles over rampMS.  pParams' latency stamps are recorded when
+    // it does.
+    void                Set( int left, int right, uint16_t rampMS = 0, SubsumptionParams* pParams = NULL );
+
+    // for an urgent tick:  throttles coming down toward zero are written at once, without the ramp
+    // or the slew limit, so a reflex stop isn't held up.  Anything else is slew limited as usual.
+    void                SetUrgent( int left, int right, SubsumptionParams* pParams = NULL );
+
+    // move along the ramp.  Call this from loop(), as often as possible.
+    void                Update();
+
+    // write the pins straight away, without slew limiting
+    void                Write( int left, int right );
+
+    void                SetSlewLimit( int limit )       { _slewLimit = max( limit, 1 ); }
+    void                SetDeadband( uint8_t deadband ) { _deadband = deadband; }
+    void                SetInvertMask( uint8_t mask )   { _invertMask = mask; }
+    void                SetRamp( bool bRamp )           { _bRamp = bRamp; }
+
+    int                 GetSlewLimit()      { return _slewLimit; }
+    int                 GetLeft()           { return _throttleLeft; }
+    int                 GetRight()          { return _throttleRight; }
+    int                 GetTargetLeft()     { return _targetLeft; }
+    int                 GetTargetRight()    { return _targetRight; }
+    bool                IsRamping()         { return _rampMicros != 0; }
+    uint8_t             GetPwm( uint8_t ch )        { return _pwm[ ch ]; }
+    bool                GetReverse( uint8_t ch )    { return _dirBits & ( 1 << ch ); }
+    LatencyStats*       GetLatency()                { return &_latency; }
+
+    // handle the output stage subcommands (S, L, D, I, R, T, U, Z) for a driver, returning false for any others
+    bool                HandleCommand( CommandArgs* pArgs, bool bRespond );
+    void                Print();
+
+#ifndef ARDUINO
+    uint16_t                    GetRecordCount()    { return _historyCount; }
+    const MotorOutputRecord&    GetRecord( uint16_t ix );   // 0 is the oldest
+    void                        ClearRecords()      { _historyHead = _historyCount = 0; }
+#endif
+};
@@ -25,10 +25,17 @@ Navigator::Navigator( CommandDispatcher* pCD, Position* pOd, WaypointManager* pW
 
     // get our initial waypoint
     _waypointNumber = 0;
-    _pCurrentWaypoint = _pWaypointManager->GetWaypoint( _waypointNumber );
+    _hCurrentWaypoint = _pWaypointManager->First();
+    _pWaypointManager->TrackHandle( &_hCurrentWaypoint );
+
+    _distanceToGo = 0.0;
 
     _eState = eNormal;
     _bCorrecting = false;
+    _bSubsumed = false;
+    _leftMotorSpeed = _rightMotorSpeed = 0;
+    _leftThrottleSnapshot = _rightThrottleSnapshot = 0;
+    _turnRadius = 0;
 //    _bAtDestination = false;
 
     _headingTolerance = 2.0 * PI / 180;   // 5, in radians
@@ -40,9 +47,10 @@ Navigator::Navigator( CommandDispatcher* pCD, Position* pOd, WaypointManager* pW
 
 void Navigator::handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams )
 {
-    float   headingToWaypoint;
-    float   headingError;
-    int     distanceToWaypoint;
+    float   headingToWaypoint = _pPosition->_theta;   // current heading in radians, in case we don't have a waypoint
+    float   headingError = 0.0;                     // and the CSV's values when there's no course to plot
+    int     distanceToWaypoint = 0;     // straight-line, for the CSV
+    float   alongLeg = 0.0;             // what's left of the leg, measured along it
 
     if ( _bEnabled ) {
 
@@ -51,27 +59,48 @@ void Navigator::handleSubsumptionEvent( EventNotification* pEvent, SubsumptionPa
         if ( ! pSubsumptionParams->ControlFreak() ) {
             // adjust the motors' speeds as necessary to correct our heading
 
-            headingToWaypoint = _pPosition->_theta;   // current heading in radians, in case we don't have a waypoint
+            // if a higher priority (e.g. CollisionRecovery) has been driving, we may now be nearer
+            // to some other part of the path than to the leg we were on
+            if ( _bSubsumed ) {
+                _bSubsumed = false;
+                Leg* pLeg = _pWaypointManager->GetLeg( _hCurrentWaypoint );
+                if ( pLeg ) {
+                    rejoin( pLeg->GetStart() );
+                }
+            }
                     
-            if ( _pCurrentWaypoint ) {
-                // compute distance to target
-                float dx = _pCurrentWaypoint->_x - _pPosition->_xInches;
-                float dy = _pCurrentWaypoint->_y - _pPosition->_yInches;
-                distanceToWaypoint = sqrt( dx * dx + dy * dy );    // thank you, Mr. Pythagoras
+            Waypoint* pCurrentWaypoint = _pWaypointManager->GetWaypoint( _hCurrentWaypoint );
+
+            if ( pCurrentWaypoint ) {
+                // compute vector to target
+                float dx = pCurrentWaypoint->_x - _pPosition->_xInches;
+                float dy = pCurrentWaypoint->_y - _pPosition->_yInches;
+                float radius = pCurrentWaypoint->_radius;
+
+                // the leg geometry is cached by WaypointManager, so all we need here is a projection
+                // of our offset onto the leg to find how far along it we still have to go.
+                Leg* pLeg = _pWaypointManager->GetLeg( _hCurrentWaypoint );
+                alongLeg = dx * pLeg->GetUx() + dy * pLeg->GetUy();
+                _distanceToGo = _pWaypointManager->GetDistanceToGo( _hCurrentWaypoint, alongLeg );
+                IF_CSV( MM_CSVBASIC ) {
+                    distanceToWaypoint = sqrt( dx * dx + dy * dy );    // thank you, Mr. Pythagoras
+                }
                       
-                // If we're close enough to this waypoint, move to the next
-                if ( distanceToWaypoint < _pCurrentWaypoint->_radius ) {
-                    _pCurrentWaypoint = _pWaypointManager->GetWaypoint( ++_waypointNumber );
+                // If we're close enough to this waypoint, move to the next.  Comparing squares saves us the sqrt().
+                if ( dx * dx + dy * dy < radius * radius ) {
+                    _hCurrentWaypoint = _pWaypointManager->Advance( _hCurrentWaypoint );
+                    _waypointNumber++;
                     _bCorrecting = false;
                     PROGRESS_MSG( "\nNext Waypoint\n" );
                     
-                    if ( !_pCurrentWaypoint ) {
+                    if ( _hCurrentWaypoint == NO_WAYPOINT && ! _pWaypointManager->IsStreaming() ) {
 
                         // no further waypoints, so shut down and take control
                         PROGRESS_MSG( "\nWe have arrived!\n" );
 
                         pSubsumptionParams->SetThrottles( 0, 0, this);
                         _waypointNumber = 0;
+                        _distanceToGo = 0.0;
                     }
 
                 }
@@ -93,12 +122,18 @@ void Navigator::handleSubsumptionEvent( EventNotification* pEvent, SubsumptionPa
                     IF_MASK( MM_CALC ) {
                         PRINT_VAR( headingError );
                     }
-                    // normalize the error value
-                    float piOffset = headingError < 0.0 ? -PI : PI;
-                    headingError = fmod( headingError + piOffset, 2.0 * PI ) - PI;
+                    // normalize the error value to -PI .. PI.  fmod() keeps the sign of the
+                    // dividend, so this leaves us within 2 * PI either way.
+                    headingError = fmod( headingError, 2.0 * PI );
+                    if ( headingError > PI ) {
+                        headingError -= 2.0 * PI;
+                    }
+                    else if ( headingError < -PI ) {
+                        headingError += 2.0 * PI;
+                    }
 //                    headingError = atan( tan( headingError ) );
                     IF_MASK( MM_CALC ) {
-                        Serial.print( F("Adjusted ") );
+                        SerialTx.print( F("Adjusted ") );
                         PRINT_VAR( headingError );
                     }
 
@@ -140,6 +175,10 @@ void Navigator::handleSubsumptionEvent( EventNotification* pEvent, SubsumptionPa
                     }
                 }
             }
+            else if ( _pWaypointManager->IsStreaming() ) {
+                // we've caught up with the mission stream, so wait for more waypoints
+                pSubsumptionParams->SetThrottles( 0, 0, this);
+            }
             else {
                 // no waypoints, so shut down and take control
 
@@ -151,24 +190,29 @@ void Navigator::handleSubsumptionEvent( EventNotification* pEvent, SubsumptionPa
         }
         else { // subsumed
             _bCorrecting = false;
+            _bSubsumed = true;
         }
     }
 
     IF_CSV( MM_CSVBASIC ) {
         CSV_OUT( _waypointNumber );
 #ifdef USE_CSV
-        if ( _pCurrentWaypoint || ( pSubsumptionParams->PrintingCsvHeadings() ) ) {
-            CSV_OUT( _pCurrentWaypoint->_x );
-            CSV_OUT( _pCurrentWaypoint->_y );
+        Waypoint* pCurrentWaypoint = _pWaypointManager->GetWaypoint( _hCurrentWaypoint );
+        if ( pCurrentWaypoint || ( pSubsumptionParams->PrintingCsvHeadings() ) ) {
+            CSV_OUT( pCurrentWaypoint->_x );
+            CSV_OUT( pCurrentWaypoint->_y );
         }
-        else {  // hard-code dummy output if no waypoint*
-            Serial.print( F( "-1\t-1\t" ) );
+        else {  // hard-code dummy output if no waypoint*, into the row like the rest
+            ConsoleLine.print( -1 ); ConsoleLine.print( pSubsumptionParams->GetCsvDelimiter() );
+            ConsoleLine.print( -1 ); ConsoleLine.print( pSubsumptionParams->GetCsvDelimiter() );
         }
 #endif
         CSV_OUT( distanceToWaypoint );
+        CSV_OUT( _distanceToGo );
         CSV_OUT( headingToWaypoint );
         CSV_OUT( headingError );
         CSV_OUT( _headingTolerance );
+        CSV_OUT( alongLeg );
     }
 }
 
@@ -189,28 +233,70 @@ void Navigator::handleCommandEvent( EventNotification* pEvent, CommandArgs* pArg
             break; }
         case 'R' : // restart
             _waypointNumber = 0;
-            _pCurrentWaypoint = _pWaypointManager->GetWaypoint( _waypointNumber );
-            if ( _messageMask & MM_RESPONSES ) {
-                Serial.println( F( "Navigator restarting at first waypoint." ) );
+            _hCurrentWaypoint = _pWaypointManager->First();
+            rejoin( 0.0 );
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.println( F( "Navigator restarting at first waypoint." ) );
                 _waypointNumber = 0;
             }
             break;
         case 'T' : // set heading tolerance (dead-band) in degrees
-            _headingTolerance = pArgs->fParams[ 0 ];
-            if ( _messageMask & MM_RESPONSES ) {
-                Serial.print( F( "Navigator heading tolerance set to (degrees): " ) );
-                Serial.println( _headingTolerance );
+            _headingTolerance = pArgs->fParams[ 0 ] * DEG_TO_RAD;
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Navigator heading tolerance set to (degrees): " ) );
+                SerialTx.println( _headingTolerance * RAD_TO_DEG );
             }
             break;
     }
 }
 
+void Navigator::rejoin( float minStart )
+{
+    float distance;
+    WaypointHandle h = _pWaypointManager->NearestLeg( _pPosition->_xInches, _pPosition->_yInches, minStart, &distance );
+
+    if ( h != NO_WAYPOINT && h != _hCurrentWaypoint ) {
+        _hCurrentWaypoint = h;
+        _bCorrecting = false;
+        IF_MASK( MM_PROGRESS ) {
+            SerialTx.print( F( "Rejoining path, distance: " ) );
+            SerialTx.println( distance );
+        }
+    }
+}
+
+
+// from where we are now, by way of the current Waypoint, rather than as of the last tick, which
+// may have been before there was a mission, or before the one we have was changed
+float Navigator::getDistanceToGo()
+{
+    Waypoint* pWaypoint = _pWaypointManager->GetWaypoint( _hCurrentWaypoint );
+    if ( ! pWaypoint ) {
+        return 0.0;
+    }
+
+    Leg* pLeg = _pWaypointManager->GetLeg( _hCurrentWaypoint );
+    float alongLeg = ( pWaypoint->_x - _pPosition->_xInches ) * pLeg->GetUx() + ( pWaypoint->_y - _pPosition->_yInches ) * pLeg->GetUy();
+    return _pWaypointManager->GetDistanceToGo( _hCurrentWaypoint, alongLeg );
+}
+
+
 void Navigator::PrintSpecificParameterValues()
 {
-    Serial.print( F( " Current Waypoint: " ) );
-    Serial.println( _waypointNumber );
+    SerialTx.print( F( " Current Waypoint: " ) );
+    SerialTx.println( _waypointNumber );
+
+    float pathLength = _pWaypointManager->GetPathLength();
+    float distanceToGo = getDistanceToGo();
+    SerialTx.print( F( " Distance to go (inches): " ) );
+    SerialTx.print( distanceToGo );
+    SerialTx.print( F( " of " ) );
+    SerialTx.println( pathLength );
+
+    SerialTx.print( F( " Mission progress (%): " ) );
+    SerialTx.println( pathLength > 0.0 ? 100.0 * ( 1.0 - distanceToGo / pathLength ) : 0.0 );
 
-    Serial.print( F( " Heading tolerance: " ) );
-    Serial.println( _headingTolerance );
+    SerialTx.print( F( " Heading tolerance (degrees): " ) );
+    SerialTx.println( _headingTolerance * RAD_TO_DEG );
 
 }
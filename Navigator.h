@@ -43,8 +43,11 @@ class Navigator : public Behavior
     Position*           _pPosition;
     WaypointManager*    _pWaypointManager;
 
-    Waypoint*           _pCurrentWaypoint;
-    int                 _waypointNumber;
+    // WaypointManager keeps this handle valid if our Waypoint is deleted out from under us
+    WaypointHandle      _hCurrentWaypoint;
+    int                 _waypointNumber;    // number of Waypoints reached so far
+
+    float               _distanceToGo;      // path distance remaining as of the last tick, in inches
 
     int                 _leftMotorSpeed;
     int                 _rightMotorSpeed;
@@ -59,8 +62,15 @@ class Navigator : public Behavior
     float               _brakingFactor;
 
     bool                _bCorrecting;
+    bool                _bSubsumed;         // someone else had control last tick
 //    bool                _bAtDestination;
 
+    // head for the nearest leg at or after the current one, if we've been knocked off course
+    void                rejoin( float minStart );
+
+    // path distance remaining from where we are now, in inches
+    float               getDistanceToGo();
+
     float fmap (float value, float fromMin, float fromMax, float toMin, float toMax) { return ( value - fromMin ) * ( toMax - toMin ) / ( fromMax - fromMin ) + toMin; }
 
 public:
@@ -69,4 +79,10 @@ public:
     virtual void    handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs );
     virtual void    handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams );
     virtual void    PrintSpecificParameterValues();
+
+    // handle of the Waypoint we are heading for, or NO_WAYPOINT if we have none
+    WaypointHandle  GetCurrentWaypoint()    { return _hCurrentWaypoint; }
+
+    // redirect to another Waypoint, e.g. one the PathPlanner has inserted ahead of the current one
+    void            SetCurrentWaypoint( WaypointHandle h )  { _hCurrentWaypoint = h; }
 };
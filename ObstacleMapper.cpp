@@ -0,0 +1,159 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#include <ObstacleMapper.h>
+
+ObstacleMapper::ObstacleMapper( CommandDispatcher* pCD, Position* pPos, CollisionRecovery* pBumper, OccupancyGrid* pGrid ) :
+    Behavior( pCD ),
+    _pPosition( pPos ),
+    _pBumper( pBumper ),
+    _pGrid( pGrid )
+{
+    _pName = F("Obstacle Map");
+    _pHelpString = F(  "  B <inches> <degrees> : Set bumper distance and angle\n"
+                        "  A <inches> : Set look-ahead distance\n"
+                        "  D <ticks> : Set ticks per decay pass (0 = never forget)\n"
+                        "  M : Print map\n"
+                        "  X : Clear map"
+                        );
+
+    SubscribeTo( pCD, 'O' );
+
+    _bBumpedLeft = false;
+    _bBumpedRight = false;
+
+    _bumperInches = 5.0;
+    _bumperAngle = 30.0 * PI / 180;
+    _lookaheadInches = 12.0;
+
+    _decayTicks = MAPPER_DECAY_TICKS;
+    _decayCredit = 0;
+
+    _nMarked = 0;
+}
+
+
+void ObstacleMapper::handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams )
+{
+    bool bBumpedLeft = _pBumper->IsBumpedLeft();
+    bool bBumpedRight = _pBumper->IsBumpedRight();
+
+    if ( _bEnabled ) {
+        // only mark on a new bump, not for every tick of the recovery sequence
+        if ( ( bBumpedLeft && ! _bBumpedLeft ) || ( bBumpedRight && ! _bBumpedRight ) ) {
+            markAt( bBumpedLeft == bBumpedRight ? 0.0 : ( bBumpedLeft ? -_bumperAngle : _bumperAngle ) );
+        }
+
+        // decay enough rows this tick to keep pace with one pass every _decayTicks
+        if ( _decayTicks ) {
+            _decayCredit += GRID_ROWS;
+            _pGrid->Decay( _decayCredit / _decayTicks );
+            _decayCredit %= _decayTicks;
+        }
+    }
+
+    _bBumpedLeft = bBumpedLeft;
+    _bBumpedRight = bBumpedRight;
+
+    IF_CSV( MM_CSVBASIC ) {
+        CSV_OUT( _nMarked );
+        CSV_OUT( IsPathAheadBlocked() );
+    }
+}
+
+
+// mark the cell at the bumper, angleOffset radians from our heading (negative is left)
+void ObstacleMapper::markAt( float angleOffset )
+{
+    int col, row;
+    float angle = _pPosition->_theta + angleOffset;
+    float x = _pPosition->_xInches + _bumperInches * sin( angle );
+    float y = _pPosition->_yInches + _bumperInches * cos( angle );
+
+    if ( _pGrid->WorldToCell( x, y, col, row ) ) {
+        _pGrid->SetBlocked( col, row, true );
+        _nMarked++;
+
+        IF_MASK( MM_PROGRESS ) {
+            SerialTx.print( F( "Obstacle mapped at cell " ) );
+            SerialTx.print( col ); SerialTx.print( ',' );
+            SerialTx.println( row );
+        }
+    }
+}
+
+
+void ObstacleMapper::handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs )
+{
+    switch( pArgs->inputBuffer[1] ) {
+        case 'B' : // bumper geometry
+            _bumperInches = pArgs->fParams[ 0 ];
+            _bumperAngle = pArgs->fParams[ 1 ] * PI / 180;
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Bumper distance/angle set to " ) );
+                SerialTx.print( _bumperInches ); SerialTx.print( '/' );
+                SerialTx.println( pArgs->fParams[ 1 ] );
+            }
+            break;
+
+        case 'A' : // look-ahead distance
+            _lookaheadInches = pArgs->fParams[ 0 ];
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Look-ahead set to " ) );
+                SerialTx.println( _lookaheadInches );
+            }
+            break;
+
+        case 'D' : // decay rate
+            _decayTicks = pArgs->nParams[ 0 ];
+            _decayCredit = 0;
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.print( F( "Ticks per decay pass set to " ) );
+                SerialTx.println( _decayTicks );
+            }
+            break;
+
+        case 'M' : // print the map
+            _pGrid->Print();
+            break;
+
+        case 'X' : // clear the map
+            _pGrid->Clear();
+            _nMarked = 0;
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.println( F( "Map cleared." ) );
+            }
+            break;
+    }
+}
+
+
+void ObstacleMapper::PrintSpecificParameterValues()
+{
+    SerialTx.print( F( " Map RAM (bytes): " ) );
+    SerialTx.print( _pGrid->Footprint() );
+    SerialTx.print( F( ", mapper: " ) );
+    SerialTx.println( sizeof( *this ) );
+
+    SerialTx.print( F( " Obstacles marked: " ) );
+    SerialTx.println( _nMarked );
+
+    SerialTx.print( F( " Bumper distance/angle: " ) );
+    SerialTx.print( _bumperInches ); SerialTx.print( '/' );
+    SerialTx.println( _bumperAngle * 180 / PI );
+
+    SerialTx.print( F( " Look-ahead (inches): " ) );
+    SerialTx.print( _lookaheadInches );
+    SerialTx.print( IsPathAheadBlocked() ? F( ", path ahead blocked" ) : F( ", path ahead clear" ) );
+    SerialTx.println();
+
+    SerialTx.print( F( " Ticks per decay pass: " ) );
+    SerialTx.println( _decayTicks );
+}
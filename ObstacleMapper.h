@@ -0,0 +1,70 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+#include <CommandDispatcher.h>
+#include <Director.h>
+#include <Position.h>
+#include <CollisionRecovery.h>
+#include <OccupancyGrid.h>
+
+// ticks per decay pass, by default.  A mark lasts GRID_LEVEL_MAX - 1 to GRID_LEVEL_MAX passes:  at
+// 50 ms ticks, two to three minutes, which is a few laps of the example square (about 46 s each).
+#ifndef MAPPER_DECAY_TICKS
+#define MAPPER_DECAY_TICKS      1200
+#endif
+
+// ObstacleMapper
+//
+// The ObstacleMapper remembers where we have bumped into things, so the PathPlanner can route
+// around them the next time.  When CollisionRecovery reports a new bump, the mapper marks the
+// OccupancyGrid cell just ahead of the bumper which was hit:  ahead and to the left for a left bump,
+// ahead and to the right for a right bump, or straight ahead if both were hit.
+//
+// Marks fade over time.  Each tick, the mapper decays a slice of the grid, so that a complete pass
+// over the grid takes a configurable number of ticks.  A fresh mark lasts GRID_LEVEL_MAX passes.
+// Obstacles which are still there will be bumped (and marked) again; those which have moved away
+// are eventually forgotten.  The default pass is long enough for a mark to be there on the next
+// lap of a mission, which is when the PathPlanner needs it.
+//
+// The mapper never subsumes.  It should follow Position in the chain, so the pose is current.
+class ObstacleMapper : public Behavior
+{
+    Position*           _pPosition;
+    CollisionRecovery*  _pBumper;
+    OccupancyGrid*      _pGrid;
+
+    bool                _bBumpedLeft;       // bumper state at the last tick, for edge detection
+    bool                _bBumpedRight;
+
+    float               _bumperInches;      // distance from our center to the bumper
+    float               _bumperAngle;       // angle from center line to the left/right bumper contact, in radians
+    float               _lookaheadInches;   // how far ahead BlockedAhead() looks
+
+    uint16_t            _decayTicks;        // ticks per complete decay pass, 0 for no decay
+    uint16_t            _decayCredit;       // fractional rows carried from tick to tick
+
+    uint16_t            _nMarked;
+
+    void                markAt( float angleOffset );
+
+public:
+
+    ObstacleMapper( CommandDispatcher* pCD, Position* pPos, CollisionRecovery* pBumper, OccupancyGrid* pGrid );
+
+    // O(1) query:  is there a known obstacle on our heading, within the look-ahead distance?
+    bool                IsPathAheadBlocked()    { return _pGrid->BlockedAhead( _pPosition->_xInches, _pPosition->_yInches,
+                                                                               _pPosition->_sinTheta, _pPosition->_cosTheta, _lookaheadInches ); }
+
+    virtual void        handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs );
+    virtual void        handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams );
+    virtual void        PrintSpecificParameterValues();
+};
@@ -0,0 +1,144 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#include <OccupancyGrid.h>
+
+OccupancyGrid::OccupancyGrid( float cellInches ) : _cellInches( cellInches ), _version( 0 ), _decayRow( 0 )
+{
+    // center the map on the origin
+    _originX = -( GRID_COLUMNS / 2 ) * _cellInches;
+    _originY = -( GRID_ROWS / 2 ) * _cellInches;
+
+    Clear();
+}
+
+
+void OccupancyGrid::Clear()
+{
+    memset( _cells, 0, sizeof( _cells ) );
+    _version++;
+}
+
+
+// The version only changes when a cell goes between blocked and clear.  Changes in confidence
+// don't affect anybody's path, so there's no need to make the planner look again.
+void OccupancyGrid::setLevel( GridIndex ix, uint8_t level )
+{
+    uint8_t shift = ( ix & 3 ) << 1;
+    uint8_t* pCell = &_cells[ ix >> 2 ];
+    bool bWasBlocked = IsBlocked( ix );
+
+    *pCell = ( *pCell & ~( GRID_LEVEL_MAX << shift ) ) | ( level << shift );
+
+    if ( bWasBlocked != ( level != 0 ) ) {
+        _version++;
+    }
+}
+
+
+void OccupancyGrid::SetBlocked( int col, int row, bool bBlocked )
+{
+    if ( InBounds( col, row ) ) {
+        setLevel( CellIndex( col, row ), bBlocked ? GRID_LEVEL_MAX : 0 );
+    }
+}
+
+
+// Called regularly with a small row count, this spreads the cost of decaying the whole map
+// over many ticks.
+void OccupancyGrid::Decay( uint16_t nRows )
+{
+    while ( nRows-- ) {
+        GridIndex ix = CellIndex( 0, _decayRow );
+        for ( int col = 0; col < GRID_COLUMNS; col++, ix++ ) {
+            uint8_t level = GetLevel( ix );
+            if ( level ) {
+                setLevel( ix, level - 1 );
+            }
+        }
+
+        if ( ++_decayRow >= GRID_ROWS ) {
+            _decayRow = 0;
+        }
+    }
+}
+
+
+bool OccupancyGrid::BlockedAhead( float x, float y, float sinTheta, float cosTheta, float lookahead )
+{
+    int col, row;
+
+    // heading 0 is North (+y), so x goes with sine and y with cosine
+    WorldToCell( x + lookahead * sinTheta, y + lookahead * cosTheta, col, row );
+    if ( IsBlocked( col, row ) ) {
+        return true;
+    }
+
+    WorldToCell( x + 0.5 * lookahead * sinTheta, y + 0.5 * lookahead * cosTheta, col, row );
+    return IsBlocked( col, row );
+}
+
+
+bool OccupancyGrid::WorldToCell( float x, float y, int& col, int& row )
+{
+    col = (int) floor( ( x - _originX ) / _cellInches );
+    row = (int) floor( ( y - _originY ) / _cellInches );
+    return InBounds( col, row );
+}
+
+
+// returns the center of the cell
+void OccupancyGrid::CellToWorld( int col, int row, float& x, float& y )
+{
+    x = _originX + ( col + 0.5 ) * _cellInches;
+    y = _originY + ( row + 0.5 ) * _cellInches;
+}
+
+
+// Walk the cells between the two end points (Bresenham), stopping at the first blocked cell.
+bool OccupancyGrid::LineBlocked( int col0, int row0, int col1, int row1 )
+{
+    int dCol = abs( col1 - col0 );
+    int dRow = -abs( row1 - row0 );
+    int stepCol = col0 < col1 ? 1 : -1;
+    int stepRow = row0 < row1 ? 1 : -1;
+    int error = dCol + dRow;
+
+    for ( ;; ) {
+        if ( IsBlocked( col0, row0 ) ) {
+            return true;
+        }
+        if ( col0 == col1 && row0 == row1 ) {
+            return false;
+        }
+
+        int error2 = 2 * error;
+        if ( error2 >= dRow ) {
+            error += dRow;
+            col0 += stepCol;
+        }
+        if ( error2 <= dCol ) {
+            error += dCol;
+            row0 += stepRow;
+        }
+    }
+}
+
+
+void OccupancyGrid::Print()
+{
+    for ( int row = GRID_ROWS - 1; row >= 0; row-- ) {
+        for ( int col = 0; col < GRID_COLUMNS; col++ ) {
+            uint8_t level = GetLevel( CellIndex( col, row ) );
+            SerialTx.print( level ? (char) ( '0' + level ) : '.' );
+        }
+        SerialTx.println();
+    }
+}
@@ -0,0 +1,113 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+#include "CommonDefs.h"
+
+// Grid dimensions are fixed at compile time, so the whole map lives in a static array.
+// The defaults keep the map small enough for the Pro Mini's RAM; anything with more
+// memory gets a bigger map.  Override these before including this header (or on the
+// compiler command line) to size the map for a particular target.
+#ifndef GRID_COLUMNS
+#ifdef __AVR__
+#define GRID_COLUMNS        16
+#define GRID_ROWS           16
+#else
+#define GRID_COLUMNS        128
+#define GRID_ROWS           128
+#endif
+#endif
+
+#ifndef GRID_CELL_INCHES
+#define GRID_CELL_INCHES    6
+#endif
+
+#define GRID_CELLS          ( (uint32_t) GRID_COLUMNS * GRID_ROWS )
+
+// confidence levels are two bits
+#define GRID_LEVEL_MAX      3
+
+// cell index type.  Small grids use 16 bits to save RAM in the planner's tables.
+#if GRID_COLUMNS * GRID_ROWS > 65535
+typedef uint32_t GridIndex;
+#else
+typedef uint16_t GridIndex;
+#endif
+
+
+// The OccupancyGrid is a bit-packed map of the area around the origin, two bits per cell.
+// Each cell holds a confidence level, 0 to 3.  Any non-zero level means the cell is blocked.
+// Marking a cell sets it to the maximum level; Decay() lowers every blocked cell by one level,
+// a few rows at a time, so an obstacle which is not seen again is eventually forgotten.
+//
+// The grid is centered on the origin (where Position starts), so world coordinates
+// from -GRID_COLUMNS/2 to +GRID_COLUMNS/2 cells are on the map.  Anything off the map
+// is treated as unknown, i.e., not blocked.
+//
+// Every time a cell becomes blocked or clear, a version number is bumped, so that clients
+// (such as the PathPlanner) can tell cheaply whether anything has changed since they last looked.
+class OccupancyGrid
+{
+    uint8_t     _cells[ ( GRID_CELLS + 3 ) / 4 ];
+
+    float       _cellInches;
+
+    // world coordinates of the lower left corner of cell 0,0
+    float       _originX;
+    float       _originY;
+
+    uint16_t    _version;
+
+    // next row to be decayed
+    uint16_t    _decayRow;
+
+    void        setLevel( GridIndex ix, uint8_t level );
+
+public:
+
+    OccupancyGrid( float cellInches = GRID_CELL_INCHES );
+
+    void        Clear();
+
+    bool        InBounds( int col, int row )            { return col >= 0 && col < GRID_COLUMNS && row >= 0 && row < GRID_ROWS; }
+    GridIndex   CellIndex( int col, int row )           { return (GridIndex) row * GRID_COLUMNS + col; }
+
+    uint8_t     GetLevel( GridIndex ix )                { return ( _cells[ ix >> 2 ] >> ( ( ix & 3 ) << 1 ) ) & GRID_LEVEL_MAX; }
+    bool        IsBlocked( GridIndex ix )               { return _cells[ ix >> 2 ] & ( GRID_LEVEL_MAX << ( ( ix & 3 ) << 1 ) ); }
+    bool        IsBlocked( int col, int row )           { return InBounds( col, row ) && IsBlocked( CellIndex( col, row ) ); }
+
+    // blocking sets the cell to full confidence; unblocking forgets it immediately
+    void        SetBlocked( int col, int row, bool bBlocked );
+
+    // lower the confidence of blocked cells by one level, for the next nRows rows
+    void        Decay( uint16_t nRows );
+
+    // O(1) look-ahead:  is the cell lookahead inches ahead of x, y (or halfway there) blocked?
+    // Takes the sine and cosine of the heading, which Position already has on hand.
+    bool        BlockedAhead( float x, float y, float sinTheta, float cosTheta, float lookahead );
+
+    // convert between world coordinates (inches) and cell coordinates.
+    // WorldToCell() returns false if the point is off the map.
+    bool        WorldToCell( float x, float y, int& col, int& row );
+    void        CellToWorld( int col, int row, float& x, float& y );
+
+    // true if any cell on the straight line between the two cells is blocked
+    bool        LineBlocked( int col0, int row0, int col1, int row1 );
+
+    float       GetCellInches()                         { return _cellInches; }
+    uint16_t    GetVersion()                            { return _version; }
+
+    // RAM used by the map, in bytes
+    size_t      Footprint()                             { return sizeof( *this ); }
+
+    // print the map to the console, north at the top
+    void        Print();
+};
@@ -0,0 +1,426 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#include <PathPlanner.h>
+
+// the eight directions we can step from a cell.  Even directions are straight, odd are diagonal.
+static const int8_t _dCol[ 8 ] = {  0,  1,  1,  1,  0, -1, -1, -1 };
+static const int8_t _dRow[ 8 ] = {  1,  1,  0, -1, -1, -1,  0,  1 };
+
+#define NIBBLE_CLOSED   0x08
+#define NIBBLE_DIR      0x07
+
+
+PathPlanner::PathPlanner( CommandDispatcher* pCD, Position* pPos, WaypointManager* pWM, Navigator* pNav, OccupancyGrid* pGrid ) :
+    Behavior( pCD ),
+    _pPosition( pPos ),
+    _pWaypointManager( pWM ),
+    _pNavigator( pNav ),
+    _pGrid( pGrid )
+{
+    _pName = F("Path Planner");
+    _pHelpString = F(  "  O <x> <y> : Mark obstacle at x, y (inches)\n"
+                        "  C <x> <y> : Clear obstacle at x, y\n"
+                        "  X : Clear map\n"
+                        "  M : Print map\n"
+                        "  P : Replan now\n"
+                        "  B <runs> : Benchmark planning time"
+                        );
+
+    SubscribeTo( pCD, 'A' );    // A for A*
+
+    _nOpen = 0;
+    _gridVersion = _pGrid->GetVersion() - 1;   // force a check on the first tick
+    _hTarget = NO_WAYPOINT;
+
+    _planMicros = 0;
+    _nExpanded = 0;
+    _nEmitted = 0;
+}
+
+
+void PathPlanner::handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams )
+{
+    if ( _bEnabled ) {
+        WaypointHandle hTarget = _pNavigator->GetCurrentWaypoint();
+
+        // nothing to do unless the map or our target has changed since last time.  After an
+        // overrun, the check can wait a tick.
+        if ( ! SkipOptional() && ( _pGrid->GetVersion() != _gridVersion || hTarget != _hTarget ) ) {
+            _gridVersion = _pGrid->GetVersion();
+            _hTarget = hTarget;
+
+            if ( hTarget != NO_WAYPOINT && pathBlocked( hTarget ) ) {
+                PROGRESS_MSG( "Path blocked, replanning" );
+                replan( hTarget );
+            }
+        }
+    }
+}
+
+
+// Check our remaining path:  from where we are to the current Waypoint, then on through any
+// planned Waypoints up to the next user-defined one.
+bool PathPlanner::pathBlocked( WaypointHandle hWaypoint )
+{
+    int col0, row0, col1, row1;
+    Waypoint* pWaypoint = _pWaypointManager->GetWaypoint( hWaypoint );
+
+    _pGrid->WorldToCell( _pPosition->_xInches, _pPosition->_yInches, col0, row0 );
+
+    while ( pWaypoint ) {
+        _pGrid->WorldToCell( pWaypoint->_x, pWaypoint->_y, col1, row1 );
+        if ( _pGrid->LineBlocked( col0, row0, col1, row1 ) ) {
+            return true;
+        }
+        if ( ! pWaypoint->_bPlanned ) {
+            break;
+        }
+        col0 = col1;
+        row0 = row1;
+        hWaypoint = _pWaypointManager->Next( hWaypoint );
+        pWaypoint = _pWaypointManager->GetWaypoint( hWaypoint );
+    }
+    return false;
+}
+
+
+void PathPlanner::removePlanned( WaypointHandle hWaypoint )
+{
+    Waypoint* pWaypoint;
+    while ( ( pWaypoint = _pWaypointManager->GetWaypoint( hWaypoint ) ) && pWaypoint->_bPlanned ) {
+        WaypointHandle hNext = _pWaypointManager->Next( hWaypoint );
+        _pWaypointManager->DeleteWaypoint( hWaypoint );
+        hWaypoint = hNext;
+    }
+}
+
+
+// Discard any intermediate Waypoints ahead of us, and plan a new route to the next user-defined Waypoint.
+// If hWaypoint was itself a planned Waypoint, WaypointManager moves Navigator on to the goal as the
+// planned ones are deleted.
+bool PathPlanner::replan( WaypointHandle hWaypoint )
+{
+    int startCol, startRow, goalCol, goalRow;
+
+    removePlanned( hWaypoint );
+
+    WaypointHandle hGoal = _pNavigator->GetCurrentWaypoint();
+    Waypoint* pGoal = _pWaypointManager->GetWaypoint( hGoal );
+    if ( ! pGoal ) {
+        return false;
+    }
+
+    if ( ! _pGrid->WorldToCell( _pPosition->_xInches, _pPosition->_yInches, startCol, startRow ) ||
+         ! _pGrid->WorldToCell( pGoal->_x, pGoal->_y, goalCol, goalRow ) ) {
+        PROGRESS_MSG( "Off the map, can't plan" );
+        return false;
+    }
+
+    unsigned long startMicros = micros();
+    bool bFound = search( startCol, startRow, goalCol, goalRow );
+    _nEmitted = bFound ? emitWaypoints( startCol, startRow, goalCol, goalRow, hGoal ) : 0;
+    _planMicros = micros() - startMicros;
+
+    // our own edits changed Navigator's Waypoint, but the path to it is now clear
+    _hTarget = _pNavigator->GetCurrentWaypoint();
+
+    IF_MASK( MM_PROGRESS ) {
+        SerialTx.print( bFound ? F( "Planned, waypoints added: " ) : F( "No path found, expanded: " ) );
+        SerialTx.println( bFound ? _nEmitted : _nExpanded );
+    }
+    return bFound;
+}
+
+
+void PathPlanner::setNibble( GridIndex ix, uint8_t val )
+{
+    uint8_t* pByte = &_parent[ ix >> 1 ];
+    if ( ix & 1 ) {
+        *pByte = ( *pByte & 0x0F ) | ( val << 4 );
+    }
+    else {
+        *pByte = ( *pByte & 0xF0 ) | ( val & 0x0F );
+    }
+}
+
+
+// octile distance, which is exact for an empty grid, so the search stays admissible
+PlanCost PathPlanner::heuristic( int col, int row, int goalCol, int goalRow )
+{
+    unsigned int dCol = abs( goalCol - col );
+    unsigned int dRow = abs( goalRow - row );
+    unsigned long h = dCol > dRow ? 2UL * dCol + dRow : 2UL * dRow + dCol;
+    return h < PLAN_COST_MAX ? h : PLAN_COST_MAX - 1;
+}
+
+
+// binary heap, keyed on f.  Returns false if the open list is full.
+bool PathPlanner::pushOpen( GridIndex ix, PlanCost f )
+{
+    if ( _nOpen >= PLANNER_OPEN_MAX ) {
+        return false;
+    }
+
+    uint16_t child = _nOpen++;
+    while ( child > 0 ) {
+        uint16_t parent = ( child - 1 ) / 2;
+        if ( _open[ parent ].f <= f ) {
+            break;
+        }
+        _open[ child ] = _open[ parent ];
+        child = parent;
+    }
+    _open[ child ].ix = ix;
+    _open[ child ].f = f;
+    return true;
+}
+
+
+GridIndex PathPlanner::popOpen()
+{
+    GridIndex ixTop = _open[ 0 ].ix;
+    OpenEntry last = _open[ --_nOpen ];
+
+    uint16_t parent = 0;
+    for ( ;; ) {
+        uint16_t child = 2 * parent + 1;
+        if ( child >= _nOpen ) {
+            break;
+        }
+        if ( child + 1 < _nOpen && _open[ child + 1 ].f < _open[ child ].f ) {
+            child++;
+        }
+        if ( last.f <= _open[ child ].f ) {
+            break;
+        }
+        _open[ parent ] = _open[ child ];
+        parent = child;
+    }
+    _open[ parent ] = last;
+    return ixTop;
+}
+
+
+// A* over the 8-connected grid.  Cells may appear in the open list more than once; stale
+// entries are skipped when they come off the heap, which is cheaper than a decrease-key.
+bool PathPlanner::search( int startCol, int startRow, int goalCol, int goalRow )
+{
+    GridIndex ixGoal = _pGrid->CellIndex( goalCol, goalRow );
+
+    _nExpanded = 0;
+    _nOpen = 0;
+
+    if ( _pGrid->IsBlocked( ixGoal ) ) {
+        return false;
+    }
+
+    memset( _cost, 0xFF, sizeof( _cost ) );
+    memset( _parent, 0, sizeof( _parent ) );
+
+    GridIndex ixStart = _pGrid->CellIndex( startCol, startRow );
+    _cost[ ixStart ] = 0;
+    pushOpen( ixStart, heuristic( startCol, startRow, goalCol, goalRow ) );
+
+    while ( _nOpen ) {
+        GridIndex ix = popOpen();
+        if ( getNibble( ix ) & NIBBLE_CLOSED ) {
+            continue;
+        }
+        setNibble( ix, getNibble( ix ) | NIBBLE_CLOSED );
+        _nExpanded++;
+
+        if ( ix == ixGoal ) {
+            return true;
+        }
+
+        int col = ix % GRID_COLUMNS;
+        int row = ix / GRID_COLUMNS;
+
+        for ( uint8_t dir = 0; dir < 8; dir++ ) {
+            int nCol = col + _dCol[ dir ];
+            int nRow = row + _dRow[ dir ];
+            if ( ! _pGrid->InBounds( nCol, nRow ) ) {
+                continue;
+            }
+
+            GridIndex nix = _pGrid->CellIndex( nCol, nRow );
+            if ( _pGrid->IsBlocked( nix ) || ( getNibble( nix ) & NIBBLE_CLOSED ) ) {
+                continue;
+            }
+
+            // don't cut corners around an obstacle on a diagonal step
+            if ( ( dir & 1 ) && ( _pGrid->IsBlocked( nCol, row ) || _pGrid->IsBlocked( col, nRow ) ) ) {
+                continue;
+            }
+
+            unsigned long g = (unsigned long) _cost[ ix ] + ( ( dir & 1 ) ? PLAN_COST_DIAGONAL : PLAN_COST_STRAIGHT );
+            if ( g < _cost[ nix ] ) {
+                unsigned long f = g + heuristic( nCol, nRow, goalCol, goalRow );
+                _cost[ nix ] = g;
+                setNibble( nix, dir );
+                if ( ! pushOpen( nix, f < PLAN_COST_MAX ? f : PLAN_COST_MAX - 1 ) ) {
+                    PROGRESS_MSG( "Planner open list full" );
+                    return false;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+
+// Walk back from the goal along the parent directions.  Rather than emitting every cell, we pull
+// the path tight:  a cell only becomes a Waypoint if the next cell back can't be seen from the last
+// Waypoint we emitted.  Since we're walking backward, each new Waypoint is inserted ahead of the
+// one emitted before it, so they end up in forward order, and Navigator is pointed at the first.
+uint8_t PathPlanner::emitWaypoints( int startCol, int startRow, int goalCol, int goalRow, WaypointHandle hGoal )
+{
+    WaypointHandle hInsert = hGoal;
+    uint8_t nEmitted = 0;
+    int anchorCol = goalCol, anchorRow = goalRow;
+    int col = goalCol, row = goalRow;
+
+    while ( col != startCol || row != startRow ) {
+        uint8_t dir = getNibble( _pGrid->CellIndex( col, row ) ) & NIBBLE_DIR;
+        int prevCol = col - _dCol[ dir ];
+        int prevRow = row - _dRow[ dir ];
+
+        if ( _pGrid->LineBlocked( anchorCol, anchorRow, prevCol, prevRow ) ) {
+            float x, y;
+            _pGrid->CellToWorld( col, row, x, y );
+            WaypointHandle h = _pWaypointManager->InsertWaypoint( hInsert, x, y, PLANNER_WAYPOINT_RADIUS );
+            if ( h == NO_WAYPOINT ) {
+                PROGRESS_MSG( "Waypoint list full, plan truncated" );
+                break;
+            }
+            _pWaypointManager->GetWaypoint( h )->_bPlanned = true;
+            hInsert = h;
+            nEmitted++;
+
+            anchorCol = col;
+            anchorRow = row;
+        }
+        col = prevCol;
+        row = prevRow;
+    }
+
+    _pNavigator->SetCurrentWaypoint( hInsert );
+    return nEmitted;
+}
+
+
+// Time repeated searches from our position to the current Waypoint (or corner to corner, if we
+// don't have one).  The search result is discarded; the Waypoint list is not touched.
+void PathPlanner::benchmark( int nRuns )
+{
+    int startCol = 0, startRow = 0, goalCol = GRID_COLUMNS - 1, goalRow = GRID_ROWS - 1;
+    Waypoint* pGoal = _pWaypointManager->GetWaypoint( _pNavigator->GetCurrentWaypoint() );
+
+    if ( pGoal ) {
+        _pGrid->WorldToCell( _pPosition->_xInches, _pPosition->_yInches, startCol, startRow );
+        _pGrid->WorldToCell( pGoal->_x, pGoal->_y, goalCol, goalRow );
+        startCol = constrain( startCol, 0, GRID_COLUMNS - 1 );
+        startRow = constrain( startRow, 0, GRID_ROWS - 1 );
+        goalCol = constrain( goalCol, 0, GRID_COLUMNS - 1 );
+        goalRow = constrain( goalRow, 0, GRID_ROWS - 1 );
+    }
+
+    if ( nRuns < 1 ) {
+        nRuns = 1;
+    }
+
+    unsigned long minMicros = 0xFFFFFFFF, maxMicros = 0, totalMicros = 0;
+    bool bFound = false;
+
+    for ( int run = 0; run < nRuns; run++ ) {
+        unsigned long startMicros = micros();
+        bFound = search( startCol, startRow, goalCol, goalRow );
+        unsigned long elapsed = micros() - startMicros;
+
+        totalMicros += elapsed;
+        minMicros = min( minMicros, elapsed );
+        maxMicros = max( maxMicros, elapsed );
+    }
+
+    SerialTx.print( F( "Planner benchmark, " ) );
+    SerialTx.print( GRID_COLUMNS ); SerialTx.print( 'x' ); SerialTx.print( GRID_ROWS );
+    SerialTx.print( F( " grid, runs: " ) );
+    SerialTx.println( nRuns );
+    SerialTx.print( bFound ? F( " Path found, cells expanded: " ) : F( " No path, cells expanded: " ) );
+    SerialTx.println( _nExpanded );
+    SerialTx.print( F( " Microseconds min/avg/max: " ) );
+    SerialTx.print( minMicros ); SerialTx.print( '/' );
+    SerialTx.print( totalMicros / nRuns ); SerialTx.print( '/' );
+    SerialTx.println( maxMicros );
+}
+
+
+void PathPlanner::handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs )
+{
+    int col, row;
+
+    switch( pArgs->inputBuffer[1] ) {
+        case 'O' : // mark an obstacle
+        case 'C' : // clear an obstacle
+            if ( _pGrid->WorldToCell( pArgs->fParams[ 0 ], pArgs->fParams[ 1 ], col, row ) ) {
+                _pGrid->SetBlocked( col, row, pArgs->inputBuffer[1] == 'O' );
+                IF_MASK( MM_RESPONSES ) {
+                    SerialTx.print( pArgs->inputBuffer[1] == 'O' ? F( "Obstacle marked at cell " ) : F( "Obstacle cleared at cell " ) );
+                    SerialTx.print( col ); SerialTx.print( ',' );
+                    SerialTx.println( row );
+                }
+            }
+            else {
+                SerialTx.println( F( "That point is off the map." ) );
+            }
+            break;
+
+        case 'X' : // clear the map
+            _pGrid->Clear();
+            IF_MASK( MM_RESPONSES ) {
+                SerialTx.println( F( "Map cleared." ) );
+            }
+            break;
+
+        case 'M' : // print the map
+            _pGrid->Print();
+            break;
+
+        case 'P' : // replan now
+            if ( _pNavigator->GetCurrentWaypoint() != NO_WAYPOINT ) {
+                replan( _pNavigator->GetCurrentWaypoint() );
+            }
+            break;
+
+        case 'B' : // benchmark
+            benchmark( pArgs->nParams[ 0 ] );
+            break;
+    }
+}
+
+
+void PathPlanner::PrintSpecificParameterValues()
+{
+    SerialTx.print( F( " Grid: " ) );
+    SerialTx.print( GRID_COLUMNS ); SerialTx.print( 'x' ); SerialTx.print( GRID_ROWS );
+    SerialTx.print( F( " cells of " ) );
+    SerialTx.print( _pGrid->GetCellInches() );
+    SerialTx.println( F( " inches" ) );
+
+    SerialTx.print( F( " RAM used by map/planner (bytes): " ) );
+    SerialTx.print( _pGrid->Footprint() ); SerialTx.print( '/' );
+    SerialTx.println( sizeof( _cost ) + sizeof( _parent ) + sizeof( _open ) );
+
+    SerialTx.print( F( " Last plan: microseconds/expanded/waypoints: " ) );
+    SerialTx.print( _planMicros ); SerialTx.print( '/' );
+    SerialTx.print( _nExpanded ); SerialTx.print( '/' );
+    SerialTx.println( _nEmitted );
+}
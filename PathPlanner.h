@@ -0,0 +1,120 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+#include <CommandDispatcher.h>
+#include <Director.h>
+#include <Position.h>
+#include <WaypointManager.h>
+#include <Navigator.h>
+#include <OccupancyGrid.h>
+
+// Path costs are in half-cell units:  2 for a straight step, 3 for a diagonal step.
+// On the AVR these fit in a byte for any reasonable path on the small default grid,
+// which halves the size of the cost table.
+#ifdef __AVR__
+typedef uint8_t     PlanCost;
+#define PLAN_COST_MAX   0xFF
+#else
+typedef uint16_t    PlanCost;
+#define PLAN_COST_MAX   0xFFFF
+#endif
+
+#define PLAN_COST_STRAIGHT  2
+#define PLAN_COST_DIAGONAL  3
+
+// maximum number of entries in the A* open list
+#ifndef PLANNER_OPEN_MAX
+#ifdef __AVR__
+#define PLANNER_OPEN_MAX    48
+#else
+#define PLANNER_OPEN_MAX    ( GRID_CELLS / 4 )
+#endif
+#endif
+
+// radius of the intermediate waypoints emitted by the planner
+#define PLANNER_WAYPOINT_RADIUS  2
+
+
+// PathPlanner
+//
+// The PathPlanner keeps Navigator from driving straight through known obstacles.  At each tick it
+// checks the remaining path to Navigator's current Waypoint against the OccupancyGrid.  If that
+// path is blocked, it runs A* across the grid from our Position to the next user-defined Waypoint,
+// and inserts the corners of the resulting path into the WaypointManager as intermediate Waypoints
+// ahead of Navigator's current one.  Intermediate Waypoints are flagged as planned, so the next
+// replan can remove them again.
+//
+// The check is incremental:  the line-of-sight test is only repeated when the grid version or
+// Navigator's current Waypoint changes, and A* only runs when the path we are following is
+// actually blocked.
+//
+// The PathPlanner never subsumes.  It should be placed ahead of Navigator in the chain.
+//
+// A* working storage is a cost per cell, plus one nibble per cell holding the direction we came
+// from and a "closed" flag.  On the AVR's default 16x16 grid this is under 600 bytes in all.
+class PathPlanner : public Behavior
+{
+    Position*           _pPosition;
+    WaypointManager*    _pWaypointManager;
+    Navigator*          _pNavigator;
+    OccupancyGrid*      _pGrid;
+
+    // A* working storage
+    struct OpenEntry {
+        GridIndex   ix;
+        PlanCost    f;
+    };
+
+    PlanCost            _cost[ GRID_CELLS ];
+    uint8_t             _parent[ ( GRID_CELLS + 1 ) / 2 ];    // nibble per cell:  bits 0-2 direction, bit 3 closed
+    OpenEntry           _open[ PLANNER_OPEN_MAX ];
+    uint16_t            _nOpen;
+
+    // what we checked last time, so we can skip the check when nothing has changed
+    uint16_t            _gridVersion;
+    WaypointHandle      _hTarget;
+
+    // statistics from the last plan
+    unsigned long       _planMicros;
+    uint16_t            _nExpanded;
+    uint8_t             _nEmitted;
+
+    uint8_t             getNibble( GridIndex ix )               { return ( ix & 1 ) ? _parent[ ix >> 1 ] >> 4 : _parent[ ix >> 1 ] & 0x0F; }
+    void                setNibble( GridIndex ix, uint8_t val );
+
+    bool                pushOpen( GridIndex ix, PlanCost f );
+    GridIndex           popOpen();
+
+    PlanCost            heuristic( int col, int row, int goalCol, int goalRow );
+
+    // run A* between the two cells.  Returns false if there is no path.
+    bool                search( int startCol, int startRow, int goalCol, int goalRow );
+
+    // walk the search result back from the goal, inserting corners as Waypoints ahead of hGoal
+    uint8_t             emitWaypoints( int startCol, int startRow, int goalCol, int goalRow, WaypointHandle hGoal );
+
+    // remove previously planned Waypoints from hWaypoint onward
+    void                removePlanned( WaypointHandle hWaypoint );
+
+    bool                pathBlocked( WaypointHandle hWaypoint );
+    bool                replan( WaypointHandle hWaypoint );
+
+    void                benchmark( int nRuns );
+
+public:
+
+    PathPlanner( CommandDispatcher* pCD, Position* pPos, WaypointManager* pWM, Navigator* pNav, OccupancyGrid* pGrid );
+
+    virtual void        handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs );
+    virtual void        handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams );
+    virtual void        PrintSpecificParameterValues();
+};
@@ -0,0 +1,244 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#include <PidController.h>
+
+PidController::PidController( int16_t outMin, int16_t outMax ) : _outMin( outMin ), _outMax( outMax )
+{
+    _kP = _kI = _kD = 0;
+    _integral = 0;
+    _prevMeasurement = 0;
+    _bSaturated = false;
+}
+
+
+int32_t PidController::toFixed( float gain )
+{
+    return constrain( gain, 0.0, PID_GAIN_MAX ) * ( 1L << PID_FRACTION_BITS );
+}
+
+
+void PidController::SetGains( float kP, float kI, float kD )
+{
+    _kP = toFixed( kP );
+    _kI = toFixed( kI );
+    _kD = toFixed( kD );
+}
+
+
+void PidController::Reset( int16_t measurement, int16_t output, int16_t feedforward )
+{
+    // choose the integral which makes the output match, with no error.  Without an integral gain
+    // nothing would ever unwind it, so a P or PD controller just starts from the feedforward.
+    if ( _kI == 0 ) {
+        _integral = 0;
+    }
+    else {
+        _integral = constrain( (int32_t) output - feedforward, (int32_t) _outMin, (int32_t) _outMax ) * ( 1L << PID_FRACTION_BITS );
+    }
+    _prevMeasurement = measurement;
+    _bSaturated = false;
+}
+
+
+int16_t PidController::Update( int16_t setpoint, int16_t measurement, int16_t feedforward )
+{
+    int16_t error = constrain( (int32_t) setpoint - measurement, -PID_ERROR_MAX, PID_ERROR_MAX );
+    int16_t dMeasurement = constrain( (int32_t) measurement - _prevMeasurement, -PID_ERROR_MAX, PID_ERROR_MAX );
+    _prevMeasurement = measurement;
+
+    int64_t output = (int64_t) feedforward * ( 1L << PID_FRACTION_BITS ) + _kP * error - _kD * dMeasurement;
+
+    // only integrate if it won't drive us further into saturation
+    int32_t outMin = (int32_t) _outMin * ( 1L << PID_FRACTION_BITS );
+    int32_t outMax = (int32_t) _outMax * ( 1L << PID_FRACTION_BITS );
+    int64_t unclamped = output + _integral;
+    if ( ! ( unclamped >= outMax && error > 0 ) && ! ( unclamped <= outMin && error < 0 ) ) {
+        _integral = constrain( (int64_t) _integral + _kI * error, outMin, outMax );
+    }
+    output += _integral;
+
+    _bSaturated = output > outMax || output < outMin;
+
+    // round to nearest
+    return ( constrain( output, outMin, outMax ) + ( 1L << ( PID_FRACTION_BITS - 1 ) ) ) >> PID_FRACTION_BITS;
+}
+
+
+bool FeedforwardTable::SetPoint( int16_t speed, int16_t throttle )
+{
+    uint8_t ix = 0;
+    while ( ix < _nPoints && _speed[ ix ] < speed ) {
+        ix++;
+    }
+
+    if ( ix == _nPoints || _speed[ ix ] != speed ) {
+        // a new point, so make room for it
+        if ( _nPoints == FEEDFORWARD_POINTS ) {
+            return false;
+        }
+        for ( uint8_t ixMove = _nPoints; ixMove > ix; ixMove-- ) {
+            _speed[ ixMove ] = _speed[ ixMove - 1 ];
+            _throttle[ ixMove ] = _throttle[ ixMove - 1 ];
+        }
+        _nPoints++;
+    }
+
+    _speed[ ix ] = speed;
+    _throttle[ ix ] = throttle;
+    return true;
+}
+
+
+int16_t FeedforwardTable::Lookup( int16_t speed )
+{
+    if ( speed < 0 ) {
+        return -Lookup( -speed );
+    }
+    if ( _nPoints == 0 ) {
+        return 0;
+    }
+    if ( _nPoints == 1 ) {
+        return _throttle[ 0 ];
+    }
+
+    // find the segment, extrapolating from the end ones
+    uint8_t ix = 1;
+    while ( ix < _nPoints - 1 && _speed[ ix ] < speed ) {
+        ix++;
+    }
+
+    int16_t dSpeed = _speed[ ix ] - _speed[ ix - 1 ];
+    return _throttle[ ix - 1 ] + (int32_t) ( speed - _speed[ ix - 1 ] ) * ( _throttle[ ix ] - _throttle[ ix - 1 ] ) / dSpeed;
+}
+
+
+void FeedforwardTable::Print()
+{
+    SerialTx.println( F( " Feedforward (IPS/10, throttle):" ) );
+    for ( uint8_t ix = 0; ix < _nPoints; ix++ ) {
+        SerialTx.print( F( "  " ) );
+        SerialTx.print( _speed[ ix ] ); SerialTx.print( '\t' );
+        SerialTx.println( _throttle[ ix ] );
+    }
+}
+
+
+void RelayTuner::Start( int16_t bias, int16_t amplitude, uint8_t cycles, int16_t hysteresis )
+{
+    _bias = bias;
+    _amplitude = amplitude;
+    _cyclesWanted = cycles;
+    _hysteresis = hysteresis;
+
+    _bHigh = true;
+    _cycles = 0;
+    _ticks = 0;
+    _max = -32768;
+    _min = 32767;
+    _sumPeriod = _sumSwing = 0;
+
+    _state = eTunerRunning;
+}
+
+
+int16_t RelayTuner::Update( int16_t setpoint, int16_t measurement )
+{
+    if ( _state != eTunerRunning ) {
+        return _bias;
+    }
+
+    int16_t error = setpoint - measurement;
+    _ticks++;
+    if ( measurement > _max ) {
+        _max = measurement;
+    }
+    if ( measurement < _min ) {
+        _min = measurement;
+    }
+
+    if ( _bHigh && error < -_hysteresis ) {
+        _bHigh = false;
+    }
+    else if ( ! _bHigh && error > _hysteresis ) {
+        // a rising switch completes a cycle
+        _bHigh = true;
+        if ( ++_cycles > TUNER_SETTLE_CYCLES ) {
+            _sumPeriod += _ticks;
+            _sumSwing += _max - _min;
+            if ( _cycles - TUNER_SETTLE_CYCLES == _cyclesWanted ) {
+                _state = _sumSwing ? eTunerDone : eTunerFailed;
+                return _bias;
+            }
+        }
+        _ticks = 0;
+        _max = -32768;
+        _min = 32767;
+    }
+
+    if ( _ticks > TUNER_TIMEOUT ) {
+        _state = eTunerFailed;
+        return _bias;
+    }
+
+    return _bHigh ? _bias + _amplitude : _bias - _amplitude;
+}
+
+
+float RelayTuner::GetUltimateGain()
+{
+    // _sumSwing is twice the amplitude, summed over the cycles
+    return 8.0 * _amplitude * _cyclesWanted / ( PI * _sumSwing );
+}
+
+
+float RelayTuner::GetUltimatePeriod()
+{
+    return (float) _sumPeriod / _cyclesWanted;
+}
+
+
+void RelayTuner::ProposeGains( float& kP, float& kI, float& kD )
+{
+    float ku = GetUltimateGain();
+    kP = 0.45 * ku;
+    kI = kP * 1.2 / GetUltimatePeriod();
+    kD = 0.0;
+}
+
+
+void RelayTuner::Print()
+{
+    switch ( _state ) {
+        case eTunerIdle :
+            SerialTx.println( F( "idle" ) );
+            break;
+        case eTunerRunning :
+            SerialTx.print( F( "running, cycle " ) );
+            SerialTx.println( _cycles );
+            break;
+        case eTunerFailed :
+            SerialTx.println( F( "failed" ) );
+            break;
+        case eTunerDone : {
+            float kP, kI, kD;
+            ProposeGains( kP, kI, kD );
+            SerialTx.print( F( "Ku " ) );
+            SerialTx.print( GetUltimateGain(), 4 );
+            SerialTx.print( F( "  Tu " ) );
+            SerialTx.print( GetUltimatePeriod() );
+            SerialTx.print( F( "  PID:\t" ) );
+            SerialTx.print( kP, 4 ); SerialTx.print( '\t' );
+            SerialTx.print( kI, 4 ); SerialTx.print( '\t' );
+            SerialTx.println( kD, 4 );
+            break;
+        }
+    }
+}
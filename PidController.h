@@ -0,0 +1,179 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+#include "CommonDefs.h"
+
+// PidController
+//
+// A PID loop for one channel (one motor, one heading, ...), in fixed point so it costs a handful
+// of integer multiplies per tick instead of a string of float operations.
+//
+// Setpoint and measurement are integers in whatever units the caller likes (CruiseControl uses
+// encoder ticks per interval); the output is an integer in output units (throttle).  Gains are
+// held with PID_FRACTION_BITS fractional bits, so they range from 1/65536 up to PID_GAIN_MAX.
+//
+// The output is:
+//
+//      feedforward + kP * error + integral - kD * ( change in measurement )
+//
+//  * The feedforward is supplied by the caller for each update; see FeedforwardTable.  With a
+//    decent feedforward, the other terms only have to correct the remaining error.
+//  * The integral accumulates kI * error, so changing kI doesn't bump the output.  It is clamped
+//    to the output range, and stops accumulating while the output is saturated in the direction
+//    the error is pushing (conditional integration), so it doesn't wind up while we're stalled.
+//  * The derivative acts on the measurement rather than the error, so a setpoint change doesn't
+//    kick the output.
+//
+// With gains below 2^19 and errors below 2^11, each term fits in 32 bits, but their sum needn't,
+// so it is taken in 64.
+//
+// Call Reset() when the loop takes control (e.g. after being subsumed), giving the output it is
+// taking over from, so it picks up where the last controller left off.
+#define PID_FRACTION_BITS   16
+#define PID_GAIN_MAX        8.0
+#define PID_ERROR_MAX       2047        // errors are clamped to this, to keep each term in 32 bits
+
+class PidController
+{
+    int32_t     _kP;
+    int32_t     _kI;
+    int32_t     _kD;
+
+    int32_t     _integral;      // with PID_FRACTION_BITS
+    int16_t     _prevMeasurement;
+
+    int16_t     _outMin;
+    int16_t     _outMax;
+
+    bool        _bSaturated;    // the last output was clamped
+
+    static int32_t  toFixed( float gain );
+
+public:
+
+    PidController( int16_t outMin = -255, int16_t outMax = 255 );
+
+    void        SetGains( float kP, float kI, float kD );
+    void        SetLimits( int16_t outMin, int16_t outMax )     { _outMin = outMin; _outMax = outMax; }
+
+    float       GetKP()     { return (float) _kP / ( 1L << PID_FRACTION_BITS ); }
+    float       GetKI()     { return (float) _kI / ( 1L << PID_FRACTION_BITS ); }
+    float       GetKD()     { return (float) _kD / ( 1L << PID_FRACTION_BITS ); }
+
+    // take control, bumplessly, from whatever was producing output before
+    void        Reset( int16_t measurement, int16_t output, int16_t feedforward );
+
+    // run one step, returning the new output
+    int16_t     Update( int16_t setpoint, int16_t measurement, int16_t feedforward );
+
+    bool        IsSaturated()   { return _bSaturated; }
+    int16_t     GetIntegral()   { return _integral >> PID_FRACTION_BITS; }
+};
+
+
+// FeedforwardTable maps a speed to the throttle expected to produce it, by linear interpolation
+// between up to FEEDFORWARD_POINTS (speed, throttle) points, in increasing order of speed.
+// Speeds outside the table are extrapolated from the nearest segment.  Negative speeds are
+// looked up by magnitude, and the throttle negated.
+//
+// Speeds are in tenths of an inch per second, so the table describes the drive train, regardless
+// of the encoder resolution or the Director's interval.
+#define FEEDFORWARD_POINTS  6
+
+class FeedforwardTable
+{
+    int16_t     _speed[ FEEDFORWARD_POINTS ];
+    int16_t     _throttle[ FEEDFORWARD_POINTS ];
+    uint8_t     _nPoints;
+
+public:
+
+    FeedforwardTable()      { Clear(); }
+
+    void        Clear()     { _nPoints = 0; }
+
+    // set a point, keeping the table in order.  Returns false if the table is full.
+    bool        SetPoint( int16_t speed, int16_t throttle );
+
+    int16_t     Lookup( int16_t speed );
+
+    void        Print();
+};
+
+
+// RelayTuner finds gains for a PidController by relay feedback (Astrom and Hagglund).  In place
+// of the PID, it drives the output to bias + amplitude while the measurement is below the
+// setpoint, and to bias - amplitude while it is above.  The bias should be the output which
+// was holding the setpoint, so the relay swings evenly about it.  The plant settles into an oscillation
+// whose period is the ultimate period Tu, and whose amplitude a gives the ultimate gain
+//
+//      Ku = 4 * amplitude / ( pi * a )
+//
+// from which the Ziegler-Nichols rules give the gains.  The first TUNER_SETTLE_CYCLES cycles are
+// discarded while the oscillation settles, and the rest averaged.  The hysteresis keeps noise
+// from switching the relay; measurement noise bigger than the hysteresis will shorten the period.
+//
+// Each Update() is a few compares, so it runs within the normal tick.  The period is counted in
+// Update() calls, so the gains come out in the per-update units PidController uses.
+#define TUNER_SETTLE_CYCLES 1
+#define TUNER_TIMEOUT       100     // updates to wait for a cycle to complete before giving up
+
+class RelayTuner
+{
+public:
+
+    enum eTunerState {
+        eTunerIdle,
+        eTunerRunning,
+        eTunerDone,
+        eTunerFailed,       // the relay never switched, or the measurement never moved
+    };
+
+private:
+
+    eTunerState _state;
+
+    int16_t     _bias;
+    int16_t     _amplitude;
+    int16_t     _hysteresis;
+    uint8_t     _cyclesWanted;
+
+    bool        _bHigh;         // the relay is on the high side
+    uint8_t     _cycles;        // rising switches seen
+    uint16_t    _ticks;         // updates since the last rising switch
+    int16_t     _max;           // measurement extremes in this cycle
+    int16_t     _min;
+
+    uint16_t    _sumPeriod;     // over the cycles counted
+    uint16_t    _sumSwing;      // peak-to-peak
+
+public:
+
+    RelayTuner() : _state( eTunerIdle ) {}
+
+    void        Start( int16_t bias, int16_t amplitude, uint8_t cycles, int16_t hysteresis );
+    void        Stop()          { _state = eTunerIdle; }
+
+    // run one step, returning the new output
+    int16_t     Update( int16_t setpoint, int16_t measurement );
+
+    eTunerState GetState()      { return _state; }
+
+    float       GetUltimateGain();
+    float       GetUltimatePeriod();
+
+    // Ziegler-Nichols PI gains.  A speed loop is first-order with a little delay, where the
+    // derivative term only amplifies the encoder quantization, so kD is 0.
+    void        ProposeGains( float& kP, float& kI, float& kD );
+
+    void        Print();
+};
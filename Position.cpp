@@ -11,7 +11,7 @@ Subsumption Architecture as described by David P. Anderson.
 #include <Position.h>
 
 Position::Position( CommandDispatcher* pCD, Director* pD, 
-        uint32_t*& leftPosition, uint32_t*& rightPosition,  // pointers to _currentEncoderPositionLeft and _currentEncoderPositionRight
+        int32_t*& leftPosition, int32_t*& rightPosition,  // pointers to _currentEncoderPositionLeft and _currentEncoderPositionRight
         float ticksPerInch, float wheelSpacing ) : Behavior( pCD )
 {
     leftPosition = &_currentEncoderPositionLeft;
@@ -27,7 +27,28 @@ Position::Position( CommandDispatcher* pCD, Director* pD,
 
     // compute conversion factors
     _EncoderTicksPerInch = ticksPerInch;
+
     _WheelSpacingInches = wheelSpacing;
+
+    reset();
+}
+
+
+// back to the origin, heading north
+void Position::reset()
+{
+    noInterrupts();
+    _currentEncoderPositionLeft = 0;
+    _currentEncoderPositionRight = 0;
+    interrupts();
+
+    _snapshotPositionLeft = _snapshotPositionRight = 0;
+    _deltaTicksLeft = _deltaTicksRight = 0;
+
+    _leftInches = _rightInches = _distanceInches = 0.0;
+    _theta = _sinTheta = _headingDegrees = 0.0;
+    _cosTheta = 1.0;
+    _xInches = _yInches = 0.0;
 }
 
 
@@ -36,15 +57,14 @@ void Position::handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs
     switch( pArgs->inputBuffer[1] ) {
         case 'R' : // Reset to 0,0
             if ( pArgs->nParams[ 0 ] == 9 ) {
-                if ( _messageMask & MM_RESPONSES ) {
-                    Serial.println( F( "Position reset to zero" ) );
+                IF_MASK( MM_RESPONSES ) {
+                    SerialTx.println( F( "Position reset to zero" ) );
                 }
                 
-                _currentEncoderPositionLeft = 0;
-                _currentEncoderPositionRight = 0;
+                reset();
             }
             else {
-                Serial.println( F( "Enter \"PR 9\" to reset" ) );
+                SerialTx.println( F( "Enter \"PR 9\" to reset" ) );
             }
             break;
     }
@@ -53,9 +73,26 @@ void Position::handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs
 
 void Position::handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams )
 {
-    // first, we compute our current position (x, y, theta)
-    float dLeftInches = _currentEncoderPositionLeft / _EncoderTicksPerInch - _leftInches;
-    float dRightInches = _currentEncoderPositionRight / _EncoderTicksPerInch - _rightInches;
+    // snapshot the encoders, so everyone works from the same readings.  The interrupt handlers
+    // update them, and a 32-bit read isn't atomic on the AVR.
+    noInterrupts();
+    int32_t left = _currentEncoderPositionLeft;
+    int32_t right = _currentEncoderPositionRight;
+    interrupts();
+
+    // everything downstream works from this reading, so time the reaction from here
+    pSubsumptionParams->Stamp( eLatencySnapshot, micros() );
+
+    // subtract modulo 2^32, so we're right even if the counts wrap
+    _deltaTicksLeft = (int32_t) ( (uint32_t) left - (uint32_t) _snapshotPositionLeft );
+    _deltaTicksRight = (int32_t) ( (uint32_t) right - (uint32_t) _snapshotPositionRight );
+    _snapshotPositionLeft = left;
+    _snapshotPositionRight = right;
+
+    // first, we compute our current position (x, y, theta).  Working from the deltas keeps us
+    // right when the encoders count backward through 0.
+    float dLeftInches = _deltaTicksLeft / _EncoderTicksPerInch;
+    float dRightInches = _deltaTicksRight / _EncoderTicksPerInch;
     float dDistanceInches = (dLeftInches + dRightInches) / 2.0;
 
     _leftInches      += dLeftInches;
@@ -63,10 +100,14 @@ void Position::handleSubsumptionEvent( EventNotification* pEvent, SubsumptionPar
     _distanceInches  += dDistanceInches;
 
     _theta           = (_leftInches - _rightInches) / _WheelSpacingInches;
-    _xInches         += dDistanceInches * sin( _theta );
-    _yInches         += dDistanceInches * cos( _theta );
+    _sinTheta        = sin( _theta );
+    _cosTheta        = cos( _theta );
+    _xInches         += dDistanceInches * _sinTheta;
+    _yInches         += dDistanceInches * _cosTheta;
     _headingDegrees  = _theta * (180.0 / PI);
 
+    TRACE_COUNTER( "Pose", "x", _xInches, "y", _yInches, "heading", _headingDegrees );
+
     IF_MASK( MM_PROGRESS ) {
         PRINT_VAR( _currentEncoderPositionLeft );
         PRINT_VAR( _currentEncoderPositionRight );
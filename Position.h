@@ -31,41 +31,50 @@ Subsumption Architecture as described by David P. Anderson.
 /// snapshot, to minimize skew caused by sampling at different times.
 class Position : public Behavior
 {
-    friend class LEDDriver;
+    friend class DrivePlant;
 
     float   _EncoderTicksPerInch;
     float   _WheelSpacingInches;
 
+    void    reset();
+
 public:
 
     // leftPosition and rightPosition are 
     // for use by the global interrupt handlers which update these members.
     Position( CommandDispatcher* pCD, Director* pD, 
-        uint32_t*& leftPosition, uint32_t*& rightPosition,  // pointers to _currentEncoderPositionLeft and _currentEncoderPositionRight
+        int32_t*& leftPosition, int32_t*& rightPosition,  // pointers to _currentEncoderPositionLeft and _currentEncoderPositionRight
         float ticksPerInch, float wheelSpacing );
 
 protected:
     /// these are the raw encoder positions, updated directly by the encoder interrupt handlers
-    uint32_t    _currentEncoderPositionLeft;
-    uint32_t    _currentEncoderPositionRight;
+    int32_t     _currentEncoderPositionLeft;
+    int32_t     _currentEncoderPositionRight;
 
 public:
     /// encoder positions are captured here
-    uint32_t    _snapshotPositionLeft;
-    uint32_t    _snapshotPositionRight;
+    int32_t     _snapshotPositionLeft;
+    int32_t     _snapshotPositionRight;
 
-    /// these are the values used by CruiseControl for PID calculations
+    /// these are the values used by CruiseControl for PID calculations:  encoder ticks in the last interval
+    int16_t     _deltaTicksLeft;
+    int16_t     _deltaTicksRight;
 
     /// these values are used by Navigator for heading control
     float _leftInches;         // distance travelled by left and right wheels
     float _rightInches;
     float _distanceInches;     // distance travelled by the robot (center)
     float _theta;              // current angle (in radians)
+    float _sinTheta;           // sine and cosine of _theta, kept for anyone else who needs them
+    float _cosTheta;
     float _xInches;            // x-coordinate
     float _yInches;            // y-coordinate
     float _headingDegrees;     // current heading in degrees
 
 
+    float               GetTicksPerInch()       { return _EncoderTicksPerInch; }
+    float               GetWheelSpacing()       { return _WheelSpacingInches; }
+
     virtual void        handleCommandEvent( EventNotification* pEvent, CommandArgs* pArgs );
     virtual void        handleSubsumptionEvent( EventNotification* pEvent, SubsumptionParams* pSubsumptionParams );
 };
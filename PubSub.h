@@ -51,6 +51,13 @@ class Publisher
 {
 public:
 
+    Publisher() : _pFirstSubscriber( NULL )
+    {
+        _notification.pPublisher = this;
+        _notification.eventID = 0;
+        _notification.pData = NULL;
+    }
+
     // this is the event we will publish
     EventNotification _notification;
 
@@ -0,0 +1,77 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#include <RangeSensor.h>
+#include <Position.h>
+#include <OccupancyGrid.h>
+
+AnalogRangeSensor::AnalogRangeSensor( uint8_t pin, float scale, int offset, int minCounts ) :
+    _pin( pin ), _scale( scale ), _offset( offset ), _minCounts( minCounts )
+{
+    pinMode( _pin, INPUT );
+}
+
+
+float AnalogRangeSensor::ReadInches()
+{
+    int counts = analogRead( _pin );
+    return ( counts < _minCounts || counts <= _offset ) ? RANGE_NONE : _scale / ( counts - _offset );
+}
+
+
+// sound travels about 74 microseconds per inch, and the echo makes the round trip
+#define ECHO_MICROS_PER_INCH    148
+
+EchoRangeSensor::EchoRangeSensor( uint8_t triggerPin, uint8_t echoPin, float maxInches ) :
+    _triggerPin( triggerPin ), _echoPin( echoPin )
+{
+    _timeoutMicros = maxInches * ECHO_MICROS_PER_INCH;
+
+    pinMode( _triggerPin, OUTPUT );
+    pinMode( _echoPin, INPUT );
+    digitalWrite( _triggerPin, LOW );
+}
+
+
+float EchoRangeSensor::ReadInches()
+{
+    digitalWrite( _triggerPin, HIGH );
+    delayMicroseconds( 10 );
+    digitalWrite( _triggerPin, LOW );
+
+    unsigned long echoMicros = pulseIn( _echoPin, HIGH, _timeoutMicros );
+    return echoMicros ? (float) echoMicros / ECHO_MICROS_PER_INCH : RANGE_NONE;
+}
+
+
+SimRangeSensor::SimRangeSensor( Position* pPos, OccupancyGrid* pGrid, float maxInches ) :
+    _pPosition( pPos ), _pGrid( pGrid ), _maxInches( maxInches ), _forcedInches( RANGE_NONE )
+{
+}
+
+
+float SimRangeSensor::ReadInches()
+{
+    if ( _forcedInches >= 0.0 ) {
+        return _forcedInches;
+    }
+
+    // step half a cell at a time, so we can't skip over a cell
+    float step = _pGrid->GetCellInches() / 2;
+    for ( float range = step; range <= _maxInches; range += step ) {
+        int col, row;
+        _pGrid->WorldToCell( _pPosition->_xInches + range * _pPosition->_sinTheta,
+                             _pPosition->_yInches + range * _pPosition->_cosTheta, col, row );
+        if ( _pGrid->IsBlocked( col, row ) ) {
+            return range;
+        }
+    }
+    return RANGE_NONE;
+}
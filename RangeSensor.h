@@ -0,0 +1,85 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+#include "CommonDefs.h"
+
+class Position;
+class OccupancyGrid;
+
+// RangeSensor is the base class for forward-looking distance sensors.  ReadInches() takes one
+// reading, returning RANGE_NONE if there is nothing in range (or the reading failed).
+// Filtering is left to the consumer.
+#define RANGE_NONE      -1.0
+
+class RangeSensor
+{
+public:
+
+    virtual float   ReadInches() = 0;
+
+    // force the reading for testing from the console, or RANGE_NONE to stop forcing.
+    // Only the simulated sensor pays attention.
+    virtual void    Simulate( float inches ) {}
+};
+
+
+// Analog sensors in the style of the Sharp IR rangers, whose output voltage is roughly inversely
+// proportional to distance:  inches = scale / ( counts - offset ).  Readings below minCounts
+// are out of range.
+class AnalogRangeSensor : public RangeSensor
+{
+    uint8_t     _pin;
+    float       _scale;
+    int         _offset;
+    int         _minCounts;
+
+public:
+
+    AnalogRangeSensor( uint8_t pin, float scale, int offset, int minCounts );
+
+    virtual float   ReadInches();
+};
+
+
+// Ultrasonic echo-time sensors (HC-SR04 and friends).  Note that a reading waits for the echo,
+// so the time taken is proportional to range, up to the timeout for maxInches.
+class EchoRangeSensor : public RangeSensor
+{
+    uint8_t         _triggerPin;
+    uint8_t         _echoPin;
+    unsigned long   _timeoutMicros;
+
+public:
+
+    EchoRangeSensor( uint8_t triggerPin, uint8_t echoPin, float maxInches );
+
+    virtual float   ReadInches();
+};
+
+
+// Simulated sensor for emulators and the host build.  Range is found by stepping along our
+// heading through the OccupancyGrid until a blocked cell is found, so obstacles marked on the
+// map show up on the sensor as we approach them.  Simulate() overrides the reading.
+class SimRangeSensor : public RangeSensor
+{
+    Position*       _pPosition;
+    OccupancyGrid*  _pGrid;
+    float           _maxInches;
+    float           _forcedInches;
+
+public:
+
+    SimRangeSensor( Position* pPos, OccupancyGrid* pGrid, float maxInches );
+
+    virtual float   ReadInches();
+    virtual void    Simulate( float inches )    { _forcedInches = inches; }
+};
@@ -0,0 +1,85 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+// host builds only
+#ifndef ARDUINO
+
+#include <RobotContext.h>
+#include <atomic>
+#include <chrono>
+
+thread_local RobotContext* RobotContext::_pCurrent = NULL;
+
+static std::atomic<uint32_t> _nextId( 1 );
+
+// the real clock starts when the program does, as it would at reset
+static const std::chrono::steady_clock::time_point _startTime = std::chrono::steady_clock::now();
+
+
+RobotContext::RobotContext( bool bMakeCurrent ) : _bSimulatedClock( false ), _clockMicros( 0 ),
+                                                  pEncoderLeft( NULL ), pEncoderRight( NULL ), randomState( 1 ), pInterruptBumper( NULL ),
+                                                  id( _nextId++ )
+{
+    pTx = new TxRing( &serial );
+    pConsole = new LineFormatter( pTx );
+
+    memset( pinLevel, 0, sizeof( pinLevel ) );
+    memset( pinISR, 0, sizeof( pinISR ) );
+    memset( pinISRMode, 0, sizeof( pinISRMode ) );
+
+    if ( bMakeCurrent ) {
+        MakeCurrent();
+    }
+}
+
+
+RobotContext::~RobotContext()
+{
+    if ( _pCurrent == this ) {
+        _pCurrent = NULL;
+    }
+    delete pConsole;
+    delete pTx;
+}
+
+
+// the thread's own, for programs which don't make one
+RobotContext* RobotContext::threadContext()
+{
+    static thread_local RobotContext context;
+    return &context;
+}
+
+
+void RobotContext::UseSimulatedClock( unsigned long startMicros )
+{
+    _bSimulatedClock = true;
+    _clockMicros = startMicros;
+}
+
+
+unsigned long RobotContext::Millis()
+{
+    if ( _bSimulatedClock ) {
+        return _clockMicros / 1000;
+    }
+    return std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - _startTime ).count();
+}
+
+
+unsigned long RobotContext::Micros()
+{
+    if ( _bSimulatedClock ) {
+        return _clockMicros;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - _startTime ).count();
+}
+
+#endif
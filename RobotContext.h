@@ -0,0 +1,94 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+// host builds only;  on the robot, there's one of everything
+#ifndef ARDUINO
+
+#include <CommonDefs.h>
+
+class BumperInput;
+class TxRing;
+class LineFormatter;
+
+
+// RobotContext
+//
+// On the robot, the console, the clock, the pins and their interrupt handlers are each one of a
+// kind, and the library uses them as globals.  On the host, they're per robot:  a RobotContext
+// holds everything a simulated robot would otherwise share with the rest of the process, and
+// Serial, SerialTx and ConsoleLine, millis() and micros(), random(), the pins and attachInterrupt()
+// all go to the context which is current on the calling thread.  So one thread can run any number
+// of robots, one after another, by making each one's context current before working with it, and
+// a pool of threads can share out thousands of them.  A context belongs to one thread at a time,
+// but it can move between threads.
+//
+// A thread which never makes a context current has one of its own, so a program with a robot
+// per thread needn't bother with any of this.
+//
+// The clock is the host's, from the start of the program, unless UseSimulatedClock() is called;
+// then it only moves when AdvanceClock() (or delay()) moves it, so a simulation runs as fast as
+// the CPU allows and gets the same readings every time.
+class RobotContext
+{
+    static thread_local RobotContext*   _pCurrent;
+
+    bool            _bSimulatedClock;
+    uint64_t        _clockMicros;
+
+    static RobotContext*    threadContext();
+
+public:
+
+    // the console.  CommonDefs.h includes this before TxRing and LineFormatter are complete, so
+    // those two are made by the constructor.
+    HostSerial      serial;
+    TxRing*         pTx;
+    LineFormatter*  pConsole;
+
+    // the encoder counts, for handlers driven through the pins:  Position fills these in, as it
+    // does the sketch's _pEncoderPositionLeft and _pEncoderPositionRight
+    int32_t*        pEncoderLeft;
+    int32_t*        pEncoderRight;
+
+    // HostDuino's pins and random() state, and the bumper which has the interrupts
+    uint8_t         pinLevel[ HOST_PINS ];
+    void            ( *pinISR[ HOST_PINS ] )( void );
+    uint8_t         pinISRMode[ HOST_PINS ];
+    uint32_t        randomState;
+    BumperInput*    pInterruptBumper;
+
+    // a number of its own, never reused, so a trace can tell robots (and missions) apart
+    const uint32_t  id;
+
+    // bMakeCurrent makes the new context current right away, so the objects of a robot built
+    // after it (SimRobot, say) find their console and pins there as they're constructed
+    RobotContext( bool bMakeCurrent = false );
+    ~RobotContext();
+
+    void            MakeCurrent()           { _pCurrent = this; }
+    static RobotContext*    Current()       { return _pCurrent ? _pCurrent : threadContext(); }
+
+    void            UseSimulatedClock( unsigned long startMicros = 0 );
+    void            UseRealClock()          { _bSimulatedClock = false; }
+    bool            IsClockSimulated()      { return _bSimulatedClock; }
+    void            AdvanceClock( unsigned long us )    { _clockMicros += us; }
+
+    unsigned long   Millis();
+    unsigned long   Micros();
+};
+
+// each simulated robot has its own console
+#define Serial          ( RobotContext::Current()->serial )
+#define SerialTx        ( *RobotContext::Current()->pTx )
+#define ConsoleLine     ( *RobotContext::Current()->pConsole )
+
+#endif
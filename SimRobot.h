@@ -0,0 +1,109 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+// SimRobot is for host programs:  the sweep, the console, and whatever else wants a whole robot
+// with DrivePlant standing in for the hardware.
+#ifndef ARDUINO
+
+#include <CommonDefs.h>
+#include <CommandDispatcher.h>
+#include <CruiseControl.h>
+#include <WaypointManager.h>
+#include <RangeSensor.h>
+#include <CollisionAvoidance.h>
+#include <CollisionRecovery.h>
+#include <Position.h>
+#include <Director.h>
+#include <Navigator.h>
+#include <OccupancyGrid.h>
+#include <PathPlanner.h>
+#include <ObstacleMapper.h>
+#include <LEDDriver.h>
+#include <DrivePlant.h>
+
+// Platform geometry, as in PubSubsumptionTest
+#define WHEEL_DIAMETER                  2.5
+#define WHEEL_SPACING                   7.25
+#define ENCODER_TICKS_PER_REVOLUTION    333
+
+// the bumper switches' (simulated) pins, as on the sketch's Pro Mini, so BP works through them
+#define SIM_BUMPER_LEFT_PIN             15
+#define SIM_BUMPER_RIGHT_PIN            16
+
+// One simulated robot, wired up as in PubSubsumptionTest.  These are big (the WaypointManager and
+// the planner size themselves for a PC), so make them with new.
+//
+// Each has its own RobotContext:  its console, clock and pins.  The constructor leaves it current;
+// when a thread has more than one robot, call context.MakeCurrent() before working with each.
+class SimRobot
+{
+public:
+
+    RobotContext        context;    // first, so it's current while the rest are built
+    CommandDispatcher   dispatcher;
+    Director            director;
+    WaypointManager     waypoints;
+    Position            position;
+    LEDDriver           led;
+    DrivePlant          plant;
+    Navigator           navigator;
+    OccupancyGrid       obstacleMap;
+    PathPlanner         planner;
+    SimRangeSensor      rangeSensor;
+    CollisionAvoidance  avoidance;
+    CollisionRecovery   bumper;
+    BallisticStep       recoverySteps[ RECOVERY_EDIT_STEPS ];
+    ObstacleMapper      mapper;
+    CruiseControl       cruise;
+
+    SimRobot( uint16_t interval ) :
+        context( true ),
+        director( &dispatcher, interval ),
+        waypoints( &dispatcher ),
+        position( &dispatcher, &director, context.pEncoderLeft, context.pEncoderRight, TicksPerInch( ENCODER_TICKS_PER_REVOLUTION, WHEEL_DIAMETER ), WHEEL_SPACING ),
+        led( 10, 9, 14, 5, &dispatcher ),
+        plant( &dispatcher, &position ),
+        navigator( &dispatcher, &position, &waypoints ),
+        planner( &dispatcher, &position, &waypoints, &navigator, &obstacleMap ),
+        rangeSensor( &position, &obstacleMap, 48 ),
+        avoidance( &dispatcher, &rangeSensor ),
+        bumper( &dispatcher, &director, &position, SIM_BUMPER_LEFT_PIN, SIM_BUMPER_RIGHT_PIN ),
+        mapper( &dispatcher, &position, &bumper, &obstacleMap ),
+        cruise( &dispatcher, &position )
+    {
+        bumper.Begin();
+        bumper.SetEditBuffer( recoverySteps, RECOVERY_EDIT_STEPS );
+
+        // subscribe in reverse priority order, as in the sketch
+        plant.DriveFrom( led.GetOutput() );
+        plant.SubscribeTo( &director );
+        led.SubscribeTo( &director );
+        cruise.SubscribeTo( &director );
+        navigator.SubscribeTo( &director );
+        planner.SubscribeTo( &director );
+        avoidance.SubscribeTo( &director );
+        bumper.SubscribeTo( &director );
+        mapper.SubscribeTo( &director );
+        position.SubscribeTo( &director );
+    }
+
+    // the default mission:  a 4-foot square, back to where we started
+    void AppendSquare()
+    {
+        waypoints.AppendWaypoint( 0, 48, 2 );
+        waypoints.AppendWaypoint( 48, 48, 2 );
+        waypoints.AppendWaypoint( 48, 0, 2 );
+        waypoints.AppendWaypoint( 0, 0, 2 );
+    }
+};
+
+#endif
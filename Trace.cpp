@@ -0,0 +1,354 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+// host builds only
+#ifndef ARDUINO
+
+#include <Trace.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#define TRACE_CHUNK_EVENTS  4096
+#define TRACE_MAX_ARGS      3
+
+struct TraceEvent
+{
+    uint64_t        ns;             // since TraceStart()
+    uint32_t        pid;            // the robot's RobotContext
+    char            phase;          // B, E, i or C, as in the trace format
+    const char*     pName;
+    const char*     pKeys[ TRACE_MAX_ARGS ];
+    double          values[ TRACE_MAX_ARGS ];
+    const char*     pText;          // an instant's argument
+};
+
+struct TraceChunk
+{
+    TraceChunk*     pNext;          // in the list of full chunks, or of spares
+    uint32_t        tid;
+    uint32_t        nEvents;
+    TraceEvent      events[ TRACE_CHUNK_EVENTS ];
+};
+
+class TraceThread;
+
+
+std::atomic<bool>                       _bTraceEnabled( false );
+
+// everything below is shared with the writer, under _traceMutex
+static std::mutex                       _traceMutex;
+static std::condition_variable          _writerWake;
+static TraceChunk*                      _pFullHead = NULL;      // oldest first
+static TraceChunk*                      _pFullTail = NULL;
+static TraceChunk*                      _pSpareChunks = NULL;
+static TraceThread*                     _pThreads = NULL;       // every thread which has traced
+static uint32_t                         _nextTid = 1;
+static bool                             _bWriterRunning = false;
+
+static std::thread                      _writer;
+static FILE*                            _pTraceFile = NULL;
+static bool                             _bFirstEvent = true;
+static std::chrono::steady_clock::time_point _traceStart;
+
+
+// give a chunk to the writer, or back to the spares if there's nothing in it.  Under the lock.
+static void handOver( TraceChunk* pChunk )
+{
+    if ( ! pChunk->nEvents || ! _bWriterRunning ) {
+        pChunk->pNext = _pSpareChunks;
+        _pSpareChunks = pChunk;
+        return;
+    }
+
+    pChunk->pNext = NULL;
+    if ( _pFullTail ) {
+        _pFullTail->pNext = pChunk;
+    }
+    else {
+        _pFullHead = pChunk;
+    }
+    _pFullTail = pChunk;
+    _writerWake.notify_one();
+}
+
+
+// each thread fills its own chunk, and swaps it for a spare when it's full
+class TraceThread
+{
+    TraceChunk*     _pChunk;
+    uint32_t        _tid;
+    TraceThread*    _pNext;         // in _pThreads
+    TraceThread*    _pPrev;
+
+    void nextChunk()
+    {
+        TraceChunk* pChunk = NULL;
+        {
+            std::lock_guard<std::mutex> lock( _traceMutex );
+            if ( _pChunk ) {
+                handOver( _pChunk );
+            }
+            if ( _pSpareChunks ) {
+                pChunk = _pSpareChunks;
+                _pSpareChunks = pChunk->pNext;
+            }
+        }
+        if ( ! pChunk ) {
+            pChunk = new TraceChunk;    // the writer's behind, and the spares are all in its queue
+        }
+        pChunk->tid = _tid;
+        pChunk->nEvents = 0;
+        _pChunk = pChunk;
+    }
+
+public:
+
+    TraceThread() : _pChunk( NULL ), _pPrev( NULL )
+    {
+        std::lock_guard<std::mutex> lock( _traceMutex );
+        _tid = _nextTid++;
+        _pNext = _pThreads;
+        if ( _pNext ) {
+            _pNext->_pPrev = this;
+        }
+        _pThreads = this;
+    }
+
+    ~TraceThread()
+    {
+        std::lock_guard<std::mutex> lock( _traceMutex );
+        FlushLocked();
+        if ( _pPrev ) {
+            _pPrev->_pNext = _pNext;
+        }
+        else {
+            _pThreads = _pNext;
+        }
+        if ( _pNext ) {
+            _pNext->_pPrev = _pPrev;
+        }
+    }
+
+    TraceEvent* Next( char phase, const char* pName )
+    {
+        if ( ! _pChunk || _pChunk->nEvents == TRACE_CHUNK_EVENTS ) {
+            nextChunk();
+        }
+
+        TraceEvent* pEvent = &_pChunk->events[ _pChunk->nEvents++ ];
+        pEvent->ns = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - _traceStart ).count();
+        pEvent->pid = RobotContext::Current()->id;
+        pEvent->phase = phase;
+        pEvent->pName = pName;
+        pEvent->pKeys[ 0 ] = pEvent->pKeys[ 1 ] = pEvent->pKeys[ 2 ] = NULL;
+        pEvent->pText = NULL;
+        return pEvent;
+    }
+
+    // hand over the partial chunk.  Under the lock.
+    void FlushLocked()
+    {
+        if ( _pChunk ) {
+            handOver( _pChunk );
+            _pChunk = NULL;
+        }
+    }
+
+    TraceThread* GetNext()          { return _pNext; }
+};
+
+static thread_local TraceThread _traceThread;
+
+
+// names are ours or the Behaviors', but quote anything JSON wouldn't like, just in case
+static void writeString( const char* pStr )
+{
+    fputc( '"', _pTraceFile );
+    for ( ; pStr && *pStr; pStr++ ) {
+        if ( *pStr == '"' || *pStr == '\\' ) {
+            fputc( '\\', _pTraceFile );
+        }
+        fputc( (unsigned char) *pStr < ' ' ? ' ' : *pStr, _pTraceFile );
+    }
+    fputc( '"', _pTraceFile );
+}
+
+
+static void writeEvent( const TraceEvent& event, uint32_t tid )
+{
+    fputs( _bFirstEvent ? "\n" : ",\n", _pTraceFile );
+    _bFirstEvent = false;
+
+    // each robot is its own process, so it gets its own counter tracks, whichever thread ran it
+    fprintf( _pTraceFile, "{\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%u,\"tid\":%u", event.phase, event.ns / 1000.0, event.pid, tid );
+    if ( event.pName ) {
+        fputs( ",\"name\":", _pTraceFile );
+        writeString( event.pName );
+    }
+    if ( event.phase == 'i' ) {
+        fputs( ",\"s\":\"t\"", _pTraceFile );
+    }
+
+    if ( event.pKeys[ 0 ] ) {
+        fputs( ",\"args\":{", _pTraceFile );
+        writeString( event.pKeys[ 0 ] );
+        if ( event.pText ) {
+            fputc( ':', _pTraceFile );
+            writeString( event.pText );
+        }
+        else {
+            fprintf( _pTraceFile, ":%.9g", event.values[ 0 ] );
+            for ( int ix = 1; ix < TRACE_MAX_ARGS && event.pKeys[ ix ]; ix++ ) {
+                fputc( ',', _pTraceFile );
+                writeString( event.pKeys[ ix ] );
+                fprintf( _pTraceFile, ":%.9g", event.values[ ix ] );
+            }
+        }
+        fputc( '}', _pTraceFile );
+    }
+    fputc( '}', _pTraceFile );
+}
+
+
+// write out chunks as they're handed over, until TraceStop() says there'll be no more
+static void writerLoop()
+{
+    std::unique_lock<std::mutex> lock( _traceMutex );
+    for ( ;; ) {
+        _writerWake.wait( lock, []() { return _pFullHead || ! _bWriterRunning; } );
+        if ( ! _pFullHead ) {
+            return;
+        }
+
+        TraceChunk* pChunks = _pFullHead;
+        _pFullHead = _pFullTail = NULL;
+        lock.unlock();
+
+        TraceChunk* pLast = NULL;
+        for ( TraceChunk* pChunk = pChunks; pChunk; pChunk = pChunk->pNext ) {
+            for ( uint32_t ix = 0; ix < pChunk->nEvents; ix++ ) {
+                writeEvent( pChunk->events[ ix ], pChunk->tid );
+            }
+            pLast = pChunk;
+        }
+
+        // and they're spares again
+        lock.lock();
+        pLast->pNext = _pSpareChunks;
+        _pSpareChunks = pChunks;
+    }
+}
+
+
+bool TraceStart( const char* pPath )
+{
+    std::lock_guard<std::mutex> lock( _traceMutex );
+    if ( _bWriterRunning ) {
+        return false;
+    }
+
+    _pTraceFile = fopen( pPath, "w" );
+    if ( ! _pTraceFile ) {
+        return false;
+    }
+    fputs( "[", _pTraceFile );
+    _bFirstEvent = true;
+    _traceStart = std::chrono::steady_clock::now();
+
+    // a chunk for each core to be filling and one more, touched now so the simulation doesn't
+    // take the page faults
+    for ( unsigned n = std::thread::hardware_concurrency() + 1; n; n-- ) {
+        TraceChunk* pChunk = new TraceChunk;
+        memset( pChunk, 0, sizeof( TraceChunk ) );
+        pChunk->pNext = _pSpareChunks;
+        _pSpareChunks = pChunk;
+    }
+
+    _bWriterRunning = true;
+    _writer = std::thread( writerLoop );
+
+    _bTraceEnabled = true;
+    return true;
+}
+
+
+void TraceFlush()
+{
+    std::lock_guard<std::mutex> lock( _traceMutex );
+    _traceThread.FlushLocked();
+}
+
+
+void TraceStop()
+{
+    {
+        std::lock_guard<std::mutex> lock( _traceMutex );
+        if ( ! _bWriterRunning ) {
+            return;
+        }
+        _bTraceEnabled = false;
+
+        // every thread's partial chunk, not just ours
+        for ( TraceThread* pThread = _pThreads; pThread; pThread = pThread->GetNext() ) {
+            pThread->FlushLocked();
+        }
+        _bWriterRunning = false;
+        _writerWake.notify_one();
+    }
+    _writer.join();
+
+    fputs( "\n]\n", _pTraceFile );
+    fclose( _pTraceFile );
+    _pTraceFile = NULL;
+
+    while ( _pSpareChunks ) {
+        TraceChunk* pNext = _pSpareChunks->pNext;
+        delete _pSpareChunks;
+        _pSpareChunks = pNext;
+    }
+}
+
+
+void TraceBegin( const char* pName, const char* pKey, double value )
+{
+    TraceEvent* pEvent = _traceThread.Next( 'B', pName );
+    pEvent->pKeys[ 0 ] = pKey;
+    pEvent->values[ 0 ] = value;
+}
+
+
+void TraceEnd()
+{
+    _traceThread.Next( 'E', NULL );
+}
+
+
+void TraceInstant( const char* pName, const char* pKey, const char* pText )
+{
+    TraceEvent* pEvent = _traceThread.Next( 'i', pName );
+    pEvent->pKeys[ 0 ] = pKey;
+    pEvent->pText = pText;
+}
+
+
+void TraceCounter( const char* pName, const char* pKey1, double value1, const char* pKey2, double value2, const char* pKey3, double value3 )
+{
+    TraceEvent* pEvent = _traceThread.Next( 'C', pName );
+    pEvent->pKeys[ 0 ] = pKey1;
+    pEvent->values[ 0 ] = value1;
+    pEvent->pKeys[ 1 ] = pKey2;
+    pEvent->values[ 1 ] = value2;
+    pEvent->pKeys[ 2 ] = pKey3;
+    pEvent->values[ 2 ] = value3;
+}
+
+#endif
@@ -0,0 +1,72 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+#include <CommonDefs.h>
+
+// Tracing
+//
+// On the host, the Director ticks, each Behavior's part in them, changes of control, and the
+// throttles and pose can be written to a file in the Chrome trace event (JSON) format, to be
+// opened in chrome://tracing or Perfetto.  Each Director tick is a span, with the Behaviors'
+// HandleEvent() spans nested inside it.  Each robot (each RobotContext) shows up as its own
+// process, with the threads that ran it inside, so robots sharing a thread, or one mission after
+// another on a worker, keep their own counter tracks.
+//
+// Events go into a buffer per thread, with no locking.  Full buffers are handed to a writer
+// thread, which a condition variable wakes, and the writer does the formatting and the file
+// writes, so the simulation only pays for filling in a record (and for taking a lock once every
+// few thousand).  Written buffers go back on a list of spares, which TraceStart() fills up front,
+// so they aren't allocated as the simulation runs.  TraceStop() hands over every thread's partial
+// buffer, so the other threads needn't have ended, but they must have stopped tracing:  finished
+// their work, or be waiting on the thread which calls it.
+//
+// Names are kept as pointers, so they must outlive the trace:  string literals, or Behavior names.
+//
+// On the robot, there's no file to write, and the TRACE_ macros compile to nothing.
+
+#ifdef ARDUINO
+
+#define TRACE_BEGIN( ... )
+#define TRACE_END()
+#define TRACE_INSTANT( ... )
+#define TRACE_COUNTER( ... )
+
+#else
+
+#include <atomic>
+
+extern std::atomic<bool>    _bTraceEnabled;
+
+inline bool     TraceEnabled()  { return _bTraceEnabled.load( std::memory_order_relaxed ); }
+
+// start writing events to the file at pPath, returning false if it can't be opened
+bool            TraceStart( const char* pPath );
+
+// hand over this thread's events so far
+void            TraceFlush();
+
+// hand over every thread's events, write them out, and close the file
+void            TraceStop();
+
+void            TraceBegin( const char* pName, const char* pKey = NULL, double value = 0.0 );
+void            TraceEnd();
+void            TraceInstant( const char* pName, const char* pKey, const char* pText );
+void            TraceCounter( const char* pName, const char* pKey1, double value1,
+                              const char* pKey2 = NULL, double value2 = 0.0,
+                              const char* pKey3 = NULL, double value3 = 0.0 );
+
+#define TRACE_BEGIN( ... )      do { if ( TraceEnabled() ) TraceBegin( __VA_ARGS__ ); } while ( 0 )
+#define TRACE_END()             do { if ( TraceEnabled() ) TraceEnd(); } while ( 0 )
+#define TRACE_INSTANT( ... )    do { if ( TraceEnabled() ) TraceInstant( __VA_ARGS__ ); } while ( 0 )
+#define TRACE_COUNTER( ... )    do { if ( TraceEnabled() ) TraceCounter( __VA_ARGS__ ); } while ( 0 )
+
+#endif
@@ -0,0 +1,218 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#include <TxRing.h>
+
+#ifdef ARDUINO
+TxRing  SerialTx( &Serial );
+#endif
+
+// keep the compiler from moving the buffer writes past the index which publishes them
+#define TX_BARRIER()    __asm__ __volatile__( "" ::: "memory" )
+
+
+TxRing::TxRing( Print* pOutput ) : _pOutput( pOutput ), _lane( eTxResponse ), _drainLane( eTxResponse ), _bMidLine( false ), _bDraining( false )
+{
+    _lanes[ eTxResponse ].pBuffer = _responseBuffer;
+    _lanes[ eTxResponse ].size = TX_RESPONSE_SIZE;
+    _lanes[ eTxError ].pBuffer = _errorBuffer;
+    _lanes[ eTxError ].size = TX_ERROR_SIZE;
+    _lanes[ eTxTelemetry ].pBuffer = _telemetryBuffer;
+    _lanes[ eTxTelemetry ].size = TX_TELEMETRY_SIZE;
+
+    for ( uint8_t ix = 0; ix < eTxLanes; ix++ ) {
+        _lanes[ ix ].head = _lanes[ ix ].tail = 0;
+        _lanes[ ix ].bLineOpen = _lanes[ ix ].bDropping = false;
+    }
+    ClearStats();
+}
+
+
+void TxRing::ClearStats()
+{
+    for ( uint8_t ix = 0; ix < eTxLanes; ix++ ) {
+        _lanes[ ix ].peak = 0;
+        _lanes[ ix ].droppedLines = 0;
+        _lanes[ ix ].droppedBytes = 0;
+    }
+}
+
+
+void TxRing::append( Lane& lane, const uint8_t* pBuf, size_t n )
+{
+    TxIndex head = lane.head;
+    while ( n ) {
+        size_t chunk = min( n, (size_t) ( lane.size - head ) );
+        memcpy( lane.pBuffer + head, pBuf, chunk );
+        pBuf += chunk;
+        n -= chunk;
+        head = head + chunk == lane.size ? 0 : head + chunk;
+    }
+    TX_BARRIER();
+    lane.head = head;
+
+    lane.peak = max( lane.peak, used( lane ) );
+}
+
+
+size_t TxRing::write( const uint8_t* pBuf, size_t n )
+{
+    Lane& lane = _lanes[ _lane ];
+    size_t written = n;
+
+    if ( lane.bDropping ) {
+        // the start of this line is gone, so the rest of it goes too
+        const uint8_t* pEnd = (const uint8_t*) memchr( pBuf, '\n', n );
+        size_t skip = pEnd ? pEnd + 1 - pBuf : n;
+        lane.droppedBytes += skip;
+        lane.bDropping = ! pEnd;
+        pBuf += skip;
+        n -= skip;
+    }
+    if ( ! n ) {
+        return written;
+    }
+
+    // one byte is always free, to tell full from empty
+    size_t room = lane.size - 1 - used( lane );
+
+    if ( _lane == eTxTelemetry ) {
+        // and another is kept to end a line, if we have to drop the rest of it.  Before dropping
+        // anything, give the port what it can take now.
+        if ( n + 1 > room ) {
+            Drain();
+            room = lane.size - 1 - used( lane );
+        }
+        if ( n + 1 > room ) {
+            lane.droppedBytes += n;
+            lane.droppedLines++;
+            if ( lane.bLineOpen ) {
+                append( lane, (const uint8_t*) "\n", 1 );
+                lane.bLineOpen = false;
+            }
+            lane.bDropping = pBuf[ n - 1 ] != '\n';
+            return written;
+        }
+    }
+    else if ( n > room ) {
+        // too important to drop:  wait for the port, as Serial would have.  If that still doesn't
+        // make room, because the write is bigger than the lane, or because we're printing from an
+        // interrupt handler which came in during a drain, and so can't drain ourselves, go
+        // straight to the port rather than write over what's waiting.
+        Drain( true );
+        room = lane.size - 1 - used( lane );
+        if ( n > room ) {
+            if ( _pOutput ) {
+                _pOutput->write( pBuf, n );
+            }
+            return written;
+        }
+    }
+
+    append( lane, pBuf, n );
+    lane.bLineOpen = pBuf[ n - 1 ] != '\n';
+    return written;
+}
+
+
+// send from the lane, as much as there's room for, up to the end of a line
+size_t TxRing::drainLane( Lane& lane, size_t room )
+{
+    TxIndex tail = lane.tail;
+    size_t n = min( (size_t) used( lane ), min( room, (size_t) ( lane.size - tail ) ) );
+    const uint8_t* pStart = lane.pBuffer + tail;
+    const uint8_t* pEnd = (const uint8_t*) memchr( pStart, '\n', n );
+    if ( pEnd ) {
+        n = pEnd + 1 - pStart;
+    }
+
+    if ( _pOutput ) {
+        _pOutput->write( pStart, n );
+    }
+    _bMidLine = pStart[ n - 1 ] != '\n';
+
+    TX_BARRIER();
+    lane.tail = tail + n == lane.size ? 0 : tail + n;
+    return n;
+}
+
+
+void TxRing::drain( bool bBlocking )
+{
+    for ( ;; ) {
+        size_t room = ( bBlocking || ! _pOutput ) ? (size_t) -1 : (size_t) _pOutput->availableForWrite();
+        if ( ! room ) {
+            return;
+        }
+
+        // finish a line before starting on another lane, unless we can't wait for the rest of it,
+        // or it isn't coming, as its lane isn't being written
+        if ( ! _bMidLine || ( ( bBlocking || _drainLane != _lane ) && ! used( _lanes[ _drainLane ] ) ) ) {
+            _drainLane = eTxLanes;
+            for ( uint8_t ix = 0; ix < eTxLanes; ix++ ) {
+                if ( used( _lanes[ ix ] ) ) {
+                    _drainLane = ix;
+                    break;
+                }
+            }
+            if ( _drainLane == eTxLanes ) {
+                _drainLane = eTxResponse;
+                return;
+            }
+        }
+        else if ( ! used( _lanes[ _drainLane ] ) ) {
+            return;
+        }
+
+        drainLane( _lanes[ _drainLane ], room );
+    }
+}
+
+
+void TxRing::Drain( bool bBlocking )
+{
+    noInterrupts();
+    bool bBusy = _bDraining;
+    _bDraining = true;
+    interrupts();
+
+    if ( ! bBusy ) {
+        drain( bBlocking );
+        _bDraining = false;
+    }
+}
+
+
+void TxRing::DrainFromISR()
+{
+    if ( ! _bDraining ) {
+        _bDraining = true;
+        drain( false );
+        _bDraining = false;
+    }
+}
+
+
+void TxRing::PrintStats()
+{
+    ConsoleLine.println( F( " Console lane\tsize\tused\tpeak\tdropped lines\tbytes" ) );
+    for ( uint8_t ix = 0; ix < eTxLanes; ix++ ) {
+        Lane& lane = _lanes[ ix ];
+        ConsoleLine.print( F( "  " ) );
+        switch ( ix ) {
+            case eTxResponse :  ConsoleLine.print( F( "Response" ) );     break;
+            case eTxError :     ConsoleLine.print( F( "Error\t" ) );      break;
+            case eTxTelemetry : ConsoleLine.print( F( "Telemetry" ) );    break;
+        }
+        ConsoleLine.Format( F( "\t%u\t%u\t%u\t%u\t%lu\n" ), (unsigned) lane.size, (unsigned) used( lane ), (unsigned) lane.peak,
+                            lane.droppedLines, (unsigned long) lane.droppedBytes );
+        ConsoleLine.Flush();
+    }
+}
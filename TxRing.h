@@ -0,0 +1,122 @@
+/*
+This file is part of the PubSubsumption library, an implementation of the Subsumption
+Architecture based upon a simple Publisher/Subscriber mechanism.
+
+Copyright (C) 2014 Terry Crook
+
+Written by Terry Crook in collaboration with Clayton Dean, and based upon the
+Subsumption Architecture as described by David P. Anderson.
+*/
+
+#pragma once
+
+#include <CommonDefs.h>
+
+// the output lanes, highest priority first
+enum eTxLane
+{
+    eTxResponse,    // replies to commands
+    eTxError,       // things gone wrong
+    eTxTelemetry,   // anything printed during a tick:  progress, diagnostics and CSV
+    eTxLanes
+};
+
+// the ring indices are written by one side and read by the other, possibly in an interrupt
+// handler, so they're a size the processor reads in one go.  On the AVR, a lane is at most 255.
+#ifdef __AVR__
+typedef uint8_t     TxIndex;
+#else
+typedef uint16_t    TxIndex;
+#endif
+
+// lane sizes.  The robot has little RAM to spare;  the host can afford to buffer a lot more.
+// Responses and errors wait for room rather than being dropped, so those lanes can be small.
+// Telemetry needs room for a whole CSV row, which with every Behavior's columns on runs to about
+// 200 bytes, or every row is cut short;  255 is as big as a lane gets on the AVR.
+#ifndef TX_RESPONSE_SIZE
+#ifdef ARDUINO
+#define TX_RESPONSE_SIZE    64
+#define TX_ERROR_SIZE       32
+#define TX_TELEMETRY_SIZE   255
+#else
+#define TX_RESPONSE_SIZE    1024
+#define TX_ERROR_SIZE       256
+#define TX_TELEMETRY_SIZE   4096
+#endif
+#endif
+
+
+// TxRing
+//
+// TxRing stands between the library's printing and the serial port, so printing never waits on
+// the baud rate.  Output goes into a ring for the current lane (SetLane()), and Drain() moves
+// what the port can take without blocking, a line at a time, highest priority lane first.
+//
+// When the telemetry lane is full, the write is dropped, along with the rest of its line, and
+// counted, so a chatty Behavior costs some telemetry rather than control timing.  Responses and
+// errors aren't dropped:  if their lane is full, the rings are drained into the port, waiting as
+// Serial would have.
+//
+// Drain() is called after each tick and from CommandDispatcher::Update(), so loop() needn't do
+// anything more;  the port's own interrupt handler empties what Drain() gives it.  To keep the
+// port busy between those calls, an interrupt handler which doesn't print (a timer's, say) can
+// call DrainFromISR() as well.  Each ring has one writer and one reader, and a drain already in
+// progress is left to finish, so the two don't trip over each other.
+class TxRing : public Print
+{
+    struct Lane
+    {
+        uint8_t*            pBuffer;
+        TxIndex             size;
+        volatile TxIndex    head;       // written by the printing side
+        volatile TxIndex    tail;       // written by Drain()
+        bool                bLineOpen;  // the last byte in isn't a newline
+        bool                bDropping;  // dropping the rest of a line
+        TxIndex             peak;
+        uint16_t            droppedLines;
+        uint32_t            droppedBytes;
+    };
+
+    Print*          _pOutput;
+    Lane            _lanes[ eTxLanes ];
+    uint8_t         _lane;          // being written
+    uint8_t         _drainLane;     // being drained
+    bool            _bMidLine;      // _drainLane has sent part of a line
+    volatile bool   _bDraining;
+
+    uint8_t         _responseBuffer[ TX_RESPONSE_SIZE ];
+    uint8_t         _errorBuffer[ TX_ERROR_SIZE ];
+    uint8_t         _telemetryBuffer[ TX_TELEMETRY_SIZE ];
+
+    TxIndex         used( Lane& lane )      { TxIndex head = lane.head; TxIndex tail = lane.tail; return head >= tail ? head - tail : lane.size - tail + head; }
+    void            append( Lane& lane, const uint8_t* pBuf, size_t n );
+    size_t          drainLane( Lane& lane, size_t room );
+    void            drain( bool bBlocking );
+
+public:
+
+    TxRing( Print* pOutput );
+
+    void            SetOutput( Print* pOutput )     { Drain( true ); _pOutput = pOutput; }
+
+    // choose the lane for what's printed next, returning the one in use until now
+    uint8_t         SetLane( uint8_t lane )         { uint8_t previous = _lane; _lane = lane; return previous; }
+    uint8_t         GetLane()                       { return _lane; }
+
+    virtual size_t  write( uint8_t ch )             { return write( &ch, 1 ); }
+    virtual size_t  write( const uint8_t* pBuf, size_t n );
+    using Print::write;
+
+    // move what the port will take without waiting, or (bBlocking) everything
+    void            Drain( bool bBlocking = false );
+    void            DrainFromISR();
+
+    uint32_t        GetDroppedBytes( uint8_t lane )     { return _lanes[ lane ].droppedBytes; }
+    void            ClearStats();
+    void            PrintStats();
+};
+
+// on the host, each simulated robot has its own, in its RobotContext
+#ifdef ARDUINO
+extern TxRing       SerialTx;
+#endif
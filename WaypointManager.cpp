@@ -10,6 +10,32 @@ Subsumption Architecture as described by David P. Anderson.
 
 #include <WaypointManager.h>
 
+// wrap an angle difference into the range -PI .. PI
+static float normalizeRadians( float angle )
+{
+    return angle > PI ? angle - 2.0 * PI : ( angle <= -PI ? angle + 2.0 * PI : angle );
+}
+
+
+// from inches, and a unit vector's components, to what the leg cache holds
+#ifdef LEG_FIXED_POINT
+static LegDistance toLegDistance( float inches )    { return (LegDistance) ( inches * LEG_DISTANCE_SCALE + 0.5 ); }
+static LegUnit toLegUnit( float u )                 { return (LegUnit) ( u * LEG_UNIT_SCALE + ( u < 0.0 ? -0.5 : 0.5 ) ); }
+#else
+static LegDistance toLegDistance( float inches )    { return inches; }
+static LegUnit toLegUnit( float u )                 { return u; }
+#endif
+
+
+void Leg::set( float dx, float dy )
+{
+    float length = sqrt( dx * dx + dy * dy );
+    _length = toLegDistance( length );
+
+    // a zero-length leg has no direction of its own
+    _ux = length > 0.0 ? toLegUnit( dx / length ) : 0;
+    _uy = length > 0.0 ? toLegUnit( dy / length ) : 0;
+}
 
 WaypointManager::WaypointManager( CommandDispatcher* pCD ) : CommandSubscriber( pCD )
 {
@@ -17,84 +43,865 @@ WaypointManager::WaypointManager( CommandDispatcher* pCD ) : CommandSubscriber(
 
     SubscribeTo( pCD, 'W' );  // WaypointManager commands, of course!
 
-    _nextWaypoint = 0;
+    _pTrackedHandle = NULL;
+    _pMissionStore = NULL;
+    Clear();
+
     // set an initial "dummy" waypoint at the origin, so Navigator will have
     // something to initialize to.  Yes, there's probably a better way.
-    _waypoints[ _nextWaypoint++ ].Set( 0, 0, 10 );
+    AppendWaypoint( 0, 0, 10 );
+
+}
+
+WaypointManager::~WaypointManager()
+{
+}
+
+
+// empty the list, and put every slot back on the free list
+void WaypointManager::Clear()
+{
+    _bStreaming = false;
+    _streamGranted = 0;
+#if LEG_INDEX_BUCKETS
+    _index.Clear();
+#endif
+
+    for ( WaypointHandle h = 0; h < WAYPOINT_CAPACITY; h++ ) {
+        _next[ h ] = h + 1 < WAYPOINT_CAPACITY ? h + 1 : NO_WAYPOINT;
+        _prev[ h ] = FREE_SLOT;
+    }
+    _hFree = 0;
+    _hFirst = NO_WAYPOINT;
+    _hLast = NO_WAYPOINT;
+    _count = 0;
+    _bCumulativeStale = false;
+    _baseDistance = 0;
+
+    if ( _pTrackedHandle ) {
+        *_pTrackedHandle = NO_WAYPOINT;
+    }
+}
+
+
+// take a slot from the free list
+WaypointHandle WaypointManager::allocate( int x, int y, int radius )
+{
+    WaypointHandle h = _hFree;
+    if ( h != NO_WAYPOINT ) {
+        _hFree = _next[ h ];
+        _waypoints[ h ].Set( x, y, radius );
+        _count++;
+    }
+    return h;
+}
+
+
+// link h into the list ahead of hBefore, or at the end if hBefore is NO_WAYPOINT
+void WaypointManager::link( WaypointHandle h, WaypointHandle hBefore )
+{
+    WaypointHandle hAfter = hBefore == NO_WAYPOINT ? _hLast : _prev[ hBefore ];
+
+    _prev[ h ] = hAfter;
+    _next[ h ] = hBefore;
+
+    if ( hAfter == NO_WAYPOINT ) {
+        _hFirst = h;
+    }
+    else {
+        _next[ hAfter ] = h;
+    }
+
+    if ( hBefore == NO_WAYPOINT ) {
+        _hLast = h;
+    }
+    else {
+        _prev[ hBefore ] = h;
+    }
+}
+
+
+WaypointHandle WaypointManager::InsertWaypoint( WaypointHandle hBefore, int x, int y, int radius )
+{
+    if ( hBefore != NO_WAYPOINT && ! IsValid( hBefore ) ) {
+        return NO_WAYPOINT;
+    }
+
+    WaypointHandle h = allocate( x, y, radius );
+    if ( h != NO_WAYPOINT ) {
+        link( h, hBefore );
+
+        // only the new leg and the one following it change shape; the rest just move along the path
+        updateLeg( h );
+        if ( hBefore != NO_WAYPOINT ) {
+            updateLeg( hBefore );
+        }
+        updateCumulative( h );
+    }
+    return h;
+}
+
+
+bool WaypointManager::ModifyWaypoint( WaypointHandle h, int x, int y, int radius )
+{
+    if ( ! IsValid( h ) ) {
+        return false;
+    }
+
+    _waypoints[ h ].Set( x, y, radius );
+    updateLeg( h );
+    if ( _next[ h ] != NO_WAYPOINT ) {
+        updateLeg( _next[ h ] );
+    }
+    updateCumulative( h );
+    return true;
+}
+
+
+bool WaypointManager::DeleteWaypoint( WaypointHandle h )
+{
+    if ( ! IsValid( h ) ) {
+        return false;
+    }
+
+    WaypointHandle hNext = _next[ h ];
+    unlink( h );
+
+    if ( hNext != NO_WAYPOINT ) {
+        // the leg which used to start at the deleted Waypoint now starts at its predecessor
+        updateLeg( hNext );
+        updateCumulative( hNext );
+    }
+#ifndef LEG_FIXED_POINT
+    else if ( _hLast != NO_WAYPOINT ) {
+        // the predecessor is now last, so there's no turn at the end of its leg
+        _legs[ _hLast ]._turn = 0.0;
+    }
+#endif
+    return true;
+}
+
+
+// Drop the first Waypoint, as a stream moves on.  The leg ending at the next one still starts
+// where the dropped one was, so it's kept as it is, and so are the path distances:  the base just
+// moves up to the start of what's left.
+void WaypointManager::dropFirst()
+{
+    WaypointHandle h = _hFirst;
+    _baseDistance += _legs[ h ]._length;
+    unlink( h );
+}
+
+
+// take h out of the list, and put it back in the pool, leaving the legs to the caller
+void WaypointManager::unlink( WaypointHandle h )
+{
+    WaypointHandle hPrev = _prev[ h ];
+    WaypointHandle hNext = _next[ h ];
+
+    // every streamed Waypoint we drop makes room for another
+    if ( _bStreaming && ! _waypoints[ h ]._bPlanned ) {
+        _streamFreed++;
+        if ( _streamFreed >= _streamWindow / 2 ) {
+            grantCredit( _streamFreed );
+            _streamFreed = 0;
+        }
+    }
+
+#if LEG_INDEX_BUCKETS
+    _index.Remove( h );
+#endif
+
+    // unlink
+    if ( hPrev == NO_WAYPOINT ) {
+        _hFirst = hNext;
+    }
+    else {
+        _next[ hPrev ] = hNext;
+    }
+    if ( hNext == NO_WAYPOINT ) {
+        _hLast = hPrev;
+    }
+    else {
+        _prev[ hNext ] = hPrev;
+    }
+
+    // back to the free list
+    _prev[ h ] = FREE_SLOT;
+    _next[ h ] = _hFree;
+    _hFree = h;
+    _count--;
+
+    // don't leave our client pointing at a Waypoint which no longer exists
+    if ( _pTrackedHandle && *_pTrackedHandle == h ) {
+        *_pTrackedHandle = hNext;
+    }
+}
+
+
+WaypointHandle WaypointManager::Advance( WaypointHandle h )
+{
+    WaypointHandle hNext = Next( h );
+
+    if ( _bStreaming && IsValid( h ) ) {
+        while ( _hFirst != h ) {
+            dropFirst();
+        }
+    }
+    return hNext;
+}
+
+
+// start over with an empty list, and invite the sender to fill the window
+void WaypointManager::openStream( uint16_t window )
+{
+    Clear();
+
+    // leave room for the Waypoint we're heading away from, and for some planned ones
+    uint32_t maxWindow = min( WAYPOINT_CAPACITY * 2 / 3, 0xFFFF );
+    _streamWindow = window ? constrain( window, 2, maxWindow ) : maxWindow;
+    _streamCredit = 0;
+    _streamFreed = 0;
+    _streamReceived = 0;
+    _bStreaming = true;
+
+    grantCredit( _streamWindow );
+}
+
+
+void WaypointManager::pushStreamed( int x, int y, int radius )
+{
+    if ( ! _bStreaming ) {
+        SerialTx.println( F( "No stream open." ) );
+        return;
+    }
+
+    WaypointHandle h = _streamCredit ? AppendWaypoint( x, y, radius ) : NO_WAYPOINT;
+    if ( h == NO_WAYPOINT ) {
+        // the sender has ignored its credit, or planned Waypoints have filled the pool
+        uint8_t lane = SerialTx.SetLane( eTxResponse );
+        SerialTx.print( F( "!X " ) );
+        SerialTx.println( _streamReceived );
+        SerialTx.SetLane( lane );
+        return;
+    }
+    _streamCredit--;
+    _streamReceived++;
+
+    // if Navigator ran dry waiting for us, this is where it picks up again
+    if ( _pTrackedHandle && *_pTrackedHandle == NO_WAYPOINT ) {
+        *_pTrackedHandle = h;
+    }
+}
+
+
+// the credit counts from now, but it's only sent from sendCredit()
+void WaypointManager::grantCredit( uint16_t n )
+{
+    _streamCredit += n;
+    _streamGranted += n;
+}
+
+
+// a line of its own, after anything ConsoleLine has started, on the lane which isn't dropped
+void WaypointManager::sendCredit()
+{
+    if ( ! _streamGranted ) {
+        return;
+    }
+
+    ConsoleLine.Flush();
+    uint8_t lane = SerialTx.SetLane( eTxResponse );
+    SerialTx.print( F( "!C " ) );
+    SerialTx.println( _streamGranted );
+    SerialTx.SetLane( lane );
+    _streamGranted = 0;
+}
+
+
+bool WaypointManager::SaveMission()
+{
+    MissionStore::eMissionStatus status = _pMissionStore ? _pMissionStore->Save( this ) : MissionStore::eMissionIOError;
+
+    SerialTx.print( F( "Mission save: " ) );
+    MissionStore::PrintStatus( status );
+    return status == MissionStore::eMissionOK;
+}
+
+
+bool WaypointManager::LoadMission()
+{
+    MissionStore::eMissionStatus status = _pMissionStore ? _pMissionStore->Load( this ) : MissionStore::eMissionIOError;
+
+    SerialTx.print( F( "Mission load: " ) );
+    MissionStore::PrintStatus( status );
+
+    if ( status != MissionStore::eMissionOK ) {
+        return false;
+    }
+
+    if ( _pTrackedHandle ) {
+        *_pTrackedHandle = _hFirst;
+    }
+    SerialTx.print( _count );
+    SerialTx.println( F( " waypoints loaded." ) );
+    return true;
+}
+
+
+WaypointHandle WaypointManager::GetHandle( WaypointHandle ordinal )
+{
+    WaypointHandle h = _hFirst;
+    while ( ordinal-- && h != NO_WAYPOINT ) {
+        h = _next[ h ];
+    }
+    return h;
+}
+
+
+// Recompute the geometry of the leg ending at h, along with the turn at the end of the
+// previous leg.
+void WaypointManager::updateLeg( WaypointHandle h )
+{
+    Leg* pLeg = &_legs[ h ];
+    WaypointHandle hPrev = _prev[ h ];
+
+    // the first leg starts from the origin
+    float dx = _waypoints[ h ]._x - ( hPrev != NO_WAYPOINT ? _waypoints[ hPrev ]._x : 0 );
+    float dy = _waypoints[ h ]._y - ( hPrev != NO_WAYPOINT ? _waypoints[ hPrev ]._y : 0 );
+
+    pLeg->set( dx, dy );
 
+#ifndef LEG_FIXED_POINT
+    WaypointHandle hNext = _next[ h ];
+
+    if ( pLeg->_length > 0.0 ) {
+        // same convention as Navigator:  swap the atan2() arguments so that 0 = North
+        pLeg->_heading = atan2( dx, dy );
+    }
+    else {
+        // a zero-length leg has no direction of its own, so carry the previous heading through
+        pLeg->_heading = hPrev != NO_WAYPOINT ? _legs[ hPrev ]._heading : 0.0;
+    }
+
+    // turn at the end of this leg is not known until the next leg is known
+    pLeg->_turn = hNext != NO_WAYPOINT ? normalizeRadians( _legs[ hNext ]._heading - pLeg->_heading ) : 0.0;
+
+    if ( hPrev != NO_WAYPOINT ) {
+        _legs[ hPrev ]._turn = normalizeRadians( pLeg->_heading - _legs[ hPrev ]._heading );
+    }
+#endif
+
+#if LEG_INDEX_BUCKETS
+    // refile the leg in the index, since it has probably moved
+    _index.Remove( h );
+    _index.Add( h, _waypoints[ h ]._x - dx / 2, _waypoints[ h ]._y - dy / 2, _legs[ h ].GetLength() / 2 );
+#endif
+}
+
+
+// The leg ending at h has changed, so the path distances from h on have too.  At the end of the
+// list, as when appending, that's only h's own;  anywhere else, they're left for the next query.
+void WaypointManager::updateCumulative( WaypointHandle h )
+{
+    if ( _bCumulativeStale || h != _hLast ) {
+        _bCumulativeStale = true;
+        return;
+    }
+
+    WaypointHandle hPrev = _prev[ h ];
+    _legs[ h ]._cumulative = ( hPrev != NO_WAYPOINT ? _legs[ hPrev ]._cumulative : _baseDistance ) + _legs[ h ]._length;
+}
+
+
+// the running path distance, from the start of the list to the end
+void WaypointManager::recomputeCumulative()
+{
+    LegDistance cumulative = _baseDistance;
+
+    for ( WaypointHandle h = _hFirst; h != NO_WAYPOINT; h = _next[ h ] ) {
+        cumulative += _legs[ h ]._length;
+        _legs[ h ]._cumulative = cumulative;
+    }
+    _bCumulativeStale = false;
+}
+
+#if LEG_INDEX_BUCKETS
+void LegIndex::Clear()
+{
+    for ( uint16_t ix = 0; ix < LEG_INDEX_BUCKETS; ix++ ) {
+        _bucketHead[ ix ] = NO_WAYPOINT;
+    }
+    for ( WaypointHandle h = 0; h < WAYPOINT_CAPACITY; h++ ) {
+        _nextInBucket[ h ] = FREE_SLOT;
+    }
+    _minCellX = _minCellY = 0x7FFF;
+    _maxCellX = _maxCellY = -0x7FFF;
+    _maxHalfLength = 0.0;
+}
+
+
+uint16_t LegIndex::bucket( int16_t cellX, int16_t cellY )
+{
+    // large primes spread neighboring cells across the buckets
+    return ( (uint32_t) cellX * 73856093UL ^ (uint32_t) cellY * 19349663UL ) % LEG_INDEX_BUCKETS;
+}
+
+
+void LegIndex::Add( WaypointHandle h, float midX, float midY, float halfLength )
+{
+    int16_t cellX = CellOf( midX );
+    int16_t cellY = CellOf( midY );
+    uint16_t ix = bucket( cellX, cellY );
+
+    _cellX[ h ] = cellX;
+    _cellY[ h ] = cellY;
+    _nextInBucket[ h ] = _bucketHead[ ix ];
+    _bucketHead[ ix ] = h;
+
+    _minCellX = min( _minCellX, cellX );
+    _maxCellX = max( _maxCellX, cellX );
+    _minCellY = min( _minCellY, cellY );
+    _maxCellY = max( _maxCellY, cellY );
+    _maxHalfLength = max( _maxHalfLength, halfLength );
+}
+
+
+void LegIndex::Remove( WaypointHandle h )
+{
+    if ( _nextInBucket[ h ] == FREE_SLOT ) {
+        return;     // not indexed
+    }
+
+    WaypointHandle* pLink = &_bucketHead[ bucket( _cellX[ h ], _cellY[ h ] ) ];
+    while ( *pLink != h ) {
+        pLink = &_nextInBucket[ *pLink ];
+    }
+    *pLink = _nextInBucket[ h ];
+    _nextInBucket[ h ] = FREE_SLOT;
+}
+
+
+WaypointHandle LegIndex::First( int16_t cellX, int16_t cellY )
+{
+    WaypointHandle h = _bucketHead[ bucket( cellX, cellY ) ];
+
+    // other cells share the bucket, so skip their legs
+    while ( h != NO_WAYPOINT && ( _cellX[ h ] != cellX || _cellY[ h ] != cellY ) ) {
+        h = _nextInBucket[ h ];
+    }
+    return h;
+}
+
+
+WaypointHandle LegIndex::Next( WaypointHandle h, int16_t cellX, int16_t cellY )
+{
+    do {
+        h = _nextInBucket[ h ];
+    } while ( h != NO_WAYPOINT && ( _cellX[ h ] != cellX || _cellY[ h ] != cellY ) );
+    return h;
+}
+
+
+int16_t LegIndex::RingsToCover( int16_t cellX, int16_t cellY )
+{
+    if ( _minCellX > _maxCellX ) {
+        return -1;  // empty
+    }
+    return max( max( cellX - _minCellX, _maxCellX - cellX ), max( cellY - _minCellY, _maxCellY - cellY ) );
+}
+
+
+// The i'th of the 8 * ring cells on the square ring around a cell, walking the four sides in turn.
+// Ring 0 is the cell itself.
+static void ringCell( int16_t ring, uint16_t i, int16_t& dx, int16_t& dy )
+{
+    if ( ring == 0 ) {
+        dx = dy = 0;
+        return;
+    }
+
+    int16_t side = i / ( 2 * ring );
+    int16_t offset = i % ( 2 * ring );
+    switch ( side ) {
+        case 0 :    dx = -ring + offset;    dy = -ring;             break;
+        case 1 :    dx = ring;              dy = -ring + offset;    break;
+        case 2 :    dx = ring - offset;     dy = ring;              break;
+        default :   dx = -ring;             dy = ring - offset;     break;
+    }
+}
+#endif
+
+
+float WaypointManager::legDistanceSquared( WaypointHandle h, float x, float y )
+{
+    Leg* pLeg = &_legs[ h ];
+    WaypointHandle hPrev = _prev[ h ];
+    float ux = pLeg->GetUx();
+    float uy = pLeg->GetUy();
+
+    // the first leg starts back along itself:  at the origin, or where a dropped Waypoint was
+    float startX = hPrev != NO_WAYPOINT ? _waypoints[ hPrev ]._x : _waypoints[ h ]._x - ux * pLeg->GetLength();
+    float startY = hPrev != NO_WAYPOINT ? _waypoints[ hPrev ]._y : _waypoints[ h ]._y - uy * pLeg->GetLength();
+
+    // project onto the leg, and clamp to its ends
+    float along = constrain( ( x - startX ) * ux + ( y - startY ) * uy, 0.0, pLeg->GetLength() );
+    float dx = x - ( startX + along * ux );
+    float dy = y - ( startY + along * uy );
+    return dx * dx + dy * dy;
+}
+
+
+// Cached, unless the cache is fixed point.  Then a zero-length leg carries the previous leg's
+// heading through, and the atan2() arguments are swapped so that 0 = North, as updateLeg() does.
+float WaypointManager::legHeading( WaypointHandle h )
+{
+#ifndef LEG_FIXED_POINT
+    return _legs[ h ]._heading;
+#else
+    while ( h != NO_WAYPOINT && _legs[ h ]._length == 0 ) {
+        h = _prev[ h ];
+    }
+    return h != NO_WAYPOINT ? atan2( _legs[ h ].GetUx(), _legs[ h ].GetUy() ) : 0.0;
+#endif
+}
+
+
+float WaypointManager::legTurn( WaypointHandle h )
+{
+#ifndef LEG_FIXED_POINT
+    return _legs[ h ]._turn;
+#else
+    return _next[ h ] != NO_WAYPOINT ? normalizeRadians( legHeading( _next[ h ] ) - legHeading( h ) ) : 0.0;
+#endif
+}
+
+
+WaypointHandle WaypointManager::NearestLegLinear( float x, float y, float minStart, float* pDistance )
+{
+    WaypointHandle hBest = NO_WAYPOINT;
+    float bestSquared = 0.0;
+    float bestStart = 0.0;
+
+    refreshCumulative();
+    for ( WaypointHandle h = _hFirst; h != NO_WAYPOINT; h = _next[ h ] ) {
+        float start = _legs[ h ].GetStart();
+        if ( start < minStart ) {
+            continue;
+        }
+        float dSquared = legDistanceSquared( h, x, y );
+        if ( hBest == NO_WAYPOINT || dSquared < bestSquared || ( dSquared == bestSquared && start < bestStart ) ) {
+            hBest = h;
+            bestSquared = dSquared;
+            bestStart = start;
+        }
+    }
+
+    if ( pDistance ) {
+        *pDistance = sqrt( bestSquared );
+    }
+    return hBest;
+}
+
+
+// Search outward from our cell, a ring of cells at a time, until the next ring can't hold
+// anything nearer than the best so far.
+WaypointHandle WaypointManager::NearestLeg( float x, float y, float minStart, float* pDistance )
+{
+#if ! LEG_INDEX_BUCKETS
+    return NearestLegLinear( x, y, minStart, pDistance );
+#else
+    int16_t cellX = LegIndex::CellOf( x );
+    int16_t cellY = LegIndex::CellOf( y );
+    int16_t rings = _index.RingsToCover( cellX, cellY );
+
+    WaypointHandle hBest = NO_WAYPOINT;
+    float bestSquared = 0.0;
+    float bestStart = 0.0;
+
+    refreshCumulative();
+
+    for ( int16_t ring = 0; ring <= rings; ring++ ) {
+        // ( x, y ) may be anywhere in its cell, so every leg filed under this ring is at least this far away
+        float reach = ( ring - 1 ) * LEG_INDEX_CELL_INCHES - _index.GetMaxHalfLength();
+        if ( hBest != NO_WAYPOINT && reach > 0.0 && reach * reach > bestSquared ) {
+            break;
+        }
+
+        // once the ring spans more cells than there are buckets, we'd be going over the same
+        // buckets again and again, so we might as well look at everything
+        if ( (uint32_t) ( 2 * ring + 1 ) * ( 2 * ring + 1 ) > LEG_INDEX_BUCKETS ) {
+            return NearestLegLinear( x, y, minStart, pDistance );
+        }
+
+        uint16_t nCells = ring ? 8 * ring : 1;
+        for ( uint16_t i = 0; i < nCells; i++ ) {
+            int16_t dx, dy;
+            ringCell( ring, i, dx, dy );
+
+            for ( WaypointHandle h = _index.First( cellX + dx, cellY + dy ); h != NO_WAYPOINT; h = _index.Next( h, cellX + dx, cellY + dy ) ) {
+                float start = _legs[ h ].GetStart();
+                if ( start < minStart ) {
+                    continue;
+                }
+                float dSquared = legDistanceSquared( h, x, y );
+                if ( hBest == NO_WAYPOINT || dSquared < bestSquared || ( dSquared == bestSquared && start < bestStart ) ) {
+                    hBest = h;
+                    bestSquared = dSquared;
+                    bestStart = start;
+                }
+            }
+        }
+    }
+
+    if ( pDistance ) {
+        *pDistance = sqrt( bestSquared );
+    }
+    return hBest;
+#endif
+}
+
+
+WaypointHandle WaypointManager::LegsWithin( float x, float y, float radius, WaypointHandle* pFound, WaypointHandle maxFound )
+{
+    WaypointHandle nFound = 0;
+    float radiusSquared = radius * radius;
+
+#if LEG_INDEX_BUCKETS
+    int16_t cellX = LegIndex::CellOf( x );
+    int16_t cellY = LegIndex::CellOf( y );
+    int16_t rings = min( _index.RingsToCover( cellX, cellY ), (int16_t) ( ( radius + _index.GetMaxHalfLength() ) / LEG_INDEX_CELL_INCHES + 1 ) );
+
+    if ( (uint32_t) ( 2 * rings + 1 ) * ( 2 * rings + 1 ) <= LEG_INDEX_BUCKETS ) {
+        for ( int16_t ring = 0; ring <= rings; ring++ ) {
+            uint16_t nCells = ring ? 8 * ring : 1;
+            for ( uint16_t i = 0; i < nCells; i++ ) {
+                int16_t dx, dy;
+                ringCell( ring, i, dx, dy );
+
+                for ( WaypointHandle h = _index.First( cellX + dx, cellY + dy ); h != NO_WAYPOINT; h = _index.Next( h, cellX + dx, cellY + dy ) ) {
+                    if ( legDistanceSquared( h, x, y ) <= radiusSquared ) {
+                        if ( nFound == maxFound ) {
+                            return nFound;
+                        }
+                        pFound[ nFound++ ] = h;
+                    }
+                }
+            }
+        }
+        return nFound;
+    }
+#endif
+
+    // too wide a search for the index to help, or there's no index
+    for ( WaypointHandle h = _hFirst; h != NO_WAYPOINT && nFound < maxFound; h = _next[ h ] ) {
+        if ( legDistanceSquared( h, x, y ) <= radiusSquared ) {
+            pFound[ nFound++ ] = h;
+        }
+    }
+    return nFound;
 }
 
-WaypointManager::~WaypointManager() 
+
+// Replace the mission with a random walk of nPoints, and time nQueries nearest-leg searches
+// each way, checking that they agree.
+void WaypointManager::benchmark( WaypointHandle nPoints, uint16_t nQueries )
 {
+    Clear();
+
+    int x = 0, y = 0;
+    for ( WaypointHandle i = 0; i < nPoints; i++ ) {
+        x = constrain( x + (int) random( -30, 31 ), -16000, 16000 );
+        y = constrain( y + (int) random( -30, 31 ), -16000, 16000 );
+        if ( AppendWaypoint( x, y, 2 ) == NO_WAYPOINT ) {
+            break;
+        }
+    }
+
+    unsigned long indexedMicros = 0, linearMicros = 0;
+    uint16_t mismatches = 0;
+
+    for ( uint16_t i = 0; i < nQueries; i++ ) {
+        // somewhere within a few feet of the path, as when we've been knocked off it.  The pool
+        // was empty, so the handles in use run from 0 up.
+        Waypoint* pNear = &_waypoints[ random( 0, _count ) ];
+        float qx = pNear->_x + random( -48, 49 );
+        float qy = pNear->_y + random( -48, 49 );
+        float dIndexed, dLinear;
+
+        unsigned long startMicros = micros();
+        NearestLeg( qx, qy, 0.0, &dIndexed );
+        unsigned long midMicros = micros();
+        NearestLegLinear( qx, qy, 0.0, &dLinear );
+        linearMicros += micros() - midMicros;
+        indexedMicros += midMicros - startMicros;
+
+        // ties may be broken differently, but the distances must agree
+        if ( fabs( dIndexed - dLinear ) > 0.001 ) {
+            mismatches++;
+        }
+    }
+
+    SerialTx.print( F( "Waypoints: " ) );
+    SerialTx.println( _count );
+    SerialTx.print( F( "Microseconds per query, indexed/linear: " ) );
+    SerialTx.print( (float) indexedMicros / max( nQueries, 1 ) ); SerialTx.print( '/' );
+    SerialTx.println( (float) linearMicros / max( nQueries, 1 ) );
+    SerialTx.print( F( "Mismatches: " ) );
+    SerialTx.println( mismatches );
 }
 
+
 // we only expect events from the CommandDispatcher
-Subscriber* WaypointManager::HandleEvent( EventNotification* pEvent ) 
+Subscriber* WaypointManager::HandleEvent( EventNotification* pEvent )
 {
     if ( pEvent && pEvent->eventID == 'W' ) {
         CommandArgs* pArgs = (CommandArgs*) pEvent->pData;
         switch( pArgs->inputBuffer[1] ) {
             case 0 : // no subcommand
                 break;
-            case '?' : 
+            case '?' :
                 PrintHelp();
                 break;
-            case 'A' : {// append a waypoint 
-                _waypoints[ _nextWaypoint++ ].Set( pArgs->nParams[ 0 ], pArgs->nParams[ 1 ], pArgs->nParams[ 2 ] );
-                Serial.println( F( "Waypoint added." ) );
+            case 'A' : {// append a waypoint
+                if ( AppendWaypoint( pArgs->nParams[ 0 ], pArgs->nParams[ 1 ], pArgs->nParams[ 2 ] ) != NO_WAYPOINT ) {
+                    SerialTx.println( F( "Waypoint added." ) );
+                }
+                else {
+                    SerialTx.println( F( "Waypoint list is full." ) );
+                }
             }
                 break;
-            case 'I' : // insert a waypoint
+            case 'I' : { // insert a waypoint ahead of the one at the given position
+                WaypointHandle hBefore = pArgs->nParams[ 0 ] >= 0 ? GetHandle( pArgs->nParams[ 0 ] ) : NO_WAYPOINT;
+                if ( hBefore == NO_WAYPOINT ) {
+                    // which InsertWaypoint() would take as appending
+                    SerialTx.println( F( "No such waypoint." ) );
+                }
+                else if ( InsertWaypoint( hBefore, pArgs->nParams[ 1 ], pArgs->nParams[ 2 ], pArgs->nParams[ 3 ] ) != NO_WAYPOINT ) {
+                    SerialTx.println( F( "Waypoint inserted." ) );
+                }
+                else {
+                    SerialTx.println( F( "Waypoint list is full." ) );
+                }
+            }
                 break;
             case 'D' : // delete a waypoint
+                if ( DeleteWaypoint( GetHandle( pArgs->nParams[ 0 ] ) ) ) {
+                    SerialTx.println( F( "Waypoint deleted." ) );
+                }
+                else {
+                    SerialTx.println( F( "No such waypoint." ) );
+                }
                 break;
             case 'L' : // Load waypoints
+                LoadMission();
                 break;
             case 'M' : // modify a waypoint
+                if ( ModifyWaypoint( GetHandle( pArgs->nParams[ 0 ] ), pArgs->nParams[ 1 ], pArgs->nParams[ 2 ], pArgs->nParams[ 3 ] ) ) {
+                    SerialTx.println( F( "Waypoint modified." ) );
+                }
+                else {
+                    SerialTx.println( F( "No such waypoint." ) );
+                }
+                break;
+            case 'S' : // Save waypoints
+                SaveMission();
+                break;
+            case 'O' : // open a stream, with the given window (0 for the default)
+                openStream( max( pArgs->nParams[ 0 ], 0 ) );
+                break;
+            case 'P' : // push a streamed waypoint
+                pushStreamed( pArgs->nParams[ 0 ], pArgs->nParams[ 1 ], pArgs->nParams[ 2 ] );
+                break;
+            case 'E' : // end of stream
+                _bStreaming = false;
+                SerialTx.print( F( "Stream ended, waypoints received: " ) );
+                SerialTx.println( _streamReceived );
+                break;
+            case 'B' : // benchmark the spatial index
+                benchmark( pArgs->nParams[ 0 ] > 0 ? pArgs->nParams[ 0 ] : WAYPOINT_CAPACITY, pArgs->nParams[ 1 ] > 0 ? pArgs->nParams[ 1 ] : 1000 );
                 break;
             case 'Q' : // query (list waypoints).  Since WaypointManager is not a behavior, we have to do this ourselves.
                 PrintParameterValues();
                 break;
             case 'X' : // clear waypoint list
-                _nextWaypoint = 0;
+                Clear();
 
                 break;
         }
+
+        // WO's credit, straight away
+        sendCredit();
     }
 
     return _pNextSub;
 }
 
-void WaypointManager::PrintHelp() 
+void WaypointManager::PrintHelp()
 {
-    if ( _nextWaypoint ) {
-        Serial.println( F( "\nDefined waypoints:" ) );
-        Serial.println( F( "x\ty\tradius" ) );
+    if ( _count ) {
+        SerialTx.println( F( "\nDefined waypoints:" ) );
+        SerialTx.println( F( "x\ty\tradius" ) );
     }
     else {
-        Serial.println( F( "\nNo waypoints defined." ) ) ;
+        SerialTx.println( F( "\nNo waypoints defined." ) ) ;
     }
 
-    for ( int ix = 0; ix < _nextWaypoint; ix++ ) {
-        Serial.print( _waypoints[ ix ]._x ); Serial.print( '\t' );
-        Serial.print( _waypoints[ ix ]._y ); Serial.print( '\t' );
-        Serial.println( _waypoints[ ix ]._radius );
+    for ( WaypointHandle h = _hFirst; h != NO_WAYPOINT; h = _next[ h ] ) {
+        SerialTx.print( _waypoints[ h ]._x ); SerialTx.print( '\t' );
+        SerialTx.print( _waypoints[ h ]._y ); SerialTx.print( '\t' );
+        SerialTx.println( _waypoints[ h ]._radius );
     }
 
    // we only handle one event, the "W" command:
-    Serial.println( F(  "\nWaypoint Manager Options:\n"
+    SerialTx.println( F(  "\nWaypoint Manager Options:\n"
                         "  0: Disable\n"
                         "  1: Enable\n"
                         "  A <x> <y> <radius> : Add waypoint\n"
-                        "  I: Insert\n"
-                        "  D: Delete\n"
-                        "  M: Modify\n"
-                        "  L: Load\n"
+                        "  I <#> <x> <y> <radius> : Insert ahead of waypoint #\n"
+                        "  D <#> : Delete waypoint #\n"
+                        "  M <#> <x> <y> <radius> : Modify waypoint #\n"
+                        "  L: Load mission\n"
+                        "  S: Save mission\n"
                         "  Q: Query\n"
-                        "  X: Clear" 
+                        "  O <window> : Open mission stream\n"
+                        "  P <x> <y> <radius> : Streamed waypoint\n"
+                        "  E: End mission stream\n"
+                        "  B <points> <queries> : Benchmark nearest-leg search (replaces mission)\n"
+                        "  X: Clear"
                         ) );
 }
 
 void WaypointManager::PrintParameterValues()
 {
+    refreshCumulative();
+    SerialTx.println( F( "\n#\tx\ty\tradius\tlength\theading\tcumul\tturn" ) );
+
+    int ix = 0;
+    for ( WaypointHandle h = _hFirst; h != NO_WAYPOINT; h = _next[ h ], ix++ ) {
+        SerialTx.print( ix ); SerialTx.print( _waypoints[ h ]._bPlanned ? F( "*\t" ) : F( "\t" ) );
+        SerialTx.print( _waypoints[ h ]._x ); SerialTx.print( '\t' );
+        SerialTx.print( _waypoints[ h ]._y ); SerialTx.print( '\t' );
+        SerialTx.print( _waypoints[ h ]._radius ); SerialTx.print( '\t' );
+        SerialTx.print( _legs[ h ].GetLength() ); SerialTx.print( '\t' );
+        SerialTx.print( legHeading( h ) * ( 180.0 / PI ) ); SerialTx.print( '\t' );
+        SerialTx.print( _legs[ h ].GetCumulative() ); SerialTx.print( '\t' );
+        SerialTx.println( legTurn( h ) * ( 180.0 / PI ) );
+    }
+
+    SerialTx.println( F( "(* = inserted by the planner)" ) );
+    SerialTx.print( F( "Path length (inches): " ) );
+    SerialTx.println( GetPathLength() );
+
+    SerialTx.print( F( "Waypoints used/capacity: " ) );
+    SerialTx.print( _count ); SerialTx.print( '/' );
+    SerialTx.println( WAYPOINT_CAPACITY );
+
+    if ( _bStreaming ) {
+        SerialTx.print( F( "Streaming, window/credit/received: " ) );
+        SerialTx.print( _streamWindow ); SerialTx.print( '/' );
+        SerialTx.print( _streamCredit ); SerialTx.print( '/' );
+        SerialTx.println( _streamReceived );
+    }
 }
@@ -12,52 +12,333 @@ Subsumption Architecture as described by David P. Anderson.
 
 #include <CommandDispatcher.h>
 #include <CommandSubscriber.h>
+#include <MissionStore.h>
 
 
 // The WaypointManager maintains a linked list of Waypoint objects,
 // supporting appending, inserting, deleting, and modifying (replacing) Waypoints, 
 // as well as serialization (load and save) to/from Serial port or flash memory.
+//
+// Waypoints live in a preallocated pool and are referred to by handle, so there is no
+// dynamic allocation, and a Waypoint never moves once it has been added.
+//
+// A mission too long for the pool can be streamed in over the console.  WO opens the stream
+// and WP delivers each Waypoint.  The pool then acts as a window onto the mission:  Waypoints
+// are dropped once Navigator has passed them, and the sender is granted "credit" for more with a
+// line of the form "!C <n>".  Credit is granted half a window at a time, so the sender can
+// refill one half while Navigator works through the other.  The sender must not send more
+// Waypoints than it has credit for.  WE ends the stream.
+//
+// Waypoints are dropped during the tick, when anything printed is telemetry, and may be lost, or
+// land in the middle of a CSV row.  So the credit is held until Update(), after the tick, and
+// sent on a line of its own on the response lane, which is never dropped.
 
 class Waypoint
 {
 public:
 
-    Waypoint( int x = 0, int y = 0, int radius = 0 ) : _x(x), _y(y), _radius(radius) {}
+    Waypoint( int x = 0, int y = 0, int radius = 0 ) : _x(x), _y(y), _radius(radius), _bPlanned(false) {}
 
-    void Set( int x, int y, int radius ) { _x = x; _y = y; _radius = radius; }
+    void Set( int x, int y, int radius ) { _x = x; _y = y; _radius = radius; _bPlanned = false; }
 
     int         _x;
     int         _y;
     uint8_t     _radius;
 
-//    Waypoint*   _pNextWaypoint;
+    // true for intermediate Waypoints inserted by the PathPlanner, rather than entered by the user
+    bool        _bPlanned;
+
+};
+
+
+// The leg cache holds fixed point on the AVR, where six floats a Waypoint is more RAM than the
+// pool can spare:  distances in 1/16ths of an inch, and the unit vector scaled by 2^14, with no
+// heading or turn.  Define LEG_FIXED_POINT to have it elsewhere too.
+#if defined( __AVR__ ) && ! defined( LEG_FIXED_POINT )
+#define LEG_FIXED_POINT
+#endif
+
+#ifdef LEG_FIXED_POINT
+typedef uint32_t    LegDistance;
+typedef int16_t     LegUnit;
+#define LEG_DISTANCE_SCALE  16
+#define LEG_UNIT_SCALE      16384
+#else
+typedef float       LegDistance;
+typedef float       LegUnit;
+#define LEG_DISTANCE_SCALE  1
+#define LEG_UNIT_SCALE      1
+#endif
+
+
+// Leg holds the derived geometry of the path segment which ends at a Waypoint.  The first leg
+// starts at the origin, which is where Position starts, unless a stream has dropped the Waypoint
+// it started from;  then it's left as it was.  None of these values depend upon where
+// the robot is, so WaypointManager computes them when the list is edited, instead of Navigator
+// recomputing them at every tick.  With LEG_FIXED_POINT, the heading of a leg and the turn at its
+// end aren't kept;  they're worked out from the unit vectors when they're wanted.
+class Leg
+{
+    LegUnit         _ux;            // unit vector along the leg, from the previous Waypoint to this one
+    LegUnit         _uy;
+    LegDistance     _length;        // length of the leg
+    LegDistance     _cumulative;    // path distance from the start of the mission to the end of this one
+#ifndef LEG_FIXED_POINT
+    float           _heading;       // heading of the leg in radians, 0 = North
+    float           _turn;          // heading change at the end of this leg, in radians.  0 for the last leg.
+#endif
+
+    // the leg from the previous Waypoint, dx and dy inches away
+    void            set( float dx, float dy );
+
+    friend class WaypointManager;
+
+public:
+
+    float           GetUx()             { return (float) _ux / LEG_UNIT_SCALE; }
+    float           GetUy()             { return (float) _uy / LEG_UNIT_SCALE; }
+
+    // in inches
+    float           GetLength()         { return (float) _length / LEG_DISTANCE_SCALE; }
+    float           GetCumulative()     { return (float) _cumulative / LEG_DISTANCE_SCALE; }
+    float           GetStart()          { return (float) ( _cumulative - _length ) / LEG_DISTANCE_SCALE; }
+};
+
+// Waypoints are kept in a fixed pool, sized at compile time for the target.  Override
+// WAYPOINT_CAPACITY before including this header (or on the compiler command line) to
+// change it.  Handles are 16 bits unless the capacity needs more.
+#ifndef WAYPOINT_CAPACITY
+#if defined( __AVR__ )
+#define WAYPOINT_CAPACITY   12
+#elif defined( ARDUINO_ARCH_SAM )   // Due
+#define WAYPOINT_CAPACITY   500
+#else
+#define WAYPOINT_CAPACITY   4000
+#endif
+#endif
+
+// A WaypointHandle identifies a Waypoint for as long as it exists, regardless of what is
+// inserted or deleted around it.  The same type is used for counts of Waypoints.
+#if WAYPOINT_CAPACITY < 0xFFFE
+typedef uint16_t WaypointHandle;
+
+#define NO_WAYPOINT     0xFFFF
+#define FREE_SLOT       0xFFFE
+#else
+typedef uint32_t WaypointHandle;
+
+#define NO_WAYPOINT     0xFFFFFFFF
+#define FREE_SLOT       0xFFFFFFFE
+#endif
+
+
+// LegIndex is a spatial index over the legs, so we can find the legs near a point without
+// looking at all of them.  It divides the world into square cells, and files each leg under the
+// cell holding its midpoint.  Cells are hashed into a fixed number of buckets, so the world has
+// no edges, and the whole index is a bucket table plus a few words per Waypoint.
+//
+// A leg can reach at most half its length from its midpoint, so a search which has covered every
+// cell within some distance of a point, plus the longest half-length, has seen every leg within
+// that distance.  This works best when the cells are no smaller than a typical leg.
+//
+// With LEG_INDEX_BUCKETS 0 there's no index, and searches look at every leg.  A sketch short of
+// RAM can choose that:  for a dozen Waypoints, it's as quick.
+#ifndef LEG_INDEX_BUCKETS
+#if defined( __AVR__ )
+#define LEG_INDEX_BUCKETS       16
+#elif defined( ARDUINO_ARCH_SAM )
+#define LEG_INDEX_BUCKETS       256
+#else
+#define LEG_INDEX_BUCKETS       8192
+#endif
+#endif
+
+#ifndef LEG_INDEX_CELL_INCHES
+#define LEG_INDEX_CELL_INCHES   24
+#endif
+
+#if LEG_INDEX_BUCKETS
+class LegIndex
+{
+    WaypointHandle  _bucketHead[ LEG_INDEX_BUCKETS ];
+    WaypointHandle  _nextInBucket[ WAYPOINT_CAPACITY ];     // FREE_SLOT if not indexed
+    int16_t         _cellX[ WAYPOINT_CAPACITY ];
+    int16_t         _cellY[ WAYPOINT_CAPACITY ];
+
+    // extent of the cells in use, and the longest half-leg, so searches know when to stop.
+    // These only grow, until the index is cleared.
+    int16_t         _minCellX, _maxCellX;
+    int16_t         _minCellY, _maxCellY;
+    float           _maxHalfLength;
+
+    static uint16_t bucket( int16_t cellX, int16_t cellY );
+
+public:
+
+    LegIndex()      { Clear(); }
+
+    void            Clear();
+
+    void            Add( WaypointHandle h, float midX, float midY, float halfLength );
+    void            Remove( WaypointHandle h );
+
+    static int16_t  CellOf( float inches )      { return (int16_t) floor( inches / LEG_INDEX_CELL_INCHES ); }
+
+    // walk the legs filed under a cell:  First(), then Next() until NO_WAYPOINT
+    WaypointHandle  First( int16_t cellX, int16_t cellY );
+    WaypointHandle  Next( WaypointHandle h, int16_t cellX, int16_t cellY );
+
+    float           GetMaxHalfLength()          { return _maxHalfLength; }
+
+    // how many rings of cells around ( cellX, cellY ) it takes to cover every cell in use
+    int16_t         RingsToCover( int16_t cellX, int16_t cellY );
 };
+#endif
+
 
 class WaypointManager : public CommandSubscriber
 {
-//    Waypoint*   _pFirstWaypoint;
-    uint16_t    _nextWaypoint;
+    // The pool.  Waypoint, Leg and link arrays are parallel, indexed by handle.  Waypoints in use
+    // form a doubly-linked list, in path order, through _next and _prev.  Free slots form a
+    // singly-linked list through _next, and are marked by a _prev of FREE_SLOT.
+    Waypoint        _waypoints[ WAYPOINT_CAPACITY ];
 
-    Waypoint    _waypoints[10];
-/*
-    void    Append( Waypoint* pWaypoint );
-    void    Insert( Waypoint* pWaypoint, uint16_t index );
-    void    Delete( uint16_t index );
-    void    Replace( Waypoint* pWaypoint, uint16_t index );
+    // _legs[ h ] describes the leg ending at _waypoints[ h ]
+    Leg             _legs[ WAYPOINT_CAPACITY ];
 
-    void    Load();
-    void    Save();
+    WaypointHandle  _next[ WAYPOINT_CAPACITY ];
+    WaypointHandle  _prev[ WAYPOINT_CAPACITY ];
 
-    void    Clear();
-*/
+    WaypointHandle  _hFirst;
+    WaypointHandle  _hLast;
+    WaypointHandle  _hFree;
+    WaypointHandle  _count;
+
+    // a client's handle which we keep valid when its Waypoint is deleted (see TrackHandle)
+    WaypointHandle* _pTrackedHandle;
+
+    // where the mission is saved, if anywhere
+    MissionStore*   _pMissionStore;
+
+#if LEG_INDEX_BUCKETS
+    LegIndex        _index;
+#endif
+
+    // squared distance from ( x, y ) to the leg ending at h
+    float           legDistanceSquared( WaypointHandle h, float x, float y );
+
+    // heading of the leg ending at h, in radians, 0 = North, and the turn at its end
+    float           legHeading( WaypointHandle h );
+    float           legTurn( WaypointHandle h );
+
+    // streaming state
+    bool            _bStreaming;
+    uint16_t        _streamWindow;      // Waypoints the sender may have outstanding
+    uint16_t        _streamCredit;      // Waypoints the sender may still send
+    uint16_t        _streamFreed;       // slots freed since credit was last granted
+    uint16_t        _streamGranted;     // credit granted, but not yet sent
+    uint32_t        _streamReceived;
+
+    void            openStream( uint16_t window );
+    void            pushStreamed( int x, int y, int radius );
+    void            grantCredit( uint16_t n );
+    void            sendCredit();
+
+    void            benchmark( WaypointHandle nPoints, uint16_t nQueries );
+
+    WaypointHandle  allocate( int x, int y, int radius );
+    void            link( WaypointHandle h, WaypointHandle hBefore );
+    void            unlink( WaypointHandle h );
+    void            dropFirst();
+
+    void            updateLeg( WaypointHandle h );
+
+    // Path distances are brought up to date lazily.  An edit which moves those after it along the
+    // path only marks them stale, and the next query which wants them redoes them all in one pass,
+    // so a run of edits (the planner's, say) costs one pass rather than one each.
+    bool            _bCumulativeStale;
+
+    // path distance to the start of the first leg:  0, unless a stream has dropped Waypoints
+    LegDistance     _baseDistance;
+
+    void            updateCumulative( WaypointHandle h );
+    void            refreshCumulative()                 { if ( _bCumulativeStale ) recomputeCumulative(); }
+    void            recomputeCumulative();
 
 public:
 
     WaypointManager( CommandDispatcher* pCD );
     ~WaypointManager();
 
-    Waypoint*               GetWaypoint( uint16_t ixWaypoint )   { return ixWaypoint < _nextWaypoint ? &_waypoints[ ixWaypoint ] : NULL; }
-    void                    AppendWaypoint( int x, int y, int radius )       {                _waypoints[ _nextWaypoint++ ].Set( x, y, radius ); }
+    // send the stream's sender any credit granted during the tick.  Call this from loop().
+    void                    Update()                            { sendCredit(); }
+
+    // all of these are O(1), other than the first GetLeg() after an edit, which brings the
+    // path distances up to date
+    bool                    IsValid( WaypointHandle h )         { return h < WAYPOINT_CAPACITY && _prev[ h ] != FREE_SLOT; }
+    Waypoint*               GetWaypoint( WaypointHandle h )     { return IsValid( h ) ? &_waypoints[ h ] : NULL; }
+    Leg*                    GetLeg( WaypointHandle h )          { refreshCumulative(); return IsValid( h ) ? &_legs[ h ] : NULL; }
+
+    WaypointHandle          First()                             { return _hFirst; }
+    WaypointHandle          Last()                              { return _hLast; }
+    WaypointHandle          Next( WaypointHandle h )            { return IsValid( h ) ? _next[ h ] : NO_WAYPOINT; }
+    WaypointHandle          Prev( WaypointHandle h )            { return IsValid( h ) ? _prev[ h ] : NO_WAYPOINT; }
+
+    WaypointHandle          GetCount()                          { return _count; }
+    WaypointHandle          GetCapacity()                       { return WAYPOINT_CAPACITY; }
+
+    // find the Waypoint at a position in the list.  This one walks the list, so it's O(n);
+    // it's meant for console commands, not for every tick.
+    WaypointHandle          GetHandle( WaypointHandle ordinal );
+
+    // these return the new Waypoint's handle, or NO_WAYPOINT if the pool is full.
+    // InsertWaypoint() inserts ahead of hBefore, or appends if hBefore is NO_WAYPOINT.
+    // Each edit is O(1);  it leaves the path distances after it to be brought up to date.
+    WaypointHandle          AppendWaypoint( int x, int y, int radius )  { return InsertWaypoint( NO_WAYPOINT, x, y, radius ); }
+    WaypointHandle          InsertWaypoint( WaypointHandle hBefore, int x, int y, int radius );
+
+    bool                    ModifyWaypoint( WaypointHandle h, int x, int y, int radius );
+    bool                    DeleteWaypoint( WaypointHandle h );
+    void                    Clear();
+
+    // Register a handle (normally Navigator's current Waypoint) to be kept valid:  if its
+    // Waypoint is deleted, the handle is moved on to the following one.
+    void                    TrackHandle( WaypointHandle* pHandle )    { _pTrackedHandle = pHandle; }
+
+    // Find the leg nearest to ( x, y ), among those starting no earlier in the path than
+    // minStart inches (0 to consider them all).  Where legs are equally near, the earliest wins.
+    // Returns the handle of the Waypoint at the end of the leg, or NO_WAYPOINT if there are no
+    // legs; pDistance, if given, receives the distance.
+    WaypointHandle          NearestLeg( float x, float y, float minStart = 0.0, float* pDistance = NULL );
+
+    // the same, by looking at every leg.  For comparison with NearestLeg().
+    WaypointHandle          NearestLegLinear( float x, float y, float minStart = 0.0, float* pDistance = NULL );
+
+    // Find up to maxFound legs passing within radius of ( x, y ), in no particular order.
+    // Returns the number found.
+    WaypointHandle          LegsWithin( float x, float y, float radius, WaypointHandle* pFound, WaypointHandle maxFound );
+
+    // Move on from h, which has been reached, returning the next Waypoint.  When streaming,
+    // this drops the Waypoints before h (h itself is kept as the start of the next leg), which
+    // frees room for the sender to send more.  That's O(1) for each Waypoint dropped.
+    WaypointHandle          Advance( WaypointHandle h );
+
+    // true if a stream is open, so running out of Waypoints only means waiting for more.
+    // While streaming, the tracked handle is set to the next Waypoint to arrive, if it has run out.
+    bool                    IsStreaming()                       { return _bStreaming; }
+
+    // Saving and loading the mission.  A successful load restarts the tracked handle at the
+    // first Waypoint; a failed one leaves the current mission alone.
+    void                    SetMissionStore( MissionStore* pStore )   { _pMissionStore = pStore; }
+    bool                    SaveMission();
+    bool                    LoadMission();
+
+    // total path length, in inches, from the origin through the last Waypoint
+    float                   GetPathLength()                     { refreshCumulative(); return _count ? _legs[ _hLast ].GetCumulative() : 0.0; }
+
+    // path distance remaining, given the distance remaining on the leg ending at h
+    float                   GetDistanceToGo( WaypointHandle h, float legRemaining )  
+                                                                { return IsValid( h ) ? legRemaining + GetPathLength() - GetLeg( h )->GetCumulative() : 0.0; }
 
     virtual Subscriber*     HandleEvent( EventNotification* pEvent );
 